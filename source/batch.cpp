@@ -0,0 +1,181 @@
+#include "batch.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+typedef struct {
+    s32 row;
+    s32 col;
+    u32 index; // order of drawing, ties on the same cell go to the later glyph
+    char c;
+} BatchCell;
+
+typedef struct {
+    u32 color;
+    float charWidth;
+    float charHeight;
+    float phaseX; // grid origin, modulo char size
+    float phaseY;
+    std::vector<BatchCell> cells;
+} BatchGroup;
+
+static inline void batchHash(u64 &hash, u32 value) {
+    hash = (hash ^ value) * 0x100000001B3ULL; // FNV-1a, one word at a time
+}
+
+static inline u32 batchFloatBits(float value) {
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+struct batchCellOrder {
+    inline bool operator()(const BatchCell &a, const BatchCell &b) {
+        return (a.row != b.row) ? (a.row > b.row) : (a.col != b.col) ? (a.col < b.col) : (a.index < b.index);
+    }
+};
+
+void batchString(DrawBatch &batch, const char* str, u32 size, float x, float y, float charWidth, float charHeight, u8 red, u8 green, u8 blue, u8 alpha) {
+    if(size == 0 || alpha == 0) return;
+
+    batchHash(batch.hash, batchFloatBits(x));
+    batchHash(batch.hash, batchFloatBits(y));
+    batchHash(batch.hash, batchFloatBits(charWidth));
+    batchHash(batch.hash, batchFloatBits(charHeight));
+    batchHash(batch.hash, (red << 24) | (green << 16) | (blue << 8) | alpha);
+    for(u32 i = 0; i < size; i++) {
+        batchHash(batch.hash, (u8) str[i]);
+    }
+
+    // same layout as gput::drawString(): the first line on top, the last line at y
+    u32 nLines = std::count(str, str + size, '\n') + 1;
+    u32 color = (red << 24) | (green << 16) | (blue << 8) | alpha;
+    float cx = x;
+    float cy = y + ((nLines - 1) * charHeight);
+    for(const char* it = str; it != str + size; it++) {
+        if(*it == '\n') {
+            cx = x;
+            cy -= charHeight;
+            continue;
+        }
+
+        if(*it != ' ') { // blank in the font, only needed as padding
+            BatchGlyph glyph = {cx, cy, charWidth, charHeight, color, *it};
+            batch.glyphs.push_back(glyph);
+        }
+
+        cx += charWidth;
+    }
+}
+
+void batchRectangle(DrawBatch &batch, float x, float y, float width, float height, u8 red, u8 green, u8 blue, u8 alpha) {
+    if(width <= 0 || height <= 0 || alpha == 0) return;
+
+    const float r = red / 255.0f;
+    const float g = green / 255.0f;
+    const float b = blue / 255.0f;
+    const float a = alpha / 255.0f;
+    const float x1 = x + width;
+    const float y1 = y + height;
+    batchHash(batch.hash, 0xFFFFFFFF); // never a char
+    batchHash(batch.hash, batchFloatBits(x));
+    batchHash(batch.hash, batchFloatBits(y));
+    batchHash(batch.hash, batchFloatBits(width));
+    batchHash(batch.hash, batchFloatBits(height));
+    batchHash(batch.hash, (red << 24) | (green << 16) | (blue << 8) | alpha);
+
+    const float quad[BATCH_QUAD_FLOATS] = {
+            x, y, -0.1f, 0.0f, 0.0f, r, g, b, a,
+            x1, y, -0.1f, 1.0f, 0.0f, r, g, b, a,
+            x1, y1, -0.1f, 1.0f, 1.0f, r, g, b, a,
+            x1, y1, -0.1f, 1.0f, 1.0f, r, g, b, a,
+            x, y1, -0.1f, 0.0f, 1.0f, r, g, b, a,
+            x, y, -0.1f, 0.0f, 0.0f, r, g, b, a,
+    };
+
+    batch.quads.insert(batch.quads.end(), quad, quad + BATCH_QUAD_FLOATS);
+}
+
+u32 batchLayout(const DrawBatch &batch, std::vector<BatchString> &strings) {
+    // groups and strings are reused from the last call, a steady screen allocates nothing
+    static std::vector<BatchGroup> groups;
+    u32 nGroups = 0;
+
+    // sort glyphs into groups that can share one string, in order of first use
+    for(std::vector<BatchGlyph>::const_iterator it = batch.glyphs.begin(); it != batch.glyphs.end(); it++) {
+        if(it->charWidth <= 0 || it->charHeight <= 0) continue;
+
+        BatchCell cell;
+        cell.col = (s32) floorf(it->x / it->charWidth);
+        cell.row = (s32) floorf(it->y / it->charHeight);
+        cell.index = it - batch.glyphs.begin();
+        cell.c = it->c;
+        float phaseX = it->x - (cell.col * it->charWidth);
+        float phaseY = it->y - (cell.row * it->charHeight);
+
+        u32 g = 0;
+        while(g < nGroups && !(groups[g].color == it->color && groups[g].charWidth == it->charWidth && groups[g].charHeight == it->charHeight &&
+                               groups[g].phaseX == phaseX && groups[g].phaseY == phaseY)) g++;
+        if(g == nGroups) {
+            if(nGroups == groups.size()) groups.push_back(BatchGroup());
+            BatchGroup &group = groups[nGroups++];
+            group.color = it->color;
+            group.charWidth = it->charWidth;
+            group.charHeight = it->charHeight;
+            group.phaseX = phaseX;
+            group.phaseY = phaseY;
+            group.cells.clear();
+        }
+
+        groups[g].cells.push_back(cell);
+    }
+
+    // one string per group, empty cells become spaces, empty rows become empty lines
+    for(u32 g = 0; g < nGroups; g++) {
+        BatchGroup* group = &groups[g];
+        std::sort(group->cells.begin(), group->cells.end(), batchCellOrder());
+
+        s32 minCol = group->cells.front().col;
+        for(std::vector<BatchCell>::iterator cell = group->cells.begin(); cell != group->cells.end(); cell++) {
+            if(cell->col < minCol) minCol = cell->col;
+        }
+
+        if(g == strings.size()) strings.push_back(BatchString());
+        BatchString &out = strings[g];
+        out.str.clear();
+        out.x = group->phaseX + (minCol * group->charWidth);
+        out.y = group->phaseY + (group->cells.back().row * group->charHeight);
+        out.charWidth = group->charWidth;
+        out.charHeight = group->charHeight;
+        out.color = group->color;
+
+        s32 row = group->cells.front().row;
+        s32 col = minCol;
+        for(std::vector<BatchCell>::iterator cell = group->cells.begin(); cell != group->cells.end(); cell++) {
+            if(cell->row < row) {
+                out.str.append(row - cell->row, '\n');
+                row = cell->row;
+                col = minCol;
+            }
+
+            if(cell->col < col) { // same cell drawn again, the later glyph wins
+                out.str[out.str.size() - 1] = cell->c;
+                continue;
+            }
+
+            out.str.append(cell->col - col, ' ');
+            out.str.push_back(cell->c);
+            col = cell->col + 1;
+        }
+    }
+
+    return nGroups;
+}
+
+void batchClear(DrawBatch &batch) {
+    batch.glyphs.clear();
+    batch.quads.clear();
+    batch.hash = 0xCBF29CE484222325ULL;
+}
@@ -0,0 +1,44 @@
+#ifndef __CTRX_BATCH_HPP__
+#define __CTRX_BATCH_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define BATCH_QUAD_FLOATS (6 * 9)
+
+typedef struct {
+    float x;
+    float y;
+    float charWidth;
+    float charHeight;
+    u32 color; // RGBA, red in the top byte
+    char c;
+} BatchGlyph;
+
+// one string for gput::drawString(), lines are charHeight apart, the last line is at y
+typedef struct {
+    std::string str;
+    float x;
+    float y;
+    float charWidth;
+    float charHeight;
+    u32 color;
+} BatchString;
+
+// glyphs and rectangles collected for one screen, CPU side only
+// rectangles go into one triangle list (9 floats per vertex: x, y, z, u, v, r, g, b, a) and are drawn below all text,
+// glyphs sharing color, size and grid are merged into as few strings as possible by batchLayout()
+typedef struct {
+    std::vector<BatchGlyph> glyphs;
+    std::vector<float> quads;
+    u64 hash; // of everything added since batchClear()
+} DrawBatch;
+
+void batchString(DrawBatch &batch, const char* str, u32 size, float x, float y, float charWidth, float charHeight, u8 red, u8 green, u8 blue, u8 alpha);
+void batchRectangle(DrawBatch &batch, float x, float y, float width, float height, u8 red, u8 green, u8 blue, u8 alpha);
+u32 batchLayout(const DrawBatch &batch, std::vector<BatchString> &strings); // strings past the returned count are left over
+void batchClear(DrawBatch &batch);
+
+#endif
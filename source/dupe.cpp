@@ -0,0 +1,182 @@
+#include "dupe.hpp"
+#include "fs.hpp"
+#include "hash.hpp"
+#include "prof.hpp"
+#include "verify.hpp"
+
+#include <sys/errno.h>
+#include <string.h>
+
+#include <cstdio>
+#include <algorithm>
+
+typedef struct {
+    u32 file; // index into the listing
+    u64 size;
+    u8 digest[20];
+} DupeCandidate;
+
+static bool dupeSameDigest(const DupeCandidate &a, const DupeCandidate &b) {
+    return (a.size == b.size) && (memcmp(a.digest, b.digest, sizeof(a.digest)) == 0);
+}
+
+static bool dupeLessDigest(const DupeCandidate &a, const DupeCandidate &b) {
+    if(a.size != b.size) return a.size < b.size;
+    int cmp = memcmp(a.digest, b.digest, sizeof(a.digest));
+    return (cmp != 0) ? (cmp < 0) : (a.file < b.file);
+}
+
+// drops every candidate whose size and digest is unique
+static void dupeKeepMatches(std::vector<DupeCandidate> &candidates) {
+    std::sort(candidates.begin(), candidates.end(), dupeLessDigest);
+    u32 keep = 0;
+    for (u32 i = 0; i < candidates.size();) {
+        u32 end = i + 1;
+        while((end < candidates.size()) && dupeSameDigest(candidates[i], candidates[end])) end++;
+        if(end - i > 1) {
+            for (; i < end; i++) candidates[keep++] = candidates[i];
+        }
+        i = end;
+    }
+    candidates.resize(keep);
+}
+
+static bool dupePartialHash(const std::string path, u64 size, u8* digest) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    PROF_ADD(P_OPENS, 1);
+    if(fp == NULL) return false;
+
+    // small files are read in full, their partial hash is already the final one
+    u8 buffer[DUPE_PARTIAL_SIZE];
+    HashContext ctx;
+    hashInit(ctx, HASH_SHA1);
+    u64 pos = 0;
+    bool ret = true;
+    while(ret && (pos < size)) {
+        if((size > DUPE_PARTIAL_SIZE * 2) && (pos == DUPE_PARTIAL_SIZE)) {
+            pos = size - DUPE_PARTIAL_SIZE;
+            ret = (fseek(fp, (long) pos, SEEK_SET) == 0);
+            PROF_ADD(P_SEEKS, 1);
+            if(!ret) break;
+        }
+        u32 len = (u32) std::min((u64) DUPE_PARTIAL_SIZE, size - pos);
+        ret = (fread(buffer, 1, len, fp) == len);
+        PROF_ADD(P_BYTES_READ, len);
+        hashUpdate(ctx, buffer, len);
+        pos += len;
+    }
+    fclose(fp);
+
+    if(ret) {
+        HashResult result;
+        hashFinal(ctx, result);
+        memcpy(digest, result.sha1, sizeof(result.sha1));
+    }
+
+    return ret;
+}
+
+bool dupeFind(const std::string directory, std::vector<DupeGroup> &groups, bool showProgress) {
+    groups.clear();
+    std::vector<FileSizeInfo> files;
+    if(!fsListFiles(directory, files, showProgress)) return false;
+
+    // stage 1: sizes come with the listing, files of a unique size can't have a duplicate
+    std::vector<DupeCandidate> candidates;
+    candidates.reserve(files.size());
+    for (u32 i = 0; i < files.size(); i++) {
+        if(files[i].size == 0) continue;
+        DupeCandidate candidate;
+        candidate.file = i;
+        candidate.size = files[i].size;
+        memset(candidate.digest, 0, sizeof(candidate.digest));
+        candidates.push_back(candidate);
+    }
+    dupeKeepMatches(candidates);
+
+    // stage 2: start and end of each candidate, visited in path order to keep directory lookups local
+    std::sort(candidates.begin(), candidates.end(), [](const DupeCandidate &a, const DupeCandidate &b) {
+        return a.file < b.file;
+    });
+    std::vector<DupeCandidate> next;
+    for (u32 i = 0; i < candidates.size(); i++) {
+        const std::string &path = files[candidates[i].file].path;
+        if(showProgress && !fsShowProgress("Comparing", path, i, candidates.size())) {
+            errno = ECANCELED;
+            return false;
+        }
+        if(dupePartialHash(path, candidates[i].size, candidates[i].digest)) next.push_back(candidates[i]);
+    }
+    candidates.swap(next);
+    dupeKeepMatches(candidates);
+
+    // stage 3: full hash of what is left, unless stage 2 already saw the whole file
+    u64 total = 0;
+    for (std::vector<DupeCandidate>::iterator it = candidates.begin(); it != candidates.end(); it++) {
+        if((*it).size > DUPE_PARTIAL_SIZE * 2) total += (*it).size;
+    }
+    u64 done = 0;
+    bool ret = true;
+    next.clear();
+    for (std::vector<DupeCandidate>::iterator it = candidates.begin(); it != candidates.end(); it++) {
+        DupeCandidate &candidate = *it;
+        const std::string &path = files[candidate.file].path;
+        if(candidate.size <= DUPE_PARTIAL_SIZE * 2) {
+            next.push_back(candidate);
+            continue;
+        }
+        HashResult result;
+        if(verifyFileHash(path, HASH_SHA1, result, NULL, [&](u32 pos) {
+                return !showProgress || fsShowProgress("Hashing", path, done + pos, total + 1);
+            })) {
+            memcpy(candidate.digest, result.sha1, sizeof(result.sha1));
+            next.push_back(candidate);
+        } else if(errno == ECANCELED) {
+            ret = false;
+            break;
+        }
+        done += candidate.size;
+    }
+    int err = errno; // a failed cache write doesn't matter to the caller
+    verifyCacheSave();
+    errno = err;
+    if(!ret) return false;
+    candidates.swap(next);
+    dupeKeepMatches(candidates);
+
+    for (u32 i = 0; i < candidates.size();) {
+        DupeGroup group;
+        group.size = candidates[i].size;
+        u32 end = i;
+        for (; (end < candidates.size()) && dupeSameDigest(candidates[i], candidates[end]); end++) {
+            group.paths.push_back(files[candidates[end].file].path);
+        }
+        std::sort(group.paths.begin(), group.paths.end());
+        groups.push_back(group);
+        i = end;
+    }
+    std::stable_sort(groups.begin(), groups.end(), [](const DupeGroup &a, const DupeGroup &b) {
+        return a.size * (a.paths.size() - 1) > b.size * (b.paths.size() - 1);
+    });
+
+    return true;
+}
+
+bool dupeRecheck(const std::vector<std::string> &paths, bool &identical, bool showProgress) {
+    identical = true;
+    u8 first[20];
+    u32 firstSize = 0;
+    for (u32 i = 0; i < paths.size(); i++) {
+        u32 size = fsGetFileSize(paths[i]);
+        HashResult result;
+        if(!fsDataHash(paths[i], 0, size, result, HASH_SHA1, showProgress)) return false;
+        if(i == 0) {
+            memcpy(first, result.sha1, sizeof(first));
+            firstSize = size;
+        } else if((size != firstSize) || (memcmp(first, result.sha1, sizeof(first)) != 0)) {
+            identical = false;
+            break;
+        }
+    }
+    return true;
+}
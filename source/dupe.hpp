@@ -0,0 +1,26 @@
+#ifndef __CTRX_DUPE_HPP__
+#define __CTRX_DUPE_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define DUPE_PARTIAL_SIZE (4 * 1024) // read from start and end of each candidate before hashing it whole
+
+typedef struct {
+    u64 size; // of each file
+    std::vector<std::string> paths; // sorted
+} DupeGroup;
+
+// groups identical files below directory, sorted by wasted space (largest first)
+// candidates are narrowed down by size, then by a SHA-1 of their first and last DUPE_PARTIAL_SIZE bytes,
+// only files still matching after that are hashed completely (through the verify cache)
+// empty files and files that can't be read are ignored, returns false and sets errno on failure or cancel
+bool dupeFind(const std::string directory, std::vector<DupeGroup> &groups, bool showProgress = false);
+
+// reads the given files again in full (no cache) and tells if they are all still identical,
+// meant to be called right before deleting copies, returns false and sets errno on failure or cancel
+bool dupeRecheck(const std::vector<std::string> &paths, bool &identical, bool showProgress = false);
+
+#endif
@@ -0,0 +1,100 @@
+#include "entropy.hpp"
+#include "fs.hpp"
+
+#include <sys/errno.h>
+#include <math.h>
+#include <string.h>
+
+#define ENTROPY_TABLE_MAX (64 * 1024) // c * log2(c) is looked up for blocks up to this size
+
+// the bytes of each word are counted in separate tables, runs of one value (padding)
+// then don't stall on the same counter, the tables are summed up once per block
+static void entropyCount(u32 (*tables)[256], const u8* data, u32 size) {
+    u32 i = 0;
+    for (; i + 4 <= size; i += 4) {
+        u32 word;
+        memcpy(&word, data + i, 4);
+        tables[0][word & 0xFF]++;
+        tables[1][(word >> 8) & 0xFF]++;
+        tables[2][(word >> 16) & 0xFF]++;
+        tables[3][word >> 24]++;
+    }
+    for (; i < size; i++) tables[0][data[i]]++;
+}
+
+float entropyBits(const u32* histogram, u32 total) {
+    if(total == 0) return 0;
+    float sum = 0;
+    for (u32 b = 0; b < 256; b++) {
+        if(histogram[b]) sum += histogram[b] * log2f(histogram[b]);
+    }
+    float bits = log2f(total) - (sum / total);
+    return (bits > 0) ? bits : 0;
+}
+
+bool entropyHistogram(const std::string path, u32 offset, u32 size, u32* histogram) {
+    u32 tables[4][256];
+    memset(tables, 0, sizeof(tables));
+    if(!fsDataStream(path, offset, size, "Analyzing", [&](const u8* data, u32 l_size) {
+            entropyCount(tables, data, l_size);
+            return true;
+        }, false)) return false;
+    for (u32 b = 0; b < 256; b++) histogram[b] = tables[0][b] + tables[1][b] + tables[2][b] + tables[3][b];
+    return true;
+}
+
+bool entropyScan(const std::string path, u32 offset, u32 size, u32 blockSize, EntropyMap &map, bool showProgress) {
+    if(blockSize == 0) blockSize = size / ENTROPY_AUTO_BLOCKS;
+    u32 bs = ENTROPY_MIN_BLOCK;
+    while((bs < blockSize) || ((((u64) size + bs - 1) / bs) > ENTROPY_MAX_BLOCKS)) bs <<= 1;
+
+    map.path = path;
+    map.offset = offset;
+    map.size = size;
+    map.blockSize = bs;
+    map.entropy.clear();
+    map.entropy.reserve(((u64) size + bs - 1) / bs);
+    memset(map.histogram, 0, sizeof(map.histogram));
+
+    // H = log2(n) - sum(c * log2(c)) / n, so small blocks take no logarithm per count
+    std::vector<float> clog;
+    if(bs <= ENTROPY_TABLE_MAX) {
+        clog.resize(bs + 1);
+        clog[0] = 0;
+        for (u32 c = 1; c <= bs; c++) clog[c] = c * log2f(c);
+    }
+
+    u32 tables[4][256];
+    memset(tables, 0, sizeof(tables));
+    u32 fill = 0;
+    auto finishBlock = [&]() {
+        float sum = 0;
+        for (u32 b = 0; b < 256; b++) {
+            u32 c = tables[0][b] + tables[1][b] + tables[2][b] + tables[3][b];
+            if(c == 0) continue;
+            map.histogram[b] += c;
+            sum += (clog.empty()) ? c * log2f(c) : clog[c];
+        }
+        float bits = log2f(fill) - (sum / fill);
+        u32 scaled = (bits > 0) ? (u32) ((bits * 32) + 0.5f) : 0;
+        map.entropy.push_back((scaled < 255) ? scaled : 255);
+        memset(tables, 0, sizeof(tables));
+        fill = 0;
+    };
+
+    // blocks are independent of the stream chunks, a block may start in one chunk and end in the next
+    if(!fsDataStream(path, offset, size, "Analyzing", [&](const u8* data, u32 l_size) {
+            while(l_size) {
+                u32 count = (bs - fill < l_size) ? bs - fill : l_size;
+                entropyCount(tables, data, count);
+                fill += count;
+                data += count;
+                l_size -= count;
+                if(fill == bs) finishBlock();
+            }
+            return true;
+        }, showProgress)) return false;
+    if(fill) finishBlock();
+
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef __CTRX_ENTROPY_HPP__
+#define __CTRX_ENTROPY_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define ENTROPY_MIN_BLOCK 256
+#define ENTROPY_MAX_BLOCKS (256 * 1024) // larger blocks are used where a region would need more
+#define ENTROPY_AUTO_BLOCKS 384 // automatic block size, about one block per column of the top screen strip
+
+typedef struct {
+    std::string path;
+    u32 offset; // analyzed region
+    u32 size;
+    u32 blockSize;
+    std::vector<u8> entropy; // per block, in 1/32 bit per byte (8 bits are stored as 255)
+    u32 histogram[256]; // byte counts of the whole region
+} EntropyMap;
+
+// streams the region once, the Shannon entropy of every block and the histogram of all of them are taken in one pass
+// blockSize is rounded up to a power of two (0 for automatic), the last block may be shorter
+// functions return false and set errno on failure or cancel (ECANCELED)
+bool entropyScan(const std::string path, u32 offset, u32 size, u32 blockSize, EntropyMap &map, bool showProgress = false);
+bool entropyHistogram(const std::string path, u32 offset, u32 size, u32* histogram); // 256 counts, for a single block
+float entropyBits(const u32* histogram, u32 total);
+
+#endif
@@ -0,0 +1,118 @@
+#include "fmt.hpp"
+
+#include <string.h>
+
+static const char fmtHexPairs[] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+static const char fmtDecPairs[] =
+    "0001020304050607080910111213141516171819202122232425262728293031"
+    "3233343536373839404142434445464748495051525354555657585960616263"
+    "6465666768697071727374757677787980818283848586878889909192939495"
+    "96979899";
+
+void fmtStart(FmtBuffer &buf, char* data, u32 capacity) {
+    buf.data = data;
+    buf.size = 0;
+    buf.capacity = capacity;
+    if(capacity > 0) data[0] = '\0';
+}
+
+void fmtString(FmtBuffer &buf, const char* data, u32 size) {
+    if(buf.size + size >= buf.capacity) {
+        if(buf.capacity == 0) return;
+        size = buf.capacity - 1 - buf.size;
+    }
+
+    memcpy(buf.data + buf.size, data, size);
+    buf.size += size;
+    buf.data[buf.size] = '\0';
+}
+
+void fmtChar(FmtBuffer &buf, char c, u32 count) {
+    if(buf.size + count >= buf.capacity) {
+        if(buf.capacity == 0) return;
+        count = buf.capacity - 1 - buf.size;
+    }
+
+    memset(buf.data + buf.size, c, count);
+    buf.size += count;
+    buf.data[buf.size] = '\0';
+}
+
+void fmtString(FmtBuffer &buf, const char* str) {
+    fmtString(buf, str, strlen(str));
+}
+
+void fmtString(FmtBuffer &buf, const std::string &str) {
+    fmtString(buf, str.data(), str.size());
+}
+
+// same as uiTruncateString()
+void fmtTruncate(FmtBuffer &buf, const std::string &str, int nsize, int pos) {
+    int osize = str.size();
+    if(pos < 0) pos = nsize + 1 + pos - 3;
+    if(pos + 3 > nsize) pos = nsize - 3;
+    if(pos < 0) pos = 0;
+    if(nsize >= osize) {
+        fmtString(buf, str);
+        return;
+    }
+
+    fmtString(buf, str.data(), pos);
+    fmtString(buf, "...", 3);
+    if(nsize > pos + 3) fmtString(buf, str.data() + osize - (nsize - pos - 3), nsize - pos - 3);
+}
+
+void fmtHex(FmtBuffer &buf, u32 value, u32 digits) {
+    char out[8];
+    if(digits > 8) digits = 8;
+    for(u32 i = 8; i > 0; i -= 2, value >>= 8) {
+        memcpy(out + i - 2, fmtHexPairs + ((value & 0xFF) * 2), 2);
+    }
+
+    fmtString(buf, out + 8 - digits, digits);
+}
+
+void fmtDec(FmtBuffer &buf, u64 value, u32 width) {
+    char out[20];
+    u32 pos = sizeof(out);
+    while(value >= 100) {
+        pos -= 2;
+        memcpy(out + pos, fmtDecPairs + ((value % 100) * 2), 2);
+        value /= 100;
+    }
+
+    if(value >= 10) {
+        pos -= 2;
+        memcpy(out + pos, fmtDecPairs + (value * 2), 2);
+    } else out[--pos] = '0' + value;
+
+    if(sizeof(out) - pos < width) fmtChar(buf, ' ', width - (sizeof(out) - pos));
+    fmtString(buf, out + pos, sizeof(out) - pos);
+}
+
+// same as uiFormatBytes()
+void fmtBytes(FmtBuffer &buf, u64 bytes) {
+    const char* units[] = {" byte", "kB", "MB", "GB"};
+
+    if(bytes < 1024) {
+        fmtDec(buf, bytes);
+        fmtString(buf, units[0]);
+    } else {
+        int scale = 1;
+        u64 bytes100 = (bytes * 100) >> 10;
+        for(; (bytes100 >= 1024*100) && (scale < 3); scale++, bytes100 >>= 10);
+        fmtDec(buf, bytes100 / 100);
+        fmtChar(buf, '.');
+        fmtString(buf, fmtDecPairs + ((bytes100 % 100) * 2), 2);
+        fmtString(buf, units[scale]);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef __CTRX_FMT_HPP__
+#define __CTRX_FMT_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+
+// text formatting into caller provided buffers (usually on the stack), nothing is allocated
+// output that does not fit is cut off, data is always NUL terminated
+typedef struct {
+    char* data;
+    u32 size;
+    u32 capacity; // including the terminating NUL
+} FmtBuffer;
+
+void fmtStart(FmtBuffer &buf, char* data, u32 capacity);
+void fmtChar(FmtBuffer &buf, char c, u32 count = 1);
+void fmtString(FmtBuffer &buf, const char* str);
+void fmtString(FmtBuffer &buf, const char* data, u32 size);
+void fmtString(FmtBuffer &buf, const std::string &str);
+void fmtTruncate(FmtBuffer &buf, const std::string &str, int nsize, int pos);
+void fmtHex(FmtBuffer &buf, u32 value, u32 digits);
+void fmtDec(FmtBuffer &buf, u64 value, u32 width = 0);
+void fmtBytes(FmtBuffer &buf, u64 bytes);
+
+#endif
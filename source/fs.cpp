@@ -1,4 +1,6 @@
 #include "fs.hpp"
+#include "mem.hpp"
+#include "prof.hpp"
 #include "ui.hpp"
 
 #include <citrus/core.hpp>
@@ -18,6 +20,22 @@
 using namespace ctr;
 
 #define CTRX_BUFSIZ (1 * 1024 * 1024)
+#define FS_STREAM_BUFSIZ (CTRX_BUFSIZ / 2) // two of these are in use while streaming
+#define FS_STREAM_STACK (16 * 1024)
+#define FS_LIST_ENTRIES 64 // directory entries per FSDIR_Read()
+#define FS_LIST_PATH_MAX 0x400
+
+typedef struct {
+    FILE* fp;
+    u8* buffer[2];
+    u32 size[2]; // bytes in each buffer, 0 marks the end (or a read error)
+    u32 bufsiz;
+    u32 remaining;
+    volatile bool stop;
+    bool error;
+    LightEvent filled[2];
+    LightEvent emptied[2];
+} FsReadAhead;
 
 struct fsAlphabetizeFoldersFiles {
     inline bool operator()(FileInfoEx a, FileInfoEx b) {
@@ -47,6 +65,7 @@ u64 fsGetFreeSpace() {
 
 bool fsExists(const std::string path) {
     FILE* fd = fopen(path.c_str(), "r");
+    PROF_ADD(P_OPENS, 1);
     if(fd) {
         fclose(fd);
         return true;
@@ -74,6 +93,25 @@ std::string fsGetFileName(const std::string path) {
     return path.substr(slashPos + 1);
 }
 
+// "sdmc://a/b/" -> "sdmc:/a/b", the root keeps its slash
+std::string fsNormalizePath(const std::string path) {
+    std::string result;
+    result.reserve(path.size());
+    for (std::string::const_iterator it = path.begin(); it != path.end(); it++) {
+        if((*it != '/') || result.empty() || (result[result.size() - 1] != '/')) result += *it;
+    }
+    if((result.size() > 1) && (result[result.size() - 1] == '/') && (result[result.size() - 2] != ':')) result.erase(result.size() - 1);
+    return result;
+}
+
+// expects a normalized path, returns "" for the root
+std::string fsGetParentDir(const std::string path) {
+    std::string::size_type slashPos = path.rfind('/');
+    if((slashPos == std::string::npos) || (slashPos == path.size() - 1)) return "";
+    if((slashPos == 0) || (path[slashPos - 1] == ':')) return path.substr(0, slashPos + 1);
+    return path.substr(0, slashPos);
+}
+
 std::string fsGetExtension(const std::string path) {
     std::string::size_type dotPos = path.rfind('.');
     if(dotPos == std::string::npos) {
@@ -114,6 +152,13 @@ u32 fsGetFileSize(const std::string path) {
     return (u32) st.st_size;
 }
 
+u64 fsGetModifiedTime(const std::string path) {
+    // stat() leaves st_mtime empty on the SD card, the timestamp has to come from the archive
+    u64 mtime = 0;
+    if(R_FAILED(sdmc_getmtime(path.c_str(), &mtime))) return 0;
+    return mtime;
+}
+
 bool fsFileResize(const std::string path, u32 offset, u32 oldsize, u32 newsize, bool showProgress) {
     if(newsize == oldsize) return true;
     
@@ -178,6 +223,7 @@ u32 fsDataSearch(const std::string path, const std::vector<u8> searchTerm, u32 o
     size_t l_bufsiz = (total < CTRX_BUFSIZ) ? total : CTRX_BUFSIZ;
     u8* buffer = (u8*) malloc( l_bufsiz );
     FILE* fp = fopen(path.c_str(), "rb");
+    PROF_ADD(P_OPENS, 1);
     if((!searchTerm.empty()) && (fp != NULL) && (buffer != NULL)) {
         size_t size = 0;
         for (u64 i = 0; (i < totalPlus) && (offsetFound == (u32) -1); i += size) {
@@ -190,15 +236,13 @@ u32 fsDataSearch(const std::string path, const std::vector<u8> searchTerm, u32 o
                 errno = ECANCELED;
                 break;
             }
+            PROF_ADD(P_SEEKS, 1);
+            PROF_ADD(P_BYTES_READ, size);
             fseek(fp, pos, SEEK_SET);
             if(fread(buffer, 1, size, fp) != size)
                 break;
-            for (u32 p = 0; p <= size - searchTerm.size(); p++) {
-                if(memcmp(buffer + p, searchTerm.data(), searchTerm.size()) == 0) {
-                    offsetFound = pos + p;
-                    break;
-                }
-            }
+            u32 found = memFind(buffer, size, searchTerm.data(), searchTerm.size());
+            if(found != (u32) -1) offsetFound = pos + found;
         }
     }
     if(buffer != NULL) free(buffer);
@@ -255,6 +299,198 @@ bool fsDataReplace(const std::string path, const std::vector<u8> data, u32 offse
     return ret;
 }
 
+u32 fsDataReplaceAll(const std::string path, const std::vector<u8> searchTerm, const std::vector<u8> replaceTerm, bool dryRun, bool showProgress) {
+    // single pass: source is streamed into a temporary file, which replaces the original in the end
+    u64 total = fsGetFileSize(path);
+    u32 termSize = searchTerm.size();
+    u32 count = 0;
+    bool ret = true;
+    if(searchTerm.empty()) {
+        errno = ENOTSUP;
+        return (u32) -1;
+    }
+    
+    std::string tmpPath = path + ".tmp";
+    for (; !dryRun && fsExists(tmpPath); tmpPath.append(1, '_'));
+    
+    size_t l_bufsiz = ((total < CTRX_BUFSIZ) ? total : CTRX_BUFSIZ) + termSize;
+    u8* buffer = (u8*) malloc( l_bufsiz );
+    FILE* fp = fopen(path.c_str(), "rb");
+    FILE* fd = (dryRun) ? NULL : fopen(tmpPath.c_str(), "wb");
+    if((fp != NULL) && (buffer != NULL) && (dryRun || (fd != NULL))) {
+        u64 pos = 0; // file position of buffer start
+        size_t avail = 0;
+        bool eof = false;
+        while(ret && !eof) {
+            if(showProgress && !fsShowProgress((dryRun) ? "Counting" : "Replacing", path, pos, total + 1)) {
+                errno = ECANCELED;
+                ret = false;
+                break;
+            }
+            size_t size = fread(buffer + avail, 1, l_bufsiz - avail, fp);
+            if(size < l_bufsiz - avail) {
+                if(ferror(fp)) {
+                    ret = false;
+                    break;
+                }
+                eof = true;
+            }
+            avail += size;
+            
+            // emit everything up to each match, then the replacement
+            size_t emitted = 0;
+            for (size_t p = 0; p + termSize <= avail; ) {
+                u32 found = memFind(buffer + p, avail - p, searchTerm.data(), termSize);
+                if(found == (u32) -1) break;
+                p += found;
+                if(!dryRun) {
+                    ret = ret && (fwrite(buffer + emitted, 1, p - emitted, fd) == p - emitted);
+                    if(!replaceTerm.empty())
+                        ret = ret && (fwrite(replaceTerm.data(), 1, replaceTerm.size(), fd) == replaceTerm.size());
+                }
+                count++;
+                p += termSize;
+                emitted = p;
+            }
+            
+            // keep a possibly incomplete match at the end of the buffer
+            size_t keep = (eof) ? avail : ((avail < termSize - 1) ? 0 : avail - (termSize - 1));
+            if(keep < emitted) keep = emitted;
+            if(!dryRun) ret = ret && (fwrite(buffer + emitted, 1, keep - emitted, fd) == keep - emitted);
+            memMove(buffer, buffer + keep, avail - keep);
+            avail -= keep;
+            pos += keep;
+        }
+    } else ret = false;
+    
+    if(buffer != NULL) free(buffer);
+    if(fp != NULL) fclose(fp);
+    if(fd != NULL) ret = (fclose(fd) == 0) && ret;
+    
+    if(!dryRun && ret && count) { // swap in the result, keep the original until this succeeded
+        std::string bakPath = path + ".bak";
+        for (; fsExists(bakPath); bakPath.append(1, '_'));
+        if(rename(path.c_str(), bakPath.c_str()) != 0) ret = false;
+        else if(rename(tmpPath.c_str(), path.c_str()) != 0) {
+            rename(bakPath.c_str(), path.c_str());
+            ret = false;
+        } else remove(bakPath.c_str());
+    }
+    if(!dryRun && fsExists(tmpPath)) remove(tmpPath.c_str());
+    
+    return (ret) ? count : (u32) -1;
+}
+
+bool fsDataTransform(const std::string path, Transform transform, const std::vector<u8> param, u32 offset, u32 size, bool showProgress) {
+    u32 unit = (transform == T_SWAP16) ? 2 : (transform == T_SWAP32) ? 4 : (transform == T_SWAP64) ? 8 : 1;
+    bool needParam = (transform == T_FILL) || (transform == T_XOR) || (transform == T_ADD);
+    u64 total = fsGetFileSize(path);
+    if((offset + size > total) || (size % unit) || (needParam && param.empty())) {
+        errno = ENOTSUP;
+        return false;
+    }
+    if(size == 0) return true;
+
+    bool ret = true;
+    size_t l_bufsiz = (size < CTRX_BUFSIZ) ? size : CTRX_BUFSIZ;
+    u8* buffer = (u8*) malloc( l_bufsiz );
+    FILE* fp = fopen(path.c_str(), "rb+");
+    if((fp != NULL) && (buffer != NULL)) {
+        size_t l_size;
+        for (u32 pos = 0; ret && (pos < size); pos += l_size) {
+            l_size = (size - pos < l_bufsiz) ? size - pos : l_bufsiz;
+            if(showProgress && !fsShowProgress("Transforming", path, pos, size)) {
+                errno = ECANCELED;
+                ret = false;
+                break;
+            }
+            if(transform != T_FILL) {
+                ret = ret && (fseek(fp, offset + pos, SEEK_SET) == 0);
+                ret = ret && (fread(buffer, 1, l_size, fp) == l_size);
+                if(!ret) break;
+            }
+            switch(transform) {
+                case T_FILL:
+                    memFillPattern(buffer, l_size, param.data(), param.size(), pos % param.size());
+                    break;
+                case T_XOR:
+                    memXorPattern(buffer, l_size, param.data(), param.size(), pos % param.size());
+                    break;
+                case T_ADD:
+                    memAddByte(buffer, l_size, param.at(0));
+                    break;
+                case T_INVERT:
+                    memInvert(buffer, l_size);
+                    break;
+                default:
+                    memSwap(buffer, l_size, unit);
+                    break;
+            }
+            ret = ret && (fseek(fp, offset + pos, SEEK_SET) == 0);
+            ret = ret && (fwrite(buffer, 1, l_size, fp) == l_size);
+        }
+    } else ret = false;
+
+    if(buffer != NULL) free(buffer);
+    if(fp != NULL) fclose(fp);
+
+    return ret;
+}
+
+bool fsDataCompare(const std::string path0, const std::string path1, std::vector<DataRange> &diffs, u32 maxDiffs, bool showProgress) {
+    const u32 mergeGap = 8; // differences closer than this end up in one range
+    u32 size0 = fsGetFileSize(path0);
+    u32 size1 = fsGetFileSize(path1);
+    u32 common = (size0 < size1) ? size0 : size1;
+    u32 total = (size0 > size1) ? size0 : size1;
+    
+    auto addDiff = [&](u32 offset, u32 size) {
+        if(!diffs.empty() && (diffs.back().offset + diffs.back().size + mergeGap >= offset))
+            diffs.back().size = offset + size - diffs.back().offset;
+        else diffs.push_back({offset, size});
+    };
+    
+    bool ret = true;
+    size_t l_bufsiz = (common < CTRX_BUFSIZ) ? common : CTRX_BUFSIZ;
+    u8* buffer0 = (u8*) malloc( l_bufsiz );
+    u8* buffer1 = (u8*) malloc( l_bufsiz );
+    FILE* fp0 = fopen(path0.c_str(), "rb");
+    FILE* fp1 = fopen(path1.c_str(), "rb");
+    PROF_ADD(P_OPENS, 2);
+    diffs.clear();
+    if((fp0 != NULL) && (fp1 != NULL) && ((common == 0) || ((buffer0 != NULL) && (buffer1 != NULL)))) {
+        size_t l_size;
+        for (u32 pos = 0; ret && (pos < common) && (diffs.size() < maxDiffs); pos += l_size) {
+            l_size = (common - pos < l_bufsiz) ? common - pos : l_bufsiz;
+            if(showProgress && !fsShowProgress("Comparing", path0, pos, total)) {
+                errno = ECANCELED;
+                ret = false;
+                break;
+            }
+            ret = ret && (fread(buffer0, 1, l_size, fp0) == l_size);
+            ret = ret && (fread(buffer1, 1, l_size, fp1) == l_size);
+            PROF_ADD(P_BYTES_READ, 2 * l_size);
+            // equal data is skipped word-wise, differing runs are usually short
+            for (u32 p = 0; ret && (p < l_size) && (diffs.size() < maxDiffs); ) {
+                u32 found = memMismatch(buffer0 + p, buffer1 + p, l_size - p);
+                if(found == (u32) -1) break;
+                u32 start = p + found;
+                for (p = start + 1; (p < l_size) && (buffer0[p] != buffer1[p]); p++);
+                addDiff(pos + start, p - start);
+            }
+        }
+        if(ret && (size0 != size1) && (diffs.size() < maxDiffs))
+            addDiff(common, total - common);
+    } else ret = false;
+    
+    if(buffer0 != NULL) free(buffer0);
+    if(buffer1 != NULL) free(buffer1);
+    if(fp0 != NULL) fclose(fp0);
+    if(fp1 != NULL) fclose(fp1);
+    
+    return ret;
+}
+
 bool fsDataProvider(const std::string path, u32 offset, u32 buffSize, std::function<bool(u32 &offset, bool &forceRefresh)> onLoop, std::function<bool(u8* data)> onUpdate) {
     if((onLoop == NULL) || (onUpdate == NULL)) {
         errno = ENOTSUP;
@@ -282,34 +518,42 @@ bool fsDataProvider(const std::string path, u32 offset, u32 buffSize, std::funct
         return false;
     }
     
+    PROF_ADD(P_OPENS, 1);
     while(core::running()) {
         if(((offset != offsetPrev) || forceRefresh) && (offset <= fileSize)) {
+            PROF_START(readStart);
+            PROF_ADD(P_SEEKS, 1);
             if (forceRefresh) {
                 fclose(fp);
                 fileSize = fsGetFileSize(path);
                 fp = fopen(path.c_str(), "rb");
+                PROF_ADD(P_OPENS, 1);
                 if(fp == NULL) break;
                 if(offset > fileSize) offset = fileSize;
                 fseek(fp, offset, SEEK_SET);
                 fread(buffer, 1, buffSize, fp);
+                PROF_ADD(P_BYTES_READ, buffSize);
                 forceRefresh = false;
             } else if(offset < offsetPrev) {
                 u32 dataEnd = offset + buffSize;
                 u32 overlap = (dataEnd > offsetPrev) ? dataEnd - offsetPrev : 0;
-                memmove(bufferEnd - overlap, buffer, overlap);
+                memMove(bufferEnd - overlap, buffer, overlap);
                 fseek(fp, offset, SEEK_SET);
                 fread(buffer, 1, buffSize - overlap, fp);
+                PROF_ADD(P_BYTES_READ, buffSize - overlap);
             } else {
                 u32 dataEnd = offset + buffSize;
                 u32 dataEndPrev = offsetPrev + buffSize;
                 u32 overlap = (dataEndPrev > offset) ? dataEndPrev - offset : 0;
-                memmove(buffer, bufferEnd - overlap, overlap);
+                memMove(buffer, bufferEnd - overlap, overlap);
                 if(dataEnd > fileSize) {
-                    memset(buffer + overlap, 0x00, buffSize - overlap);
+                    memFill(buffer + overlap, buffSize - overlap, 0x00);
                 }
                 fseek(fp, offset + overlap, SEEK_SET);
                 fread(buffer + overlap, 1, buffSize - overlap, fp);
+                PROF_ADD(P_BYTES_READ, buffSize - overlap);
             }
+            PROF_STOP(readStart, P_READ_TIME);
             offsetPrev = offset;
             if(onUpdate(buffer)) {
                 result = true;
@@ -329,6 +573,121 @@ bool fsDataProvider(const std::string path, u32 offset, u32 buffSize, std::funct
     return result;
 }
 
+static u32 fsReadAheadFill(FsReadAhead &ra, u32 index) {
+    u32 l_size = (ra.remaining < ra.bufsiz) ? ra.remaining : ra.bufsiz;
+    if((l_size > 0) && (fread(ra.buffer[index], 1, l_size, ra.fp) != l_size)) {
+        ra.error = true;
+        l_size = 0;
+    }
+    PROF_ADD(P_BYTES_READ, l_size);
+    ra.remaining -= l_size;
+    ra.size[index] = l_size;
+    return l_size;
+}
+
+static void fsReadAheadThread(void* arg) {
+    FsReadAhead* ra = (FsReadAhead*) arg;
+    for (u32 i = 0; ; i ^= 1) {
+        LightEvent_Wait(&ra->emptied[i]);
+        if(ra->stop) break;
+        u32 l_size = fsReadAheadFill(*ra, i);
+        LightEvent_Signal(&ra->filled[i]);
+        if(l_size == 0) break;
+    }
+}
+
+bool fsDataStream(const std::string path, u32 offset, u32 size, const std::string operationStr, std::function<bool(const u8* data, u32 size)> onData, bool showProgress) {
+    if(onData == NULL) {
+        errno = ENOTSUP;
+        return false;
+    }
+    u32 total = fsGetFileSize(path);
+    if((offset > total) || (size > total - offset)) {
+        errno = ENOTSUP;
+        return false;
+    }
+    
+    // two buffers: a reader thread fills one while the other is processed here
+    FsReadAhead ra;
+    ra.bufsiz = (size < FS_STREAM_BUFSIZ) ? size : FS_STREAM_BUFSIZ;
+    ra.buffer[0] = (u8*) malloc( ra.bufsiz );
+    ra.buffer[1] = (size > ra.bufsiz) ? (u8*) malloc( ra.bufsiz ) : NULL;
+    ra.remaining = size;
+    ra.stop = false;
+    ra.error = false;
+    ra.fp = fopen(path.c_str(), "rb");
+    PROF_ADD(P_OPENS, 1);
+    
+    bool ret = (ra.fp != NULL) && ((size == 0) || (ra.buffer[0] != NULL)) && ((size <= ra.bufsiz) || (ra.buffer[1] != NULL));
+    if(ret && (offset > 0)) {
+        PROF_ADD(P_SEEKS, 1);
+        ret = (fseek(ra.fp, offset, SEEK_SET) == 0);
+    }
+    
+    Thread thread = NULL;
+    if(ret && (ra.buffer[1] != NULL)) {
+        for (u32 i = 0; i < 2; i++) {
+            LightEvent_Init(&ra.filled[i], RESET_ONESHOT);
+            LightEvent_Init(&ra.emptied[i], RESET_ONESHOT);
+            LightEvent_Signal(&ra.emptied[i]);
+        }
+        // above our own priority, the reader mostly waits for the SD card and should resume as soon as it can
+        s32 priority = 0x30;
+        svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+        thread = threadCreate(fsReadAheadThread, &ra, FS_STREAM_STACK, priority - 1, -2, false);
+    }
+    
+    // without a thread (single buffer or no thread available) data is read in place
+    u32 pos = 0;
+    for (u32 i = 0; ret; i ^= (thread != NULL) ? 1 : 0) {
+        if(showProgress && !fsShowProgress(operationStr, path, pos, (size > 0) ? size : 1)) {
+            errno = ECANCELED;
+            ret = false;
+            break;
+        }
+        u32 l_size;
+        if(thread != NULL) {
+            LightEvent_Wait(&ra.filled[i]);
+            l_size = ra.size[i];
+        } else l_size = fsReadAheadFill(ra, i);
+        if(l_size == 0) break;
+        if(!onData(ra.buffer[i], l_size)) {
+            ret = false;
+            break;
+        }
+        pos += l_size;
+        if(thread != NULL) LightEvent_Signal(&ra.emptied[i]);
+    }
+    
+    if(thread != NULL) {
+        ra.stop = true;
+        LightEvent_Signal(&ra.emptied[0]);
+        LightEvent_Signal(&ra.emptied[1]);
+        threadJoin(thread, U64_MAX);
+        threadFree(thread);
+    }
+    if(ret && ra.error) errno = EIO;
+    ret = ret && !ra.error && (pos == size);
+    
+    if(ra.buffer[0] != NULL) free(ra.buffer[0]);
+    if(ra.buffer[1] != NULL) free(ra.buffer[1]);
+    if(ra.fp != NULL) fclose(ra.fp);
+    
+    return ret;
+}
+
+bool fsDataHash(const std::string path, u32 offset, u32 size, HashResult &result, u32 types, bool showProgress) {
+    HashContext ctx;
+    hashInit(ctx, types);
+    bool ret = fsDataStream(path, offset, size, "Hashing", [&](const u8* data, u32 l_size) {
+        hashUpdate(ctx, data, l_size);
+        return true;
+    }, showProgress);
+    hashFinal(ctx, result);
+    
+    return ret;
+}
+
 bool fsPathDelete(const std::string path) {
     if(fsIsDirectory(path)) {
         std::vector<FileInfo> contents = fsGetDirectoryContents(path);
@@ -338,7 +697,7 @@ bool fsPathDelete(const std::string path) {
     } else return (remove(path.c_str()) == 0);
 }
 
-bool fsPathCopy(const std::string path, const std::string dest, bool overwrite, bool showProgress) {
+bool fsPathCopy(const std::string path, const std::string dest, bool overwrite, bool showProgress, bool verify, FsCopyStats* stats) {
     if(fsExists(dest)) {
        if(!overwrite) {
             errno = EEXIST;
@@ -367,7 +726,7 @@ bool fsPathCopy(const std::string path, const std::string dest, bool overwrite,
         }
         std::vector<FileInfo> contents = fsGetDirectoryContents(path);
         for (std::vector<FileInfo>::iterator it = contents.begin(); it != contents.end(); it++)
-            if (!fsPathCopy((*it).path, dest + "/" + (*it).name, overwrite, showProgress)) return false;
+            if (!fsPathCopy((*it).path, dest + "/" + (*it).name, overwrite, showProgress, verify, stats)) return false;
         return true;
     } else {
         bool ret = true;
@@ -376,11 +735,24 @@ bool fsPathCopy(const std::string path, const std::string dest, bool overwrite,
         u8* buffer = (u8*) malloc( l_bufsiz );
         FILE* fp = fopen(path.c_str(), "rb");
         FILE* fd = fopen(dest.c_str(), "wb");
+        PROF_ADD(P_OPENS, 2);
+        // the source checksum is taken from the copy buffer, the source is never read twice
+        HashContext ctx;
+        hashInit(ctx, HASH_CRC32);
+        u64 hashTicks = 0;
+        u64 copyStart = svcGetSystemTick();
         if((fp != NULL) && (fd != NULL) && (buffer != NULL)) {
             u64 pos = 0;
             size_t size;
             while ((size = fread(buffer, 1, l_bufsiz, fp)) > 0) {
+                if(verify) {
+                    u64 hashStart = svcGetSystemTick();
+                    hashUpdate(ctx, buffer, size);
+                    hashTicks += svcGetSystemTick() - hashStart;
+                }
                 pos += fwrite(buffer, 1, size, fd);
+                PROF_ADD(P_BYTES_READ, size);
+                PROF_ADD(P_BYTES_WRITTEN, size);
                 if(showProgress && !fsShowProgress("Copying", path, pos, total)) {
                     errno = ECANCELED;
                     ret = false;
@@ -391,7 +763,36 @@ bool fsPathCopy(const std::string path, const std::string dest, bool overwrite,
         } else ret = false;
         if(buffer != NULL) free(buffer);
         if(fp != NULL) fclose(fp);
-        if(fd != NULL) fclose(fd);
+        if(fd != NULL) ret = (fclose(fd) == 0) && ret;
+        u64 copyTicks = svcGetSystemTick() - copyStart - hashTicks;
+        
+        // read back what ended up on the SD card, a write that "succeeded" may still be corrupt
+        u64 verifyStart = svcGetSystemTick();
+        if(ret && verify) {
+            HashResult source;
+            HashResult copy;
+            hashFinal(ctx, source);
+            hashInit(ctx, HASH_CRC32);
+            ret = fsDataStream(dest, 0, total, "Verifying", [&](const u8* data, u32 l_size) {
+                hashUpdate(ctx, data, l_size);
+                return true;
+            }, showProgress);
+            hashFinal(ctx, copy);
+            if(ret && (copy.crc32 != source.crc32)) { // a corrupt copy is not left behind
+                remove(dest.c_str());
+                errno = EIO;
+                ret = false;
+            }
+        }
+        
+        if(ret && (stats != NULL)) {
+            stats->files++;
+            stats->bytes += total;
+            stats->copyTicks += copyTicks;
+            stats->hashTicks += hashTicks;
+            if(verify) stats->verifyTicks += svcGetSystemTick() - verifyStart;
+        }
+        
         return ret;
     }
 }
@@ -455,17 +856,21 @@ bool fsCreateDummyFile(const std::string path, u64 size, u16 content, bool overw
     size_t l_bufsiz = (size < CTRX_BUFSIZ) ? size : CTRX_BUFSIZ;
     u8* buffer = (u8*) malloc( l_bufsiz );
     FILE* fp = fopen(path.c_str(), "wb");
+    PROF_ADD(P_OPENS, 1);
     if((fp != NULL) && (buffer != NULL)) {
-        if(content & 0xFF00) {
+        if(content & 0xFF00) { // incrementing bytes, this repeats after 256 byte
+            u8 pattern[256];
             u8 byte = content & 0xFF;
             u8 inc = (content >> 8) & 0xFF;
-            for(u64 count = 0; count < l_bufsiz; count++, byte += inc)
-                buffer[count] = byte;
-        } else memset(buffer, content, l_bufsiz);
+            for(u32 count = 0; count < 256; count++, byte += inc)
+                pattern[count] = byte;
+            memFillPattern(buffer, l_bufsiz, pattern, 256);
+        } else memFill(buffer, l_bufsiz, content);
         u64 pos = 0;
         for(u64 count = 0; count < size; count += l_bufsiz) {
             if(size - count < l_bufsiz) l_bufsiz = size - count;
             pos += fwrite(buffer, 1, l_bufsiz, fp);
+            PROF_ADD(P_BYTES_WRITTEN, l_bufsiz);
             if(showProgress && !fsShowProgress("Generating", path, pos, size)) {
                 errno = ECANCELED;
                 break;
@@ -478,6 +883,72 @@ bool fsCreateDummyFile(const std::string path, u64 size, u16 content, bool overw
     return ret;
 }
 
+bool fsWalk(const std::string directory, std::function<bool(const std::string &path, u64 size, bool isDirectory)> onEntry, bool showProgress) {
+    // straight from the FS service: FSDIR_Read() returns sizes with the names, stat() would cost a lookup per file
+    const std::string prefix = "sdmc:";
+    FS_Archive archive;
+    if(R_FAILED(FSUSER_OpenArchive(&archive, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, "")))) {
+        errno = EIO;
+        return false;
+    }
+    
+    bool ret = true;
+    FS_DirectoryEntry* entries = (FS_DirectoryEntry*) malloc(FS_LIST_ENTRIES * sizeof(FS_DirectoryEntry));
+    u16* pathUtf16 = (u16*) malloc((FS_LIST_PATH_MAX + 1) * sizeof(u16));
+    u8* name = (u8*) malloc((0x106 * 3) + 1); // worst case UTF-8 for a UTF-16 name
+    std::vector<std::string> dirs(1, directory); // breadth first, also serves as the progress measure
+    for (u32 d = 0; (entries != NULL) && (pathUtf16 != NULL) && (name != NULL) && (d < dirs.size()); d++) {
+        const std::string dir = dirs[d];
+        if(showProgress && !fsShowProgress("Scanning", dir, d, dirs.size())) {
+            errno = ECANCELED;
+            ret = false;
+            break;
+        }
+        
+        std::string archivePath = (dir.compare(0, prefix.size(), prefix) == 0) ? dir.substr(prefix.size()) : dir;
+        if(archivePath.empty()) archivePath = "/";
+        ssize_t units = utf8_to_utf16(pathUtf16, (const u8*) archivePath.c_str(), FS_LIST_PATH_MAX);
+        if((units <= 0) || (units >= FS_LIST_PATH_MAX)) continue;
+        pathUtf16[units] = 0;
+        
+        // unreadable folders are skipped, they can't hold anything the caller could open either
+        Handle handle;
+        if(R_FAILED(FSUSER_OpenDirectory(&handle, archive, fsMakePath(PATH_UTF16, pathUtf16)))) continue;
+        PROF_ADD(P_OPENS, 1);
+        const std::string base = (dir[dir.size() - 1] == '/') ? dir : dir + "/";
+        u32 count;
+        while(R_SUCCEEDED(FSDIR_Read(handle, &count, FS_LIST_ENTRIES, entries)) && (count > 0)) {
+            for (u32 i = 0; i < count; i++) {
+                ssize_t len = utf16_to_utf8(name, entries[i].name, 0x106 * 3);
+                if(len <= 0) continue;
+                name[len] = '\0';
+                const std::string path = base + (const char*) name;
+                bool isDirectory = entries[i].attributes & FS_ATTRIBUTE_DIRECTORY;
+                if(onEntry(path, isDirectory ? 0 : entries[i].fileSize, isDirectory) && isDirectory) dirs.push_back(path);
+            }
+        }
+        FSDIR_Close(handle);
+    }
+    if((entries == NULL) || (pathUtf16 == NULL) || (name == NULL)) {
+        errno = ENOMEM;
+        ret = false;
+    }
+    
+    if(entries != NULL) free(entries);
+    if(pathUtf16 != NULL) free(pathUtf16);
+    if(name != NULL) free(name);
+    FSUSER_CloseArchive(archive);
+    
+    return ret;
+}
+
+bool fsListFiles(const std::string directory, std::vector<FileSizeInfo> &files, bool showProgress) {
+    return fsWalk(directory, [&](const std::string &path, u64 size, bool isDirectory) {
+        if(!isDirectory) files.push_back({path, size});
+        return true;
+    }, showProgress);
+}
+
 std::vector<FileInfo> fsGetDirectoryContents(const std::string directory) {
     std::vector<FileInfo> result;
     bool hasSlash = directory.size() != 0 && directory[directory.size() - 1] == '/';
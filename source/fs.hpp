@@ -1,6 +1,8 @@
 #ifndef __CTRX_FS_HPP__
 #define __CTRX_FS_HPP__
 
+#include "hash.hpp"
+
 #include <citrus/types.hpp>
 
 #include <functional>
@@ -18,25 +20,68 @@ typedef struct {
     bool isDirectory;
 } FileInfoEx;
 
+typedef struct {
+    std::string path;
+    u64 size;
+} FileSizeInfo;
+
+typedef struct {
+    u32 offset;
+    u32 size;
+} DataRange;
+
+typedef enum {
+    T_FILL,
+    T_XOR,
+    T_ADD,
+    T_SWAP16,
+    T_SWAP32,
+    T_SWAP64,
+    T_INVERT
+} Transform;
+
+#define FS_TICKS_PER_MS 268111 // ARM11 system tick
+
+// copies that passed the read back only, times in system ticks (FS_TICKS_PER_MS)
+// hashTicks is the part of copying spent on source checksums
+typedef struct {
+    u32 files;
+    u64 bytes;
+    u64 copyTicks;
+    u64 hashTicks;
+    u64 verifyTicks;
+} FsCopyStats;
+
+bool fsShowProgress(const std::string operationStr, const std::string pathStr, u64 pos, u64 totalSize);
 u64 fsGetFreeSpace();
 bool fsExists(const std::string path);
 bool fsIsDirectory(const std::string path);
 std::string fsGetFileName(const std::string path);
+std::string fsNormalizePath(const std::string path);
+std::string fsGetParentDir(const std::string path);
 std::string fsGetExtension(const std::string path);
 bool fsHasExtension(const std::string path, const std::string extension);
 bool fsHasExtensions(const std::string path, const std::vector<std::string> extensions);
 u32 fsGetFileSize(const std::string path);
+u64 fsGetModifiedTime(const std::string path); // 0 if not available
 bool fsFileResize(const std::string path, u32 offset, u32 oldsize, u32 newsize, bool showProgress = false);
 u32 fsDataSearch(const std::string path, const std::vector<u8> searchTerm, u32 offset = 0, bool showProgress = false);
 std::vector<u8> fsDataGet(const std::string path, u32 offset, u32 size);
 bool fsDataReplace(const std::string path, const std::vector<u8> data, u32 offset, u32 size);
+u32 fsDataReplaceAll(const std::string path, const std::vector<u8> searchTerm, const std::vector<u8> replaceTerm, bool dryRun = false, bool showProgress = false);
+bool fsDataTransform(const std::string path, Transform transform, const std::vector<u8> param, u32 offset, u32 size, bool showProgress = false);
+bool fsDataCompare(const std::string path0, const std::string path1, std::vector<DataRange> &diffs, u32 maxDiffs = 0x10000, bool showProgress = false);
 bool fsDataProvider(const std::string path, u32 offset, u32 buffSize, std::function<bool(u32 &offset, bool &forceRefresh)> onLoop, std::function<bool(u8* data)> onUpdate);
+bool fsDataStream(const std::string path, u32 offset, u32 size, const std::string operationStr, std::function<bool(const u8* data, u32 size)> onData, bool showProgress = false);
+bool fsDataHash(const std::string path, u32 offset, u32 size, HashResult &result, u32 types = HASH_ALL, bool showProgress = false);
 bool fsPathDelete(const std::string path);
-bool fsPathCopy(const std::string path, const std::string dest, bool overwrite = false, bool showProgress = false);
+bool fsPathCopy(const std::string path, const std::string dest, bool overwrite = false, bool showProgress = false, bool verify = false, FsCopyStats* stats = NULL);
 bool fsPathMove(const std::string path, const std::string dest, bool overwrite = false);
 bool fsPathRename(const std::string path, const std::string dest);
 bool fsCreateDir(const std::string path);
 bool fsCreateDummyFile(const std::string path, u64 size = 0, u16 content = 0x0000, bool overwrite = false, bool showProgress = false);
+bool fsWalk(const std::string directory, std::function<bool(const std::string &path, u64 size, bool isDirectory)> onEntry, bool showProgress = false); // false skips a folder
+bool fsListFiles(const std::string directory, std::vector<FileSizeInfo> &files, bool showProgress = false);
 std::vector<FileInfo> fsGetDirectoryContents(const std::string directory);
 std::vector<FileInfoEx> fsGetDirectoryContentsEx(const std::string directory);
 
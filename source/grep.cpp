@@ -0,0 +1,126 @@
+#include "grep.hpp"
+#include "fs.hpp"
+
+#include <sys/errno.h>
+
+#include <algorithm>
+
+// dense automaton, every state has a transition for every byte, so matching is one lookup per byte
+typedef struct {
+    std::vector<u16> next; // state * 256 + byte
+    std::vector<u16> out; // patterns ending in this state (including the ones reached through failure links)
+    std::vector<u32> lengths;
+} GrepAutomaton;
+
+static bool grepBuild(const std::vector<std::vector<u8>> &patterns, GrepAutomaton &ac) {
+    const u16 none = 0xFFFF;
+    u32 states = 1;
+    for (std::vector<std::vector<u8>>::const_iterator it = patterns.begin(); it != patterns.end(); it++) states += (*it).size();
+    if((patterns.size() > GREP_MAX_PATTERNS) || (states > GREP_MAX_STATES)) {
+        errno = E2BIG;
+        return false;
+    }
+
+    // trie first
+    ac.next.assign(states * 256, none);
+    ac.out.assign(states, 0);
+    ac.lengths.clear();
+    u32 used = 1;
+    for (u32 p = 0; p < patterns.size(); p++) {
+        u32 state = 0;
+        for (std::vector<u8>::const_iterator c = patterns[p].begin(); c != patterns[p].end(); c++) {
+            if(ac.next[state * 256 + *c] == none) ac.next[state * 256 + *c] = used++;
+            state = ac.next[state * 256 + *c];
+        }
+        ac.out[state] |= 1 << p;
+        ac.lengths.push_back(patterns[p].size());
+    }
+
+    // then failure links breadth first, missing transitions take the one of the failure state
+    std::vector<u16> fail(used, 0);
+    std::vector<u16> queue;
+    for (u32 c = 0; c < 256; c++) {
+        u16 &t = ac.next[c];
+        if(t == none) t = 0;
+        else queue.push_back(t);
+    }
+    for (u32 q = 0; q < queue.size(); q++) {
+        u16 state = queue[q];
+        ac.out[state] |= ac.out[fail[state]];
+        for (u32 c = 0; c < 256; c++) {
+            u16 &t = ac.next[state * 256 + c];
+            if(t == none) t = ac.next[fail[state] * 256 + c];
+            else {
+                fail[t] = ac.next[fail[state] * 256 + c];
+                queue.push_back(t);
+            }
+        }
+    }
+    ac.next.resize(used * 256);
+    ac.out.resize(used);
+
+    return true;
+}
+
+bool grepFind(const std::string directory, const std::vector<std::vector<u8>> &patterns, std::vector<GrepHit> &hits, u32 &count, bool showProgress) {
+    GrepAutomaton ac;
+    hits.clear();
+    count = 0;
+    for (std::vector<std::vector<u8>>::const_iterator it = patterns.begin(); it != patterns.end(); it++) {
+        if((*it).empty()) {
+            errno = EINVAL;
+            return false;
+        }
+    }
+    if(patterns.empty() || !grepBuild(patterns, ac)) {
+        if(patterns.empty()) errno = EINVAL;
+        return false;
+    }
+
+    std::vector<FileSizeInfo> files;
+    if(!fsListFiles(directory, files, showProgress)) return false;
+    std::sort(files.begin(), files.end(), [](const FileSizeInfo &a, const FileSizeInfo &b) { return a.path < b.path; });
+    u64 total = 0;
+    for (std::vector<FileSizeInfo>::iterator it = files.begin(); it != files.end(); it++) total += (*it).size;
+
+    u64 done = 0;
+    for (std::vector<FileSizeInfo>::iterator it = files.begin(); it != files.end(); it++) {
+        const FileSizeInfo &file = *it;
+        if(showProgress && !fsShowProgress("Searching", file.path, done, total + 1)) {
+            errno = ECANCELED;
+            return false;
+        }
+        if(file.size == 0) continue;
+
+        // one state across all chunks, hits spanning a chunk border are found like any other
+        const u16* next = ac.next.data();
+        const u16* out = ac.out.data();
+        u32 state = 0;
+        u32 pos = 0;
+        errno = 0; // unreadable files are skipped, only a cancel ends the search
+        if(!fsDataStream(file.path, 0, (u32) file.size, "Searching", [&](const u8* data, u32 size) {
+                for (u32 i = 0; i < size; i++) {
+                    state = next[(state << 8) | data[i]];
+                    if(out[state] == 0) continue;
+                    for (u32 p = 0; p < ac.lengths.size(); p++) {
+                        if(!(out[state] & (1 << p))) continue;
+                        if(count++ < GREP_MAX_HITS) hits.push_back({file.path, pos + i + 1 - ac.lengths[p], p});
+                    }
+                }
+                pos += size;
+                if(showProgress && !fsShowProgress("Searching", file.path, done + pos, total + 1)) {
+                    errno = ECANCELED;
+                    return false;
+                }
+                return true;
+            }, false) && (errno == ECANCELED)) return false;
+        done += file.size;
+    }
+
+    // several patterns may hit one file, keep them in offset order there
+    std::stable_sort(hits.begin(), hits.end(), [](const GrepHit &a, const GrepHit &b) {
+        return (a.path != b.path) ? (a.path < b.path) : (a.offset < b.offset);
+    });
+
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef __CTRX_GREP_HPP__
+#define __CTRX_GREP_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define GREP_MAX_PATTERNS 16
+#define GREP_MAX_STATES 1024 // total pattern length + 1, the automaton takes 512 bytes per state
+#define GREP_MAX_HITS 1000
+
+typedef struct {
+    std::string path;
+    u32 offset;
+    u32 pattern; // index into the pattern list
+} GrepHit;
+
+// searches every file below directory for all patterns at once, each file is read a single time
+// patterns are matched as raw bytes with an Aho-Corasick automaton, overlapping hits are all reported
+// hits are in path order, returns the total number of hits (not capped) in count
+// returns false and sets errno on failure or cancel (ECANCELED), E2BIG if the patterns are too long
+bool grepFind(const std::string directory, const std::vector<std::vector<u8>> &patterns, std::vector<GrepHit> &hits, u32 &count, bool showProgress = false);
+
+#endif
@@ -0,0 +1,207 @@
+#include "hash.hpp"
+#include "mem.hpp"
+
+#include <string.h>
+
+static const u32 hashMd5K[64] = {
+    0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+    0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+    0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+    0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+    0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+    0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+    0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+    0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391
+};
+
+static const u8 hashMd5Shift[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+static const u32 hashSha256K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static inline u32 hashRotl(u32 x, u32 n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline u32 hashRotr(u32 x, u32 n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline u32 hashLoadLE(const u8* ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((u32) ptr[3] << 24);
+}
+
+static inline u32 hashLoadBE(const u8* ptr) {
+    return ((u32) ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+static void hashMd5Blocks(u32* state, const u8* data, u32 nBlocks) {
+    for (; nBlocks > 0; nBlocks--, data += 64) {
+        u32 m[16];
+        for (u32 i = 0; i < 16; i++)
+            m[i] = hashLoadLE(data + (i * 4));
+
+        u32 a = state[0], b = state[1], c = state[2], d = state[3];
+        // one loop per round function, message word order and shifts come from the tables
+        #define MD5_STEP(f, g) { u32 t = b + hashRotl(a + (f) + hashMd5K[i] + m[g], hashMd5Shift[i >> 4][i & 3]); a = d; d = c; c = b; b = t; }
+        for (u32 i = 0; i < 16; i++) MD5_STEP(d ^ (b & (c ^ d)), i);
+        for (u32 i = 16; i < 32; i++) MD5_STEP(c ^ (d & (b ^ c)), ((5 * i) + 1) & 15);
+        for (u32 i = 32; i < 48; i++) MD5_STEP(b ^ c ^ d, ((3 * i) + 5) & 15);
+        for (u32 i = 48; i < 64; i++) MD5_STEP(c ^ (b | ~d), (7 * i) & 15);
+        #undef MD5_STEP
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+}
+
+static void hashSha1Blocks(u32* state, const u8* data, u32 nBlocks) {
+    for (; nBlocks > 0; nBlocks--, data += 64) {
+        u32 w[16]; // message schedule as a ring, w[i & 15] is expanded in place
+        for (u32 i = 0; i < 16; i++)
+            w[i] = hashLoadBE(data + (i * 4));
+
+        u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        #define SHA1_W(i) (((i) < 16) ? w[i] : (w[(i) & 15] = hashRotl(w[((i) - 3) & 15] ^ w[((i) - 8) & 15] ^ w[((i) - 14) & 15] ^ w[(i) & 15], 1)))
+        #define SHA1_STEP(f, k) { u32 t = hashRotl(a, 5) + (f) + e + (k) + SHA1_W(i); e = d; d = c; c = hashRotl(b, 30); b = a; a = t; }
+        for (u32 i = 0; i < 20; i++) SHA1_STEP(d ^ (b & (c ^ d)), 0x5A827999);
+        for (u32 i = 20; i < 40; i++) SHA1_STEP(b ^ c ^ d, 0x6ED9EBA1);
+        for (u32 i = 40; i < 60; i++) SHA1_STEP((b & c) | (d & (b | c)), 0x8F1BBCDC);
+        for (u32 i = 60; i < 80; i++) SHA1_STEP(b ^ c ^ d, 0xCA62C1D6);
+        #undef SHA1_STEP
+        #undef SHA1_W
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+static void hashSha256Blocks(u32* state, const u8* data, u32 nBlocks) {
+    for (; nBlocks > 0; nBlocks--, data += 64) {
+        u32 w[64];
+        for (u32 i = 0; i < 16; i++)
+            w[i] = hashLoadBE(data + (i * 4));
+        for (u32 i = 16; i < 64; i++) {
+            u32 s0 = hashRotr(w[i - 15], 7) ^ hashRotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            u32 s1 = hashRotr(w[i - 2], 17) ^ hashRotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        u32 a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+        for (u32 i = 0; i < 64; i++) {
+            u32 t0 = h + (hashRotr(e, 6) ^ hashRotr(e, 11) ^ hashRotr(e, 25)) + (g ^ (e & (f ^ g))) + hashSha256K[i] + w[i];
+            u32 t1 = (hashRotr(a, 2) ^ hashRotr(a, 13) ^ hashRotr(a, 22)) + ((a & b) | (c & (a | b)));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t0;
+            d = c;
+            c = b;
+            b = a;
+            a = t0 + t1;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+// one algorithm at a time over all blocks, keeps the working set of each kernel in cache
+static void hashBlocks(HashContext &ctx, const u8* data, u32 nBlocks) {
+    if(nBlocks == 0) return;
+    if(ctx.types & HASH_MD5) hashMd5Blocks(ctx.md5, data, nBlocks);
+    if(ctx.types & HASH_SHA1) hashSha1Blocks(ctx.sha1, data, nBlocks);
+    if(ctx.types & HASH_SHA256) hashSha256Blocks(ctx.sha256, data, nBlocks);
+}
+
+void hashInit(HashContext &ctx, u32 types) {
+    static const u32 md5Init[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+    static const u32 sha1Init[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    static const u32 sha256Init[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+    ctx.types = types;
+    ctx.crc32 = 0;
+    memcpy(ctx.md5, md5Init, sizeof(ctx.md5));
+    memcpy(ctx.sha1, sha1Init, sizeof(ctx.sha1));
+    memcpy(ctx.sha256, sha256Init, sizeof(ctx.sha256));
+    ctx.size = 0;
+}
+
+void hashUpdate(HashContext &ctx, const u8* data, u32 size) {
+    if(ctx.types & HASH_CRC32) ctx.crc32 = memCrc32(ctx.crc32, data, size);
+
+    u32 fill = ctx.size & 63;
+    ctx.size += size;
+    if(!(ctx.types & (HASH_MD5 | HASH_SHA1 | HASH_SHA256))) return;
+
+    if(fill > 0) {
+        u32 l_size = (size < 64 - fill) ? size : 64 - fill;
+        memcpy(ctx.block + fill, data, l_size);
+        data += l_size;
+        size -= l_size;
+        if(fill + l_size < 64) return;
+        hashBlocks(ctx, ctx.block, 1);
+    }
+
+    hashBlocks(ctx, data, size / 64);
+    memcpy(ctx.block, data + (size & ~63), size & 63);
+}
+
+void hashFinal(HashContext &ctx, HashResult &result) {
+    memset(&result, 0, sizeof(result));
+    result.types = ctx.types;
+    result.crc32 = ctx.crc32;
+
+    // 0x80, zeroes, then the length in bits: little endian for MD5, big endian for SHA
+    u64 bits = ctx.size * 8;
+    u32 fill = ctx.size & 63;
+    u32 padSize = (fill < 56) ? 64 : 128;
+    u8 pad[128];
+    memcpy(pad, ctx.block, fill);
+    pad[fill] = 0x80;
+    memset(pad + fill + 1, 0, padSize - fill - 1);
+
+    if(ctx.types & HASH_MD5) {
+        for (u32 i = 0; i < 8; i++)
+            pad[padSize - 8 + i] = (u8) (bits >> (i * 8));
+        hashMd5Blocks(ctx.md5, pad, padSize / 64);
+        for (u32 i = 0; i < 16; i++)
+            result.md5[i] = (u8) (ctx.md5[i / 4] >> ((i % 4) * 8));
+    }
+
+    for (u32 i = 0; i < 8; i++)
+        pad[padSize - 1 - i] = (u8) (bits >> (i * 8));
+    if(ctx.types & HASH_SHA1) {
+        hashSha1Blocks(ctx.sha1, pad, padSize / 64);
+        for (u32 i = 0; i < 20; i++)
+            result.sha1[i] = (u8) (ctx.sha1[i / 4] >> ((3 - (i % 4)) * 8));
+    }
+    if(ctx.types & HASH_SHA256) {
+        hashSha256Blocks(ctx.sha256, pad, padSize / 64);
+        for (u32 i = 0; i < 32; i++)
+            result.sha256[i] = (u8) (ctx.sha256[i / 4] >> ((3 - (i % 4)) * 8));
+    }
+}
+
+void hashFormat(FmtBuffer &buf, const u8* digest, u32 size) {
+    for (u32 i = 0; i < size; i++)
+        fmtHex(buf, digest[i], 2);
+}
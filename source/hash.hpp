@@ -0,0 +1,39 @@
+#ifndef __CTRX_HASH_HPP__
+#define __CTRX_HASH_HPP__
+
+#include "fmt.hpp"
+
+#include <citrus/types.hpp>
+
+#define HASH_CRC32 (1 << 0)
+#define HASH_MD5 (1 << 1)
+#define HASH_SHA1 (1 << 2)
+#define HASH_SHA256 (1 << 3)
+#define HASH_ALL (HASH_CRC32 | HASH_MD5 | HASH_SHA1 | HASH_SHA256)
+
+// running state of all selected hashes, data is fed once and shared by every algorithm
+// MD5, SHA-1 and SHA-256 use the same 64 byte block, full blocks are hashed straight from the input
+typedef struct {
+    u32 types; // HASH_* mask
+    u32 crc32;
+    u32 md5[4];
+    u32 sha1[5];
+    u32 sha256[8];
+    u64 size; // bytes hashed so far
+    u8 block[64]; // partial block
+} HashContext;
+
+typedef struct {
+    u32 types;
+    u32 crc32;
+    u8 md5[16];
+    u8 sha1[20];
+    u8 sha256[32];
+} HashResult;
+
+void hashInit(HashContext &ctx, u32 types = HASH_ALL);
+void hashUpdate(HashContext &ctx, const u8* data, u32 size);
+void hashFinal(HashContext &ctx, HashResult &result);
+void hashFormat(FmtBuffer &buf, const u8* digest, u32 size); // upper case hex, no separators
+
+#endif
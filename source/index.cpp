@@ -0,0 +1,324 @@
+#include "index.hpp"
+#include "fs.hpp"
+
+#include <3ds.h>
+
+#include <sys/errno.h>
+#include <string.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+
+typedef struct {
+    u64 mtime;
+    std::vector<std::string> names; // sorted, folders end with '/'
+} IndexDir;
+
+static std::map<std::string, IndexDir> indexDirs; // searched, only read while an update runs
+static std::map<std::string, IndexDir> indexNext; // written by the update
+static std::set<std::string> indexStale; // touched folders for the next update
+static std::set<std::string> indexJobStale; // touched folders of the running update
+static bool indexJobCheckAll = false;
+static bool indexJobOk = false;
+static bool indexLoaded = false;
+
+static Thread indexThread = NULL;
+static volatile bool indexDone = false;
+static volatile bool indexCancel = false;
+static volatile u32 indexDirsDone = 0;
+static volatile u32 indexDirsKnown = 0;
+
+static inline u8 indexLower(u8 c) {
+    return ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+}
+
+// on file: "CTRXIDX1", folder count, then per folder its path, mtime, name count and names
+// paths and names are stored as (shared prefix with the previous one, suffix length, suffix) in varints
+static void indexPutVarint(std::string &out, u32 value) {
+    for (; value >= 0x80; value >>= 7) out += (char) ((value & 0x7F) | 0x80);
+    out += (char) value;
+}
+
+static void indexPutString(std::string &out, const std::string &prev, const std::string &str) {
+    u32 shared = 0;
+    for (u32 max = std::min(prev.size(), str.size()); (shared < max) && (prev[shared] == str[shared]); shared++);
+    indexPutVarint(out, shared);
+    indexPutVarint(out, str.size() - shared);
+    out.append(str, shared, std::string::npos);
+}
+
+static bool indexGetVarint(const u8* &data, const u8* end, u32 &value) {
+    value = 0;
+    for (u32 shift = 0; (data < end) && (shift < 32); shift += 7) {
+        value |= (u32) (*data & 0x7F) << shift;
+        if(!(*data++ & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool indexGetString(const u8* &data, const u8* end, std::string &str) {
+    u32 shared;
+    u32 len;
+    if(!indexGetVarint(data, end, shared) || !indexGetVarint(data, end, len) || (shared > str.size()) || (len > (u32) (end - data))) return false;
+    str.resize(shared);
+    str.append((const char*) data, len);
+    data += len;
+    return true;
+}
+
+static void indexLoad(std::map<std::string, IndexDir> &dirs) {
+    u32 size = fsGetFileSize(INDEX_PATH);
+    FILE* fp = (size > 12) ? fopen(INDEX_PATH, "rb") : NULL;
+    if(fp == NULL) return;
+    u8* buffer = (u8*) malloc(size);
+    bool ok = (buffer != NULL) && (fread(buffer, 1, size, fp) == size) && (memcmp(buffer, "CTRXIDX1", 8) == 0);
+    fclose(fp);
+
+    // a damaged index is dropped as a whole, the update walks the card again
+    const u8* data = buffer + 8;
+    const u8* end = buffer + size;
+    u32 count = 0;
+    std::string path;
+    ok = ok && indexGetVarint(data, end, count);
+    for (u32 i = 0; ok && (i < count); i++) {
+        u32 nNames = 0;
+        ok = indexGetString(data, end, path) && (end - data >= 8);
+        if(!ok) break;
+        IndexDir &dir = dirs[path];
+        memcpy(&dir.mtime, data, 8);
+        data += 8;
+        ok = indexGetVarint(data, end, nNames) && (nNames <= (u32) (end - data));
+        std::string name;
+        dir.names.reserve(nNames);
+        for (u32 n = 0; ok && (n < nNames); n++) {
+            ok = indexGetString(data, end, name);
+            dir.names.push_back(name);
+        }
+    }
+    if(!ok) dirs.clear();
+    if(buffer != NULL) free(buffer);
+}
+
+static bool indexSave(const std::map<std::string, IndexDir> &dirs) {
+    std::string out = "CTRXIDX1";
+    std::string prevPath;
+    indexPutVarint(out, dirs.size());
+    for (std::map<std::string, IndexDir>::const_iterator it = dirs.begin(); it != dirs.end(); it++) {
+        indexPutString(out, prevPath, (*it).first);
+        prevPath = (*it).first;
+        out.append((const char*) &(*it).second.mtime, 8);
+        indexPutVarint(out, (*it).second.names.size());
+        std::string prevName;
+        for (std::vector<std::string>::const_iterator name = (*it).second.names.begin(); name != (*it).second.names.end(); name++) {
+            indexPutString(out, prevName, *name);
+            prevName = *name;
+        }
+    }
+
+    fsCreateDir(INDEX_DIR);
+    FILE* fp = fopen(INDEX_PATH, "wb");
+    if(fp == NULL) return false;
+    bool ret = (fwrite(out.data(), 1, out.size(), fp) == out.size());
+    return (fclose(fp) == 0) && ret;
+}
+
+// breadth first from the root, unchanged folders are taken over from prev without listing them
+static bool indexUpdate(const std::map<std::string, IndexDir> &prev, std::map<std::string, IndexDir> &next, bool &changed) {
+    std::vector<std::string> queue(1, INDEX_ROOT);
+    changed = false;
+    for (u32 d = 0; d < queue.size(); d++) {
+        if(indexCancel) {
+            errno = ECANCELED;
+            return false;
+        }
+        indexDirsDone = d;
+        indexDirsKnown = queue.size();
+
+        const std::string dir = queue[d];
+        const std::string base = (dir[dir.size() - 1] == '/') ? dir : dir + "/";
+        std::map<std::string, IndexDir>::const_iterator old = prev.find(dir);
+        bool stale = (old == prev.end()) || (indexJobStale.find(dir) != indexJobStale.end());
+        IndexDir &entry = next[dir];
+        entry.mtime = (old != prev.end()) ? (*old).second.mtime : 0;
+        if(indexJobCheckAll || stale) {
+            // stat() has no folder mtime on the SD card, a folder without a timestamp can only be checked by listing it
+            entry.mtime = fsGetModifiedTime(dir);
+            if(entry.mtime == 0) stale = true;
+        }
+        if(!stale && (entry.mtime == (*old).second.mtime)) {
+            entry.names = (*old).second.names;
+        } else {
+            if(!fsWalk(dir, [&](const std::string &path, u64 size, bool isDirectory) {
+                    entry.names.push_back(isDirectory ? path.substr(base.size()) + "/" : path.substr(base.size()));
+                    return false;
+                }, false)) return false;
+            std::sort(entry.names.begin(), entry.names.end());
+            // relisting alone is no change, the file is only written again if something differs
+            if((old == prev.end()) || (entry.names != (*old).second.names) || (entry.mtime != (*old).second.mtime)) changed = true;
+        }
+        for (std::vector<std::string>::iterator it = entry.names.begin(); it != entry.names.end(); it++) {
+            if((*it)[(*it).size() - 1] == '/') queue.push_back(base + (*it).substr(0, (*it).size() - 1));
+        }
+    }
+    if(next.size() != prev.size()) changed = true;
+
+    return true;
+}
+
+static void indexThreadMain(void* arg) {
+    std::map<std::string, IndexDir> loaded;
+    bool changed = false;
+    if(!indexLoaded) indexLoad(loaded);
+    indexNext.clear();
+    indexJobOk = indexUpdate(indexLoaded ? indexDirs : loaded, indexNext, changed);
+    if(indexJobOk && changed) indexSave(indexNext);
+    indexDone = true;
+}
+
+// takes over the result of a finished update, must not be called while searching
+static void indexAdopt() {
+    if((indexThread != NULL) && indexDone) {
+        threadJoin(indexThread, U64_MAX);
+        threadFree(indexThread);
+        indexThread = NULL;
+    }
+    if((indexThread != NULL) || !indexDone) return;
+    if(indexJobOk) {
+        indexDirs.swap(indexNext);
+        indexLoaded = true;
+    } else indexStale.insert(indexJobStale.begin(), indexJobStale.end());
+    indexJobStale.clear();
+    indexNext.clear();
+    indexDone = false;
+}
+
+void indexStart(bool checkAll) {
+    indexAdopt();
+    if((indexThread != NULL) || (indexLoaded && !checkAll && indexStale.empty())) return;
+
+    indexJobStale.swap(indexStale);
+    indexStale.clear();
+    indexJobCheckAll = checkAll;
+    indexCancel = false;
+    indexDone = false;
+    indexDirsDone = 0;
+    indexDirsKnown = 1;
+
+    // below the UI thread, so it only runs while the UI waits for the next frame
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+    indexThread = threadCreate(indexThreadMain, NULL, INDEX_STACK, priority + 1, -2, false);
+    if(indexThread == NULL) {
+        indexThreadMain(NULL);
+        indexAdopt();
+    }
+}
+
+void indexStop() {
+    if(indexThread == NULL) return;
+    indexCancel = true;
+    threadJoin(indexThread, U64_MAX);
+    threadFree(indexThread);
+    indexThread = NULL;
+    indexAdopt();
+}
+
+bool indexWait(bool showProgress) {
+    // folders touched while an update was running are only queued, one more update takes them in
+    for (u32 round = 0; round < 2; round++) {
+        if(round > 0) {
+            if(indexStale.empty() || !indexLoaded) break;
+            indexStart();
+        }
+        while((indexThread != NULL) && !indexDone) {
+            if(showProgress && !fsShowProgress("Indexing", "SD card folders", indexDirsDone, indexDirsKnown + 1)) {
+                errno = ECANCELED;
+                return false;
+            }
+            svcSleepThread(16 * 1000 * 1000); // the update runs at a lower priority
+        }
+        indexAdopt();
+    }
+
+    return true;
+}
+
+bool indexEmpty() {
+    return indexDirs.empty();
+}
+
+void indexTouch(const std::string path) {
+    const std::string parent = fsGetParentDir(fsNormalizePath(path));
+    if(!parent.empty()) indexStale.insert(parent);
+}
+
+// glob over the whole string, '*' matches any run and '?' a single byte, pattern is lower case
+static bool indexGlob(const char* pattern, const char* str, u32 len) {
+    const char* star = NULL;
+    u32 starPos = 0;
+    u32 pos = 0;
+    while(pos < len) {
+        if(*pattern == '*') {
+            star = ++pattern;
+            starPos = pos;
+        } else if((*pattern != '\0') && ((*pattern == '?') || ((u8) *pattern == indexLower(str[pos])))) {
+            pattern++;
+            pos++;
+        } else if(star != NULL) {
+            pattern = star;
+            pos = ++starPos;
+        } else return false;
+    }
+    while(*pattern == '*') pattern++;
+
+    return *pattern == '\0';
+}
+
+static bool indexContains(const char* str, u32 len, const std::string &needle) {
+    u32 size = needle.size();
+    if(size > len) return false;
+    for (u32 i = 0; i <= len - size; i++) {
+        if(indexLower(str[i]) != (u8) needle[0]) continue;
+        u32 n = 1;
+        for (; (n < size) && (indexLower(str[i + n]) == (u8) needle[n]); n++);
+        if(n == size) return true;
+    }
+
+    return false;
+}
+
+u32 indexSearch(const std::string query, std::vector<FileInfoEx> &results, u32 maxResults) {
+    // names are matched, unless the query holds a '/', then it's whole paths below the root
+    std::string needle;
+    for (std::string::const_iterator it = query.begin(); it != query.end(); it++) needle += (char) indexLower(*it);
+    bool glob = (needle.find_first_of("*?") != std::string::npos);
+    bool wholePath = (needle.find('/') != std::string::npos);
+    results.clear();
+    if(needle.empty()) return 0;
+
+    u32 count = 0;
+    std::string path;
+    for (std::map<std::string, IndexDir>::iterator dir = indexDirs.begin(); dir != indexDirs.end(); dir++) {
+        const std::string base = ((*dir).first[(*dir).first.size() - 1] == '/') ? (*dir).first : (*dir).first + "/";
+        for (std::vector<std::string>::iterator it = (*dir).second.names.begin(); it != (*dir).second.names.end(); it++) {
+            const std::string &name = *it;
+            bool isDirectory = (name[name.size() - 1] == '/');
+            u32 nameLen = name.size() - (isDirectory ? 1 : 0);
+            const char* str = name.data();
+            u32 len = nameLen;
+            if(wholePath) {
+                path.assign(base, sizeof(INDEX_ROOT) - 1, std::string::npos);
+                path.append(name, 0, nameLen);
+                str = path.data();
+                len = path.size();
+            }
+            if(glob ? !indexGlob(needle.c_str(), str, len) : !indexContains(str, len, needle)) continue;
+            if(count++ < maxResults) results.push_back({base + name.substr(0, nameLen), name.substr(0, nameLen), isDirectory});
+        }
+    }
+
+    return count;
+}
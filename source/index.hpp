@@ -0,0 +1,30 @@
+#ifndef __CTRX_INDEX_HPP__
+#define __CTRX_INDEX_HPP__
+
+#include "fs.hpp"
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define INDEX_DIR "sdmc:/ctrx"
+#define INDEX_PATH INDEX_DIR "/index.bin"
+#define INDEX_ROOT "sdmc:/"
+#define INDEX_MAX_RESULTS 1000
+#define INDEX_STACK (32 * 1024)
+
+// every path on the SD card, kept folder by folder and stored front coded in INDEX_PATH
+// updates run on a background thread: the first one walks the whole card, later ones only relist folders
+// whose mtime changed or that were touched from within CTRX, the current index stays searchable meanwhile
+// folder timestamps come from fsGetModifiedTime(), where there is none the folder is relisted (a full relist
+// of the card on checkAll), the index file is only written again if a listing actually changed
+
+void indexStart(bool checkAll = false); // checkAll compares the mtime of every folder, otherwise only touched folders are relisted
+void indexStop();
+bool indexWait(bool showProgress = false); // also updates folders touched meanwhile, returns false and sets ECANCELED if cancelled
+bool indexEmpty();
+void indexTouch(const std::string path); // path was created, changed or removed
+u32 indexSearch(const std::string query, std::vector<FileInfoEx> &results, u32 maxResults = INDEX_MAX_RESULTS); // total number of matches
+
+#endif
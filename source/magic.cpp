@@ -0,0 +1,135 @@
+#include "magic.hpp"
+#include "fs.hpp"
+
+#include <sys/errno.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+
+typedef struct {
+    u32 offset;
+    u32 size;
+    const char* magic;
+    const char* mask; // NULL to compare all bytes
+    bool (*check)(const u8* data, u32 size, u32 fileSize); // for signatures too short to be trusted alone
+    const char* type;
+} MagicSignature;
+
+typedef struct {
+    u64 size;
+    u64 mtime;
+    std::string type;
+} MagicCacheEntry;
+
+static std::map<std::string, MagicCacheEntry> magicCache;
+
+// LZ10 / LZ11 (DS and 3DS BIOS): the size after decompression is in the header and the first token is a literal
+static bool magicCheckLz(const u8* data, u32 size, u32 fileSize) {
+    if(size <= 4) return false; // header and the first flag byte
+    u32 outSize = data[1] | (data[2] << 8) | (data[3] << 16);
+    u32 flags = 4;
+    if((outSize == 0) && (data[0] == 0x11)) {
+        if(size <= 8) return false; // extended header
+        outSize = data[4] | (data[5] << 8) | (data[6] << 16) | (data[7] << 24);
+        flags = 8;
+    }
+    return (outSize >= fileSize) && (outSize / 16 <= fileSize) && !(data[flags] & 0x80);
+}
+
+// BMP: file size in the header
+static bool magicCheckBmp(const u8* data, u32 size, u32 fileSize) {
+    return (size >= 6) && ((u32) (data[2] | (data[3] << 8) | (data[4] << 16) | (data[5] << 24)) == fileSize);
+}
+
+// first match wins, longer and more specific signatures come first
+static const MagicSignature magicSignatures[] = {
+    { 0x100, 4, "NCSD", NULL, NULL, "NCSD (CCI/3DS)" },
+    { 0x100, 4, "NCCH", NULL, NULL, "NCCH (CXI/CFA)" },
+    { 0x000, 12, "\x20\x20\x00\x00\x00\x00\x00\x00\x00\x0A\x00\x00",
+        "\xFF\xFF\xFF\xFF\x00\x00\x00\x00\xFF\xFF\xFF\xFF", NULL, "CIA archive" },
+    { 0x000, 4, "3DSX", NULL, NULL, "3DSX executable" },
+    { 0x000, 4, "SMDH", NULL, NULL, "SMDH icon" },
+    { 0x000, 4, "FIRM", NULL, NULL, "FIRM image" },
+    { 0x000, 4, "CBMD", NULL, NULL, "CBMD banner" },
+    { 0x000, 4, "IVFC", NULL, NULL, "IVFC (RomFS)" },
+    { 0x000, 4, "darc", NULL, NULL, "DARC archive" },
+    { 0x000, 4, "SARC", NULL, NULL, "SARC archive" },
+    { 0x000, 4, "NARC", NULL, NULL, "NARC archive" },
+    { 0x000, 4, "CGFX", NULL, NULL, "CGFX graphics" },
+    { 0x000, 4, "CWAV", NULL, NULL, "BCWAV audio" },
+    { 0x000, 4, "CSTM", NULL, NULL, "BCSTM audio" },
+    { 0x0C0, 8, "\x24\xFF\xAE\x51\x69\x9A\xA2\x21", NULL, NULL, "NDS ROM" },
+    { 0x004, 8, "\x24\xFF\xAE\x51\x69\x9A\xA2\x21", NULL, NULL, "GBA ROM" },
+    { 0x000, 8, "\x89PNG\r\n\x1A\n", NULL, NULL, "PNG image" },
+    { 0x000, 3, "\xFF\xD8\xFF", NULL, NULL, "JPEG image" },
+    { 0x000, 4, "GIF8", NULL, NULL, "GIF image" },
+    { 0x000, 2, "BM", NULL, magicCheckBmp, "BMP image" },
+    { 0x000, 4, "PK\x03\x04", NULL, NULL, "ZIP archive" },
+    { 0x000, 4, "PK\x05\x06", NULL, NULL, "ZIP archive" },
+    { 0x000, 6, "7z\xBC\xAF\x27\x1C", NULL, NULL, "7z archive" },
+    { 0x000, 6, "Rar!\x1A\x07", NULL, NULL, "RAR archive" },
+    { 0x000, 3, "\x1F\x8B\x08", NULL, NULL, "GZIP archive" },
+    { 0x000, 4, "\x7F" "ELF", NULL, NULL, "ELF executable" },
+    { 0x000, 4, "%PDF", NULL, NULL, "PDF document" },
+    { 0x000, 12, "RIFF\x00\x00\x00\x00WAVE", "\xFF\xFF\xFF\xFF\x00\x00\x00\x00\xFF\xFF\xFF\xFF", NULL, "WAV audio" },
+    { 0x000, 4, "OggS", NULL, NULL, "Ogg audio" },
+    { 0x000, 4, "fLaC", NULL, NULL, "FLAC audio" },
+    { 0x000, 3, "ID3", NULL, NULL, "MP3 audio" },
+    { 0x000, 1, "\x10", NULL, magicCheckLz, "LZ10 compressed" },
+    { 0x000, 1, "\x11", NULL, magicCheckLz, "LZ11 compressed" }
+};
+
+static const char* magicMatch(const u8* data, u32 size, u32 fileSize) {
+    for (u32 s = 0; s < sizeof(magicSignatures) / sizeof(MagicSignature); s++) {
+        const MagicSignature &sig = magicSignatures[s];
+        if(sig.offset + sig.size > size) continue;
+        const u8* magic = (const u8*) sig.magic;
+        const u8* mask = (const u8*) sig.mask;
+        const u8* test = data + sig.offset;
+        u32 i = 0;
+        if(mask == NULL) i = (memcmp(test, magic, sig.size) == 0) ? sig.size : 0;
+        else while((i < sig.size) && ((test[i] & mask[i]) == magic[i])) i++;
+        if((i == sig.size) && ((sig.check == NULL) || sig.check(data, size, fileSize))) return sig.type;
+    }
+    return NULL;
+}
+
+bool magicDetect(const std::string path, std::string &type) {
+    struct stat st;
+    type.clear();
+    if(stat(path.c_str(), &st) != 0) return false;
+    if(S_ISDIR(st.st_mode)) {
+        errno = EISDIR;
+        return false;
+    }
+
+    // the SD card's stat() has no timestamps, without one the file is always read again
+    u64 mtime = fsGetModifiedTime(path);
+    std::map<std::string, MagicCacheEntry>::iterator it = magicCache.find(path);
+    if((mtime != 0) && (it != magicCache.end()) && ((*it).second.size == (u64) st.st_size) && ((*it).second.mtime == mtime)) {
+        type = (*it).second.type;
+        return true;
+    }
+
+    u8 data[MAGIC_READ_SIZE];
+    u32 size = 0;
+    if(st.st_size > 0) {
+        FILE* fp = fopen(path.c_str(), "rb");
+        if(fp == NULL) return false;
+        size = fread(data, 1, sizeof(data), fp);
+        fclose(fp);
+        if(size == 0) {
+            errno = EIO;
+            return false;
+        }
+    }
+    const char* match = magicMatch(data, size, st.st_size);
+    if(match != NULL) type = match;
+
+    if(magicCache.size() >= MAGIC_CACHE_MAX) magicCache.clear();
+    if(mtime != 0) magicCache[path] = { (u64) st.st_size, mtime, type };
+
+    return true;
+}
@@ -0,0 +1,16 @@
+#ifndef __CTRX_MAGIC_HPP__
+#define __CTRX_MAGIC_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+
+#define MAGIC_READ_SIZE 0x200 // all signatures are found in this much of a file
+#define MAGIC_CACHE_MAX 4096 // cached results, the cache starts over when full
+
+// content based file type ("NCCH (CXI/CFA)", "PNG image", ...), empty if no signature matches
+// results are cached by path, size and modification time, so only changed files are read again
+// returns false and sets errno if the file can't be read
+bool magicDetect(const std::string path, std::string &type);
+
+#endif
@@ -1,11 +1,23 @@
+#include "dupe.hpp"
+#include "entropy.hpp"
+#include "fmt.hpp"
 #include "fs.hpp"
+#include "grep.hpp"
+#include "hash.hpp"
+#include "index.hpp"
+#include "patch.hpp"
+#include "prof.hpp"
+#include "strings.hpp"
 #include "ui.hpp"
+#include "usage.hpp"
+#include "verify.hpp"
 
 #include <citrus/core.hpp>
 #include <citrus/gpu.hpp>
 #include <citrus/gput.hpp>
 #include <citrus/hid.hpp>
 
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <iomanip>
@@ -15,7 +27,14 @@ using namespace ctr;
 typedef enum {
     M_BROWSER,
     M_HEXVIEWER,
-    M_TEXTVIEWER
+    M_TEXTVIEWER,
+    M_COMPARE,
+    M_DUPES,
+    M_USAGE,
+    M_SEARCH,
+    M_GREP,
+    M_ENTROPY,
+    M_STRINGS
 } Mode;
 
 typedef enum  {
@@ -24,7 +43,13 @@ typedef enum  {
     A_COPY,
     A_MOVE,
     A_CREATE_DIR,
-    A_CREATE_DUMMY
+    A_CREATE_DUMMY,
+    A_HASH,
+    A_VERIFY,
+    A_DUPES,
+    A_USAGE,
+    A_SEARCH,
+    A_GREP
 } Action;
 
 int main(int argc, char **argv) {
@@ -59,8 +84,164 @@ int main(int argc, char **argv) {
     std::string hvLastSearchStr = "?";
     std::vector<u8> hvLastSearchHex(1, 0);
     std::vector<u8> hvLastSearch(1, 0);
+    std::vector<u8> hvLastReplaceHex(1, 0);
     std::vector<u8> hvClipboard;
     
+    std::string cmpPath = "";
+    std::vector<DataRange> cmpDiffs;
+    
+    std::string hashPath = "";
+    std::vector<std::string> hashLines;
+    
+    std::string dupeDir = "";
+    std::vector<DupeGroup> dupeGroups;
+    
+    std::string usageRoot = "";
+    std::string usageDir = "";
+    bool usageRefresh = false;
+    
+    std::string searchQuery = "";
+    std::vector<FileInfoEx> searchResults;
+    std::string searchInfo = "";
+    SelectableElement searchFrom = { "", "" };
+    
+    std::vector<std::vector<u8>> grepPatterns;
+    std::vector<GrepHit> grepHits;
+    std::string grepInfo = "";
+    std::string grepDir = "";
+    std::string grepLastId = "";
+    u32 hvStartOffset = (u32) -1;
+    u32 hvStartLength = 0;
+    Mode hvReturnMode = M_BROWSER; // mode to go back to when the hex viewer is closed
+    bool hvReplacePending = false; // replace all was confirmed, it runs once the viewer has closed the file
+    
+    EntropyMap entropyMap;
+    u32 entropyBlock = 0;
+    
+    StringsResult stringsResult = { "", 0, false };
+    std::vector<StringHit> stringsHits; // current page
+    u32 stringsPage = 0;
+    u32 stringsOffset = 0;
+    Mode stringsReturnMode = M_BROWSER;
+    std::string stringsLastId = "";
+    bool stringsRefresh = false;
+    
+    #if defined CTRX_PROFILE
+    bool profShow = false;
+    #endif
+    
+    const std::vector<std::string> patchExtensions = { "ips", "bps" };
+    
+    auto hashData = [&](const std::string path, u32 offset, u32 size, bool wholeFile) {
+        HashResult result;
+        hashPath = "";
+        if(!fsDataHash(path, offset, size, result, HASH_ALL, true)) {
+            uiErrorPrompt(gpu::SCREEN_TOP, "Hashing", fsGetFileName(path), true, false);
+            return;
+        }
+        
+        // digests are split after 32 hex digits to fit the left half of the top screen
+        char str[64];
+        FmtBuffer buf;
+        hashLines.clear();
+        fmtStart(buf, str, sizeof(str));
+        if(wholeFile) fmtString(buf, "Hash of whole file");
+        else {
+            fmtString(buf, "Hash of @");
+            fmtHex(buf, offset, 8);
+            fmtString(buf, " +");
+            fmtBytes(buf, size);
+        }
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, "CRC32  ");
+        fmtHex(buf, result.crc32, 8);
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, "MD5    ");
+        hashFormat(buf, result.md5, 16);
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, "SHA1   ");
+        hashFormat(buf, result.sha1, 16);
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtChar(buf, ' ', 7);
+        hashFormat(buf, result.sha1 + 16, 4);
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, "SHA256 ");
+        hashFormat(buf, result.sha256, 16);
+        hashLines.push_back(str);
+        fmtStart(buf, str, sizeof(str));
+        fmtChar(buf, ' ', 7);
+        hashFormat(buf, result.sha256 + 16, 16);
+        hashLines.push_back(str);
+        hashPath = path;
+    };
+    
+    // ".." stands for the current folder, folders are known from the listing without asking the SD card
+    auto selectedFolder = [&]() {
+        if(currentFile.name.compare("..") == 0) return currentDir;
+        if(!currentFile.details.empty() && (currentFile.details.front().compare("folder") == 0)) return currentFile.id;
+        return std::string("");
+    };
+    
+    auto dupeElements = [&](std::vector<SelectableElement> &elements) {
+        const std::string base = (dupeDir[dupeDir.size() - 1] == '/') ? dupeDir : dupeDir + "/";
+        elements.clear();
+        for(u32 i = 0; i < dupeGroups.size(); i++) {
+            const DupeGroup &group = dupeGroups.at(i);
+            std::stringstream info;
+            info << "group " << (i + 1) << " of " << dupeGroups.size() << " (" << group.paths.size() << " files)";
+            std::vector<std::string> details = { info.str(), uiFormatBytes(group.size) };
+            for(std::vector<std::string>::const_iterator it = group.paths.begin(); it != group.paths.end(); it++) {
+                std::stringstream name;
+                name << "[" << (i + 1) << "] " << (((*it).compare(0, base.size(), base) == 0) ? (*it).substr(base.size()) : *it);
+                elements.push_back({*it, name.str(), details});
+            }
+        }
+    };
+    
+    // subfolders by size, then the largest files, sizes are relative to the shown folder
+    auto usageElements = [&](std::vector<SelectableElement> &elements) {
+        UsageInfo info = { 0, 0, 0 };
+        std::vector<FileSizeInfo> dirs;
+        std::vector<FileSizeInfo> files;
+        usageGet(usageDir, info);
+        usageChildren(usageDir, dirs);
+        usageTopFiles(usageDir, files);
+        const std::string base = (usageDir[usageDir.size() - 1] == '/') ? usageDir : usageDir + "/";
+        auto sizeInfo = [&](u64 size) {
+            std::stringstream ssSize;
+            ssSize << uiFormatBytes(size) << " (" << ((info.size > 0) ? (size * 100) / info.size : 0) << "%)";
+            return ssSize.str();
+        };
+        elements.clear();
+        u64 rest = info.size;
+        for(std::vector<FileSizeInfo>::iterator it = dirs.begin(); it != dirs.end(); it++) {
+            UsageInfo sub = { 0, 0, 0 };
+            usageGet((*it).path, sub);
+            std::stringstream name;
+            name << "[" << std::setw(9) << uiFormatBytes((*it).size) << "] " << fsGetFileName((*it).path) << "/";
+            std::stringstream contents;
+            contents << sub.files << " files, " << sub.dirs << " folders";
+            elements.push_back({(*it).path, name.str(), { "folder", sizeInfo((*it).size), contents.str() }});
+            rest -= (*it).size;
+        }
+        if(info.files > 0) {
+            std::stringstream name;
+            name << "[" << std::setw(9) << uiFormatBytes(rest) << "] (files in this folder)";
+            elements.push_back({"", name.str(), { "files", sizeInfo(rest) }});
+        }
+        for(std::vector<FileSizeInfo>::iterator it = files.begin(); it != files.end(); it++) {
+            std::stringstream name;
+            name << "[" << std::setw(9) << uiFormatBytes((*it).size) << "] " << (*it).path.substr(base.size());
+            elements.push_back({(*it).path, name.str(), { "largest files", sizeInfo((*it).size) }});
+        }
+        if(elements.empty()) elements.push_back({"", "(empty folder)", {}});
+    };
+    
     auto processAction = [&](Action action, bool &updateList, bool &resetCursor) {
         const std::string alphabet = " ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz(){}[]'`^,~!@#$%&0123456789=+-_.";
 
@@ -69,10 +250,14 @@ int main(int argc, char **argv) {
                 if((*markedElements).empty()) {
                     if(currentFile.name.compare("..") != 0) {
                         std::string confirmMsg = "Delete \"" + uiTruncateString(currentFile.name, 24, -8) + "\"?" + "\n";
+                        if(mode == M_DUPES) confirmMsg += "(checked again, its group keeps a copy)\n";
                         if(uiPrompt(gpu::SCREEN_TOP, confirmMsg, true)) {
                             uiDisplayMessage(gpu::SCREEN_TOP, "Deleting files, please wait...");
+                            usageRemove(currentFile.id);
+                            indexTouch(currentFile.id);
                             if(!fsPathDelete(currentFile.id)) {
                                 if (errno == ENOENT) errno = EACCES; // errno fix for write protected files
+                                usageAdd(currentFile.id); // whatever is left of it
                                 uiErrorPrompt(gpu::SCREEN_TOP, "Deleting", currentFile.name, true, false);
                             }
                         }
@@ -87,13 +272,17 @@ int main(int argc, char **argv) {
                         object << "\"" << uiTruncateString((**((*markedElements).begin())).name, 24, -8) << "\"";
                     } else object << (*markedElements).size() << " paths";
                     std::string confirmMsg = "Delete " + object.str() + "?" + "\n";
+                    if(mode == M_DUPES) confirmMsg += "(checked again, every group keeps a copy)\n";
                     if(uiPrompt(gpu::SCREEN_TOP, confirmMsg, true)) {
                         uiDisplayMessage(gpu::SCREEN_TOP, "Deleting files, please wait...");
                         for(std::set<SelectableElement*>::iterator it = (*markedElements).begin(); it != (*markedElements).end(); it++) {
+                            usageRemove((**it).id);
+                            indexTouch((**it).id);
                             if(!fsPathDelete((**it).id)) {
                                 std::set<SelectableElement*>::iterator next = it;
                                 next++;
                                 if (errno == ENOENT) errno = EACCES; // errno fix for write protected files
+                                usageAdd((**it).id);
                                 if (!uiErrorPrompt(gpu::SCREEN_TOP, "Deleting", (**it).name, true, next != (*markedElements).end())) break;
                             } else successCount++;
                         }
@@ -116,7 +305,11 @@ int main(int argc, char **argv) {
                     std::string confirmMsg = "Rename \"" + uiTruncateString(currentFile.name, 24, -8) + "\"?\nEnter new name below:\n";
                     std::string name = uiStringInput(gpu::SCREEN_TOP, currentFile.name, alphabet, confirmMsg, 1, true);
                     if(!name.empty()) {
-                        if(!fsPathRename(currentFile.id, currentDir + "/" + name)) {
+                        usageRemove(currentFile.id);
+                        indexTouch(currentFile.id);
+                        bool renamed = fsPathRename(currentFile.id, currentDir + "/" + name);
+                        usageAdd(renamed ? currentDir + "/" + name : currentFile.id);
+                        if(!renamed) {
                             uiErrorPrompt(gpu::SCREEN_TOP, "Renaming", currentFile.name, true, false);
                         } else {
                             updateList = true;
@@ -136,6 +329,9 @@ int main(int argc, char **argv) {
                     else object << clipboard.size() << " paths";
                     std::string confirmMsg = ((action == A_COPY) ? "Copy " : "Move ") + object.str() + " to this destination?" + "\n";
                     if(uiPrompt(gpu::SCREEN_TOP, confirmMsg, true)) {
+                        FsCopyStats stats = { 0, 0, 0, 0, 0 };
+                        bool verify = (action == A_COPY) &&
+                            uiPrompt(gpu::SCREEN_TOP, "Verify copied data?\nChecksums are read back from the SD card.\n", true);
                         bool overwrite = false;
                         bool overwrite_remember = false;
                         bool overwrite_remember_ask = (clipboard.size() > 1);
@@ -154,9 +350,18 @@ int main(int argc, char **argv) {
                                 }
                                 if(!overwrite) continue;
                             }
+                            // storage analysis: take out what may change, put back what is there afterwards
+                            usageRemove(dest);
+                            indexTouch(dest);
+                            if(action == A_MOVE) {
+                                usageRemove((*it).id);
+                                indexTouch((*it).id);
+                            }
                             fail = (action == A_COPY) ?
-                                !fsPathCopy((*it).id, dest, overwrite, true) :
+                                !fsPathCopy((*it).id, dest, overwrite, true, verify, &stats) :
                                 !fsPathMove((*it).id, dest, overwrite);
+                            usageAdd(dest);
+                            if(action == A_MOVE) usageAdd((*it).id);
                             if(fail) {
                                 std::string operationStr = (action == A_COPY) ? "Copying" : "Moving";
                                 if(!uiErrorPrompt(gpu::SCREEN_TOP, operationStr, (*it).name, true, it + 1 != clipboard.end())) 
@@ -169,6 +374,16 @@ int main(int argc, char **argv) {
                             errorMsg << successCount << " of " << clipboard.size() << " paths!" << "\n";
                             uiPrompt(gpu::SCREEN_TOP, errorMsg.str(), false);
                         }
+                        if(verify && (stats.files > 0)) {
+                            // overhead relative to the plain copy
+                            u64 copyTicks = (stats.copyTicks > 0) ? stats.copyTicks : 1;
+                            std::stringstream statsMsg;
+                            statsMsg << "Verified " << stats.files << " file(s), " << uiFormatBytes(stats.bytes) << "\n" << "\n";
+                            statsMsg << "Copying:   " << (stats.copyTicks / FS_TICKS_PER_MS) << " ms" << "\n";
+                            statsMsg << "Checksums: +" << (stats.hashTicks / FS_TICKS_PER_MS) << " ms (" << ((stats.hashTicks * 100) / copyTicks) << "%)" << "\n";
+                            statsMsg << "Read back: +" << (stats.verifyTicks / FS_TICKS_PER_MS) << " ms (" << ((stats.verifyTicks * 100) / copyTicks) << "%)" << "\n";
+                            uiPrompt(gpu::SCREEN_TOP, statsMsg.str(), false);
+                        }
                         freeSpace = fsGetFreeSpace();
                         if(action == A_MOVE) clipboard.clear();
                         updateList = true;
@@ -184,6 +399,9 @@ int main(int argc, char **argv) {
                 if(!name.empty()) {
                     if(!fsCreateDir(currentDir + "/" + name)) {
                         uiErrorPrompt(gpu::SCREEN_TOP, "Create Folder", name, true, false);
+                    } else {
+                        usageAdd(currentDir + "/" + name);
+                        indexTouch(currentDir + "/" + name);
                     }
                     updateList = true;
                     resetCursor = false;
@@ -203,9 +421,12 @@ int main(int argc, char **argv) {
                         std::string existMsg = "Destination already exists. Overwrite?\n";
                         overwrite = uiPrompt(gpu::SCREEN_TOP, existMsg, true);
                     }
+                    usageRemove(currentDir + "/" + name);
+                    indexTouch(currentDir + "/" + name);
                     if(!fsCreateDummyFile(currentDir + "/" + name, dummySize, dummyContent, overwrite, true)) {
                         uiErrorPrompt(gpu::SCREEN_TOP, "Generating", name, true, false);
-                    } 
+                    }
+                    usageAdd(currentDir + "/" + name);
                     freeSpace = fsGetFreeSpace();
                     updateList = true;
                     resetCursor = false;
@@ -213,77 +434,353 @@ int main(int argc, char **argv) {
                 break;
             }
                 
+            case A_HASH: {
+                if(currentFile.name.compare("..") == 0) break;
+                if(fsIsDirectory(currentFile.id))
+                    uiPrompt(gpu::SCREEN_TOP, "Only files can be hashed.\n", false);
+                else hashData(currentFile.id, 0, fsGetFileSize(currentFile.id), true);
+                break;
+            }
+                
+            case A_VERIFY: {
+                std::vector<ManifestEntry> entries;
+                VerifySummary summary;
+                hashPath = "";
+                if(!verifyManifest(currentFile.id, entries, summary, true)) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Verifying", currentFile.name, true, false);
+                    break;
+                }
+                std::stringstream msg;
+                msg << "Verified \"" << uiTruncateString(currentFile.name, 24, -8) << "\"" << "\n";
+                msg << entries.size() << " file(s), " << summary.cached << " from cache" << "\n" << "\n";
+                msg << "PASS: " << summary.pass << "  FAIL: " << summary.fail << "  MISSING: " << summary.missing;
+                if(summary.error > 0) msg << "  ERROR: " << summary.error;
+                msg << "\n";
+                // the first few problems by name, the full list would not fit
+                u32 problems = entries.size() - summary.pass;
+                u32 listed = 0;
+                if(problems > 0) msg << "\n";
+                for(std::vector<ManifestEntry>::iterator it = entries.begin(); (it != entries.end()) && (listed < 8); it++) {
+                    if((*it).status == V_PASS) continue;
+                    msg << (((*it).status == V_FAIL) ? "FAIL    " : ((*it).status == V_MISSING) ? "MISSING " : "ERROR   ");
+                    msg << uiTruncateString((*it).name, 28, -8) << "\n";
+                    listed++;
+                }
+                if(problems > listed) msg << "(+ " << (problems - listed) << " more)" << "\n";
+                uiPrompt(gpu::SCREEN_TOP, msg.str(), false);
+                
+                std::stringstream result;
+                hashLines.clear();
+                result << "Verified " << entries.size() << " file(s)";
+                hashLines.push_back(result.str());
+                result.str("");
+                result << summary.pass << " pass, " << summary.fail << " fail, " << summary.missing << " missing";
+                hashLines.push_back(result.str());
+                hashPath = currentFile.id;
+                break;
+            }
+                
+            case A_DUPES: {
+                const std::string dir = selectedFolder();
+                std::vector<DupeGroup> groups;
+                if(dir.empty()) break;
+                if(!dupeFind(dir, groups, true)) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Searching", uiTruncateString(dir, 28, -8), true, false);
+                    break;
+                }
+                if(groups.empty()) {
+                    uiPrompt(gpu::SCREEN_TOP, "No duplicate files found.\n", false);
+                    break;
+                }
+                u32 copies = 0;
+                u64 wasted = 0;
+                for(std::vector<DupeGroup>::iterator it = groups.begin(); it != groups.end(); it++) {
+                    copies += (*it).paths.size() - 1;
+                    wasted += (*it).size * ((*it).paths.size() - 1);
+                }
+                std::stringstream msg;
+                msg << "Found " << groups.size() << " group(s) of identical files" << "\n";
+                msg << copies << " duplicate(s), " << uiFormatBytes(wasted) << " reclaimable" << "\n" << "\n";
+                msg << "Mark the copies to delete with L," << "\n" << "then press X." << "\n";
+                uiPrompt(gpu::SCREEN_TOP, msg.str(), false);
+                dupeDir = dir;
+                dupeGroups = groups;
+                mode = M_DUPES;
+                break;
+            }
+                
+            case A_USAGE: {
+                const std::string dir = selectedFolder();
+                if(dir.empty()) break;
+                if(!usageScan(dir, true)) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Analyzing", uiTruncateString(dir, 28, -8), true, false);
+                    break;
+                }
+                usageRoot = dir;
+                usageDir = dir;
+                mode = M_USAGE;
+                break;
+            }
+                
+            case A_SEARCH: {
+                std::string confirmMsg = "Search file names on SD card?\nEnter part of a name or a pattern (* ?):\n";
+                std::string query = uiStringInput(gpu::SCREEN_TOP, searchQuery, alphabet + "*?/", confirmMsg, 1, true);
+                if(query.empty()) break;
+                searchQuery = query;
+                indexStart();
+                if(!indexWait(true) && indexEmpty()) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Indexing", "SD card", true, false);
+                    break;
+                }
+                u64 searchStart = core::time();
+                u32 count = indexSearch(query, searchResults);
+                if(count == 0) {
+                    uiPrompt(gpu::SCREEN_TOP, "No matches for \"" + uiTruncateString(query, 24, -8) + "\".\n", false);
+                    break;
+                }
+                std::stringstream info;
+                info << count << " match(es) in " << (core::time() - searchStart) << " ms";
+                if(count > searchResults.size()) info << ", first " << searchResults.size();
+                searchInfo = info.str();
+                // ".." returns into the current folder, see uiFileBrowser()
+                searchFrom = (currentFile.name.compare("..") == 0) ? SelectableElement{ currentDir + "/", "" } : currentFile;
+                mode = M_SEARCH;
+                break;
+            }
+                
+            case A_GREP: {
+                const std::string dir = selectedFolder();
+                if(dir.empty()) break;
+                // patterns are collected one by one, text and hex can be mixed
+                std::vector<std::vector<u8>> patterns;
+                while(patterns.size() < GREP_MAX_PATTERNS) {
+                    std::stringstream menuMsg;
+                    menuMsg << "Search file contents for " << patterns.size() << " pattern(s):";
+                    std::vector<std::string> options = { "Add text pattern", "Add hex pattern" };
+                    if(!patterns.empty()) options.push_back("Start search");
+                    int choice = uiMenu(menuMsg.str(), options);
+                    if(choice < 0) patterns.clear();
+                    if((choice < 0) || (choice == 2)) break;
+                    if(choice == 0) {
+                        std::string searchStr = uiStringInput(gpu::SCREEN_TOP, hvLastSearchStr, alphabet, "Enter search string below:\n", 1, true);
+                        if(!searchStr.empty()) {
+                            hvLastSearchStr = searchStr;
+                            patterns.push_back(std::vector<u8>(searchStr.begin(), searchStr.end()));
+                        }
+                    } else {
+                        std::vector<u8> searchTerm = uiDataInput(gpu::SCREEN_TOP, hvLastSearchHex, "Enter search value below:\n");
+                        if(!searchTerm.empty()) {
+                            hvLastSearchHex = searchTerm;
+                            patterns.push_back(searchTerm);
+                        }
+                    }
+                }
+                if(patterns.empty()) break;
+                
+                u32 count = 0;
+                if(!grepFind(dir, patterns, grepHits, count, true)) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Searching", uiTruncateString(dir, 28, -8), true, false);
+                    grepHits.clear();
+                    break;
+                }
+                if(count == 0) {
+                    uiPrompt(gpu::SCREEN_TOP, "No matches found.\n", false);
+                    break;
+                }
+                std::stringstream info;
+                info << count << " hit(s)";
+                if(count > grepHits.size()) info << ", first " << grepHits.size();
+                grepInfo = info.str();
+                grepPatterns = patterns;
+                grepDir = dir;
+                grepLastId = "";
+                searchFrom = (currentFile.name.compare("..") == 0) ? SelectableElement{ currentDir + "/", "" } : currentFile;
+                mode = M_GREP;
+                break;
+            }
+                
             default:
                 break;                
         }
     };
     
-    auto instructionBlockBrowser = [&]() {
-        std::stringstream stream;
-        stream << "L - MARK files (use with " << (char) 0x018 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ")" << "\n";
-        if(dummySize == (u32) -1) stream << "R - [t] CREATE folder / [h] file" << "\n";
+    auto instructionBlockBrowser = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - MARK files (use with \x18\x19\x1A\x1B)\n");
+        if(dummySize == (u32) -1) fmtString(buf, "R - [t] CREATE folder / [h] file\n");
         else {
-            stream << "R - [r] GENERATE " << ((dummySize == 0) ? "zero byte" : uiFormatBytes(dummySize)) << " dummy file";
+            fmtString(buf, "R - [r] GENERATE ");
+            if(dummySize == 0) fmtString(buf, "zero byte");
+            else fmtBytes(buf, dummySize);
+            fmtString(buf, " dummy file");
             if(dummySize > 0) {
-                if(dummyContent > 0xFF) stream << " (XX)";
-                else stream << " (" << std::uppercase << std::setfill('0') << std::hex << std::setw(2) << (dummyContent & 0xFF) << std::nouppercase << ")";
+                if(dummyContent > 0xFF) fmtString(buf, " (XX)");
+                else {
+                    fmtString(buf, " (");
+                    fmtHex(buf, dummyContent & 0xFF, 2);
+                    fmtString(buf, ")");
+                }
             }
-            stream << "\n";
+            fmtString(buf, "\n");
         }
-        stream << "X - [t] DELETE / [h] RENAME selected" << "\n";
-        if(clipboard.empty()) stream << "Y - COPY/MOVE selected " <<  (((*markedElements).size() > 1) ? "files" : "file") << "\n";
-        else stream << "Y - [t] COPY / [h] MOVE to this folder" << "\n";
-        stream << "A - VIEW file in [t] hex / [h] text" << "\n";
-        if(clipboard.size()) stream << "SELECT - Clear Clipboard" << "\n";
-        
-        return stream.str();
+        fmtString(buf, "X - [t] DELETE / [h] RENAME selected\n");
+        if(clipboard.empty()) fmtString(buf, ((*markedElements).size() > 1) ? "Y - COPY/MOVE selected files\n" : "Y - COPY/MOVE selected file\n");
+        else fmtString(buf, "Y - [t] COPY / [h] MOVE to this folder\n");
+        if((markedElements != NULL) && ((*markedElements).size() == 2)) {
+            bool hasPatch = false;
+            for(std::set<SelectableElement*>::iterator it = (*markedElements).begin(); it != (*markedElements).end(); it++)
+                if(fsHasExtensions((**it).id, patchExtensions)) hasPatch = true;
+            if(hasPatch) fmtString(buf, "A - APPLY marked patch\n");
+            else fmtString(buf, "A - COMPARE marked files\n");
+        } else fmtString(buf, "A - VIEW file in [t] hex / [h] text\n");
+        if(clipboard.size()) fmtString(buf, "SELECT - Clear Clipboard\n");
+        else if(verifyIsManifest(currentFile.id)) fmtString(buf, "SELECT - VERIFY files in manifest\n");
+        else if(!selectedFolder().empty()) fmtString(buf, "SELECT - FOLDER tools / SEARCH SD card\n");
+        else fmtString(buf, "SELECT - HASH selected file\n");
     };
     
-    auto instructionBlockHexViewer = [&]() {
-        std::stringstream stream;
-        stream << std::setfill('0');
-        stream << "L - [h] (" << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") fast scroll" << "\n";
+    auto instructionBlockHexViewer = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - [h] (\x18\x19\x1A\x1B) fast scroll\n");
         if(hvStoredOffset != (u32) -1) {
-            stream << "R - GO TO begin / " << std::hex << std::uppercase << std::setw(8) << hvStoredOffset <<
-             std::nouppercase << " / end" << "\n";
-        } else stream << "R - GO TO begin / end" << "\n";
-        stream << "X - GO TO ... ([t] hex / [h] dec)" << "\n";
-        if (hvLastFoundOffset == (u32) -1) stream << "Y - SEARCH ... ([t] hex / [h] string)" << "\n";
-        else stream << "Y - SEARCH [t] next / [h] new" << "\n";
-        stream << "A - Enter EDIT mode" << "\n";
-        
-        return stream.str();
+            fmtString(buf, "R - GO TO begin / ");
+            fmtHex(buf, hvStoredOffset, 8);
+            fmtString(buf, " / end\n");
+        } else fmtString(buf, "R - GO TO begin / end\n");
+        fmtString(buf, "X - GO TO ... ([t] hex / [h] dec)\n");
+        if (hvLastFoundOffset == (u32) -1) fmtString(buf, "Y - SEARCH ... ([t] hex / [h] string)\n");
+        else fmtString(buf, "Y - SEARCH [t] next / [h] new\n");
+        fmtString(buf, "A - Enter EDIT mode\n");
+        fmtString(buf, "SELECT - REPLACE all ...\n");
     };
     
-    auto instructionBlockHexEditor = [&]() {
-        std::stringstream stream;
-        stream << "A - [h] ("  << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") / [t] EDIT data" << "\n";
-        stream << "X - [h] ("  << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") / [t] DELETE data" << "\n";
+    auto instructionBlockHexEditor = [&](FmtBuffer &buf) {
+        fmtString(buf, "A - [h] (\x18\x19\x1A\x1B) / [t] EDIT data\n");
+        fmtString(buf, "X - [h] (\x18\x19\x1A\x1B) / [t] DELETE data\n");
         if(hvClipboard.empty()) {
-            stream << "Y - [h] ("  << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") / [t] COPY data" << "\n";
+            fmtString(buf, "Y - [h] (\x18\x19\x1A\x1B) / [t] COPY data\n");
         } else {
-            stream << "Y - [h] ("  << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") / [t] PASTE data" << "\n";
+            fmtString(buf, "Y - [h] (\x18\x19\x1A\x1B) / [t] PASTE data\n");
         }
-        stream << "R - [h] ("  << (char) 0x18 << (char) 0x19 << (char) 0x1A << (char) 0x1B << ") / [t] EDIT string" << "\n";
-        if(hvClipboard.size()) stream << "SELECT - Clear paste data" << "\n";
-        
-        return stream.str();
+        fmtString(buf, "R - [h] (\x18\x19\x1A\x1B) / [t] EDIT string\n");
+        fmtString(buf, "L - [h] (\x18\x19\x1A\x1B) / [t] TRANSFORM / ANALYZE data\n");
+        if(hvClipboard.size()) fmtString(buf, "SELECT - Clear paste data\n");
     };
     
-    auto instructionBlockTextViewer = [&]() {
-        std::stringstream stream;
-        stream << "L/R - PAGE up / PAGE down" << "\n";
-        stream << "X - Enable / disable wordwrap" << "\n";
-        
-        return stream.str();
+    auto instructionBlockTextViewer = [&](FmtBuffer &buf) {
+        fmtString(buf, "L/R - PAGE up / PAGE down\n");
+        fmtString(buf, "L + \x1B\x1A - PAGE left / PAGE right\n");
+        fmtString(buf, "R + \x1B\x1A - GO TO line begin / end\n");
+        fmtString(buf, "X - [t] wordwrap / [h] follow mode on / off\n");
+        fmtString(buf, "Y - GO TO [t] line / [h] percent\n");
+        fmtString(buf, "A - SEARCH [t] next / [h] previous\n");
+        fmtString(buf, "SELECT - SEARCH new ...\n");
+    };
+    
+    auto instructionBlockCompare = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - [h] (\x18\x19\x1A\x1B) fast scroll\n");
+        fmtString(buf, "R - GO TO [t] next / [h] previous difference\n");
+        fmtString(buf, "Y - CREATE patch [t] IPS / [h] BPS\n");
+    };
+    
+    auto instructionBlockEntropy = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - [h] (\x18\x19\x1A\x1B) fast scroll\n");
+        fmtString(buf, "X - GO TO offset ...\n");
+        fmtString(buf, "A - VIEW block in hex viewer\n");
+        fmtString(buf, "TOUCH - SELECT block in map\n");
+        fmtString(buf, "B - BACK to hex viewer\n");
+    };
+    
+    auto instructionBlockStrings = [&](FmtBuffer &buf) {
+        if((stringsPage + 1) * STRINGS_PAGE < stringsResult.count) fmtString(buf, "X - NEXT page\n");
+        if(stringsPage > 0) fmtString(buf, "Y - PREVIOUS page\n");
+        fmtString(buf, "A - VIEW string in hex viewer\n");
+        fmtString(buf, "B - BACK to hex viewer\n");
+    };
+    
+    auto instructionBlockDupes = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - MARK files (use with \x18\x19\x1A\x1B)\n");
+        if((markedElements != NULL) && !(*markedElements).empty()) fmtString(buf, "X - DELETE marked files\n");
+        else fmtString(buf, "X - DELETE selected file\n");
+        fmtString(buf, "B - BACK to browser\n");
+    };
+    
+    auto instructionBlockUsage = [&](FmtBuffer &buf) {
+        fmtString(buf, "L - MARK files (use with \x18\x19\x1A\x1B)\n");
+        if((markedElements != NULL) && !(*markedElements).empty()) fmtString(buf, "X - DELETE marked paths\n");
+        else fmtString(buf, "X - DELETE selected path\n");
+        fmtString(buf, "Y - RESCAN folder\n");
+        fmtString(buf, "A - OPEN folder / SHOW file in browser\n");
+        fmtString(buf, (usageDir != usageRoot) ? "B - BACK to parent folder\n" : "B - BACK to browser\n");
+    };
+    
+    auto instructionBlockGrep = [&](FmtBuffer &buf) {
+        fmtString(buf, "A - VIEW hit in hex viewer\n");
+        fmtString(buf, "B - BACK to browser\n");
+    };
+    
+    auto instructionBlockSearch = [&](FmtBuffer &buf) {
+        fmtString(buf, "A - GO TO selected path\n");
+        fmtString(buf, "B - BACK to browser\n");
+    };
+    
+    // everything the top screen is drawn from, it is only built again when this changes
+    auto topScreenState = [&]() {
+        u64 state = UI_STATE_INIT;
+        state = uiHashState(state, mode);
+        state = uiHashState(state, hvSelectMode);
+        state = uiHashState(state, currentDir);
+        state = uiHashState(state, freeSpace);
+        state = uiHashState(state, currentFile.id);
+        state = uiHashState(state, currentFile.name);
+        for(std::vector<std::string>::iterator it = currentFile.details.begin(); it != currentFile.details.end(); it++)
+            state = uiHashState(state, *it);
+        state = uiHashState(state, hashPath);
+        if(currentFile.id == hashPath) {
+            for(std::vector<std::string>::iterator it = hashLines.begin(); it != hashLines.end(); it++)
+                state = uiHashState(state, *it);
+        }
+        state = uiHashState(state, clipboard.size());
+        for(u32 i = 0; (i < clipboard.size()) && (i < 10); i++)
+            state = uiHashState(state, clipboard.at(i).name);
+        if(clipboard.size() == 1) {
+            for(std::vector<std::string>::iterator it = clipboard.at(0).details.begin(); it != clipboard.at(0).details.end(); it++)
+                state = uiHashState(state, *it);
+        }
+        // instruction blocks
+        state = uiHashState(state, dummySize);
+        state = uiHashState(state, dummyContent);
+        state = uiHashState(state, (markedElements != NULL) ? (*markedElements).size() : (u32) -1);
+        if((markedElements != NULL) && ((*markedElements).size() == 2)) {
+            for(std::set<SelectableElement*>::iterator it = (*markedElements).begin(); it != (*markedElements).end(); it++)
+                state = uiHashState(state, (**it).id);
+        }
+        state = uiHashState(state, hvStoredOffset);
+        state = uiHashState(state, hvLastFoundOffset);
+        state = uiHashState(state, hvClipboard.size());
+        state = uiHashState(state, stringsPage);
+        state = uiHashState(state, stringsResult.count);
+        state = uiHashState(state, usageDir);
+        state = uiHashState(state, usageRoot);
+        if(mode == M_ENTROPY) {
+            state = uiHashState(state, entropyBlock);
+            state = uiHashState(state, entropyMap.offset);
+            state = uiHashState(state, entropyMap.size);
+            state = uiHashState(state, entropyMap.blockSize);
+        }
+        return state;
     };
     
     auto onLoopDisplay = [&]() {
-        gpu::setViewport(gpu::SCREEN_TOP, 0, 0, gpu::TOP_WIDTH, gpu::TOP_HEIGHT);
-        gput::setOrtho(0, gpu::TOP_WIDTH, 0, gpu::TOP_HEIGHT, -1, 1);        
-        gpu::clear();
+        #if defined CTRX_PROFILE
+        if(hid::pressed(hid::BUTTON_TOUCH) && (mode != M_ENTROPY)) profShow = !profShow; // taps select blocks there
+        if(!profShow && uiScreenCurrent(gpu::SCREEN_TOP, topScreenState())) return; // the profiler changes every frame
+        #else
+        if(uiScreenCurrent(gpu::SCREEN_TOP, topScreenState())) return;
+        #endif
         
-        std::string str;
+        uiStartScreen(gpu::SCREEN_TOP);
+        
+        char str[1024];
+        FmtBuffer buf;
         
         u32 screenWidth;
         u32 screenHeight;
@@ -297,56 +794,96 @@ int main(int argc, char **argv) {
         
         // TOP BAR -> CURRENT DIRECTORY & FREE SPACE
         uiDrawRectangle(0, (screenHeight - 1) - 12, screenWidth, 12);
-        str = uiTruncateString(currentDir, 36, 0); // current directory
-        gput::drawString(str, 0, (screenHeight - 1) - 10, 8, 8, 0x00, 0x00, 0x00);
-        str = uiFormatBytes(freeSpace) + " free"; // free space
-        gput::drawString(str, (screenWidth - 1) - gput::getStringWidth(str, 8), (screenHeight - 1) - 10, 8, 8, 0x00, 0x00, 0x00);
+        fmtStart(buf, str, sizeof(str));
+        fmtTruncate(buf, currentDir, 36, 0); // current directory
+        uiDrawString(str, 0, (screenHeight - 1) - 10, 8, 8, 0x00, 0x00, 0x00);
+        fmtStart(buf, str, sizeof(str));
+        fmtBytes(buf, freeSpace); // free space
+        fmtString(buf, " free");
+        uiDrawString(str, (screenWidth - 1) - (float) (buf.size * 8), (screenHeight - 1) - 10, 8, 8, 0x00, 0x00, 0x00);
         
         // CURRENT FILE DETAILS
         if(currentFile.name.compare("..") != 0) {
-            str = "[SELECTED]";
-            gput::drawString(str, 0, vpos0 - 8, 8, 8);
-            str = uiTruncateString(currentFile.name, 22, -8);
-            gput::drawString(str, 0, vpos1 - 8, 8, 8);
+            uiDrawString("[SELECTED]", 0, vpos0 - 8, 8, 8);
+            fmtStart(buf, str, sizeof(str));
+            fmtTruncate(buf, currentFile.name, 22, -8);
+            uiDrawString(str, 0, vpos1 - 8, 8, 8);
             u32 vpos = vpos1 - 9;
             for(std::vector<std::string>::iterator it = currentFile.details.begin(); it != currentFile.details.end(); it++, vpos -= 9) {
-                gput::drawString(*it, 0, vpos - 8, 8, 8, gr, gr, gr);
+                uiDrawString(*it, 0, vpos - 8, 8, 8, gr, gr, gr);
+            }
+            // hashes are wider than the details, the clipboard would overlap them
+            if((currentFile.id == hashPath) && clipboard.empty()) {
+                for(std::vector<std::string>::iterator it = hashLines.begin(); it != hashLines.end(); it++, vpos -= 9) {
+                    uiDrawString(*it, 0, vpos - 8, 8, 8, gr, gr, gr);
+                }
             }
         }
         
         // CLIPBOARD DETAILS
         if(clipboard.size() > 0) {
-            std::stringstream stream;
-            stream << "[CLIPBOARD(" << clipboard.size() << ")]";
-            str = stream.str();
-            gput::drawString(str, (screenWidth - 1) - gput::getStringWidth(str, 8), vpos0 - 8, 8, 8);
+            fmtStart(buf, str, sizeof(str));
+            fmtString(buf, "[CLIPBOARD(");
+            fmtDec(buf, clipboard.size());
+            fmtString(buf, ")]");
+            uiDrawString(str, (screenWidth - 1) - (float) (buf.size * 8), vpos0 - 8, 8, 8);
             u32 vpos = vpos1;
             for(u32 i = 0; (i < clipboard.size()) && (i < cbDisplay); i++, vpos -= 9) {
-                str = uiTruncateString(clipboard.at(i).name, 22, -8);
-                gput::drawString(str, (screenWidth - 1) - gput::getStringWidth(str, 8), vpos - 8, 8, 8);
+                fmtStart(buf, str, sizeof(str));
+                fmtTruncate(buf, clipboard.at(i).name, 22, -8);
+                uiDrawString(str, (screenWidth - 1) - (float) (buf.size * 8), vpos - 8, 8, 8);
             }
             if(clipboard.size() > cbDisplay) {
-                stream.str("");
-                stream << "(+ " << clipboard.size() - cbDisplay << " more files)";
-                str = stream.str();
-                gput::drawString(str, (screenWidth - 1) - gput::getStringWidth(str, 8), vpos - 8, 8, 8, gr, gr, gr);
+                fmtStart(buf, str, sizeof(str));
+                fmtString(buf, "(+ ");
+                fmtDec(buf, clipboard.size() - cbDisplay);
+                fmtString(buf, " more files)");
+                uiDrawString(str, (screenWidth - 1) - (float) (buf.size * 8), vpos - 8, 8, 8, gr, gr, gr);
             } else if(clipboard.size() == 1) {
                 for(std::vector<std::string>::iterator it = clipboard.at(0).details.begin(); it != clipboard.at(0).details.end(); it++, vpos -= 9) {
-                    gput::drawString(*it, (screenWidth - 1) - gput::getStringWidth(*it, 8), vpos - 8, 8, 8, gr, gr, gr);
+                    uiDrawString(*it, (screenWidth - 1) - (float) ((*it).size() * 8), vpos - 8, 8, 8, gr, gr, gr);
                 }
             }
         }
         
+        // ENTROPY STRIP -> WHOLE MAPPED REGION, MARKER AT THE SELECTED BLOCK
+        if(mode == M_ENTROPY) {
+            uiDrawEntropyStrip(entropyMap, entropyBlock, 8, 104, screenWidth - 16, 16);
+            fmtStart(buf, str, sizeof(str));
+            fmtString(buf, "block size ");
+            fmtBytes(buf, entropyMap.blockSize);
+            uiDrawString(str, 8, 104 + 16 + 4, 8, 8, gr, gr, gr);
+        }
+        
         // INSTRUCTIONS BLOCK
-        str = title + "\n";
-        if(mode == M_BROWSER) str += instructionBlockBrowser();
-        else if(mode == M_HEXVIEWER) str += (hvSelectMode) ? instructionBlockHexEditor() : instructionBlockHexViewer();
-        else if(mode == M_TEXTVIEWER) str += instructionBlockTextViewer();
-        if(launcher) str += "START - Exit to launcher\n";
-        gput::drawString(str, (screenWidth - 320) / 2, 4, 8, 8);
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, title);
+        fmtString(buf, "\n");
+        if(mode == M_BROWSER) instructionBlockBrowser(buf);
+        else if(mode == M_HEXVIEWER && hvSelectMode) instructionBlockHexEditor(buf);
+        else if(mode == M_HEXVIEWER) instructionBlockHexViewer(buf);
+        else if(mode == M_TEXTVIEWER) instructionBlockTextViewer(buf);
+        else if(mode == M_COMPARE) instructionBlockCompare(buf);
+        else if(mode == M_DUPES) instructionBlockDupes(buf);
+        else if(mode == M_USAGE) instructionBlockUsage(buf);
+        else if(mode == M_SEARCH) instructionBlockSearch(buf);
+        else if(mode == M_GREP) instructionBlockGrep(buf);
+        else if(mode == M_ENTROPY) instructionBlockEntropy(buf);
+        else if(mode == M_STRINGS) instructionBlockStrings(buf);
+        if(launcher) fmtString(buf, "START - Exit to launcher\n");
+        uiDrawString(str, (screenWidth - 320) / 2, 4, 8, 8);
+        
+        #if defined CTRX_PROFILE
+        // PROFILER -> ABOVE INSTRUCTIONS, TAP THE TOUCH SCREEN TO SHOW / HIDE
+        u32 hpos = 4 + (std::count(str, str + buf.size, '\n') * 8) + 4;
+        if(profShow) {
+            fmtStart(buf, str, sizeof(str));
+            profFormat(buf);
+            uiDrawString(str, (screenWidth - 320) / 2, hpos, 8, 8, gr, gr, gr);
+        }
+        #endif
         
-        gpu::flushCommands();
-        gpu::flushBuffer();
+        uiFlushBuffer();
         
         return;
     };
@@ -362,9 +899,18 @@ int main(int argc, char **argv) {
             return true;
         }
         
-        // SELECT - CLEAR CLIPBOARD
+        // SELECT - CLEAR CLIPBOARD / VERIFY MANIFEST / HASH SELECTED FILE / FOLDER TOOLS
         if(hid::pressed(hid::BUTTON_SELECT)) {
-            clipboard.clear();
+            if(clipboard.size()) clipboard.clear();
+            else if(verifyIsManifest(currentFile.id)) processAction(A_VERIFY, updateList, resetCursor);
+            else if(!selectedFolder().empty()) {
+                const std::vector<std::string> tools = { "Find duplicate files", "Analyze storage use", "Search file names on SD card",
+                    "Search file contents" };
+                const Action actions[] = { A_DUPES, A_USAGE, A_SEARCH, A_GREP };
+                int tool = uiMenu("Select tool for \"" + uiTruncateString(fsGetFileName(selectedFolder()), 24, -8) + "\":", tools);
+                if(tool >= 0) processAction(actions[tool], updateList, resetCursor);
+            } else processAction(A_HASH, updateList, resetCursor);
+            if((mode == M_DUPES) || (mode == M_USAGE) || (mode == M_SEARCH) || (mode == M_GREP)) return true;
         }
         
         // R - (TAP) CREATE DIRECTORY / (HOLD) GENERATE DUMMY FILE
@@ -396,7 +942,7 @@ int main(int argc, char **argv) {
                         }
                     } else if (lastChangeTime != 0) lastChangeTime = 0;                    
                     onLoopDisplay();
-                    gpu::swapBuffers(true);
+                    uiSwapBuffers(true);
                     hid::poll();
                 }
                 processAction(A_CREATE_DUMMY, updateList, resetCursor);
@@ -459,7 +1005,254 @@ int main(int argc, char **argv) {
         return breakLoop;
     };
     
-    auto onLoopHexViewer = [&](u32 &offset, u32 &markedOffset, u32 &markedLength) {
+    auto onLoopDupes = [&](std::vector<SelectableElement> &elements, bool &elementsDirty, bool &resetCursor) {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // B - BACK TO BROWSER (AT SELECTED FILE)
+        if(hid::pressed(hid::BUTTON_B)) return true;
+        
+        // X - DELETE MARKED / SELECTED FILES
+        if(hid::pressed(hid::BUTTON_X)) {
+            std::set<std::string> targets;
+            if((*markedElements).empty()) targets.insert(currentFile.id);
+            for(std::set<SelectableElement*>::iterator it = (*markedElements).begin(); it != (*markedElements).end(); it++)
+                targets.insert((**it).id);
+            // every group keeps a copy, and the hashes from the search (maybe cached) are checked again first
+            for(u32 i = 0; i < dupeGroups.size(); i++) {
+                const std::vector<std::string> &paths = dupeGroups.at(i).paths;
+                std::vector<std::string> recheck;
+                std::string keep = "";
+                for(std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); it++) {
+                    if(targets.find(*it) != targets.end()) recheck.push_back(*it);
+                    else if(keep.empty()) keep = *it;
+                }
+                if(recheck.empty()) continue;
+                std::stringstream group;
+                group << "group " << (i + 1);
+                if(keep.empty()) {
+                    uiPrompt(gpu::SCREEN_TOP, "This would delete every copy\nin " + group.str() + ".\n\nUnmark at least one file\nof each group to keep it.\n", false);
+                    return false;
+                }
+                recheck.insert(recheck.begin(), keep);
+                bool identical = true;
+                if(!dupeRecheck(recheck, identical, true)) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Hashing", group.str(), true, false);
+                    return false;
+                }
+                if(!identical) {
+                    uiPrompt(gpu::SCREEN_TOP, "Files in " + group.str() + " are no longer\nidentical, nothing was deleted.\n\nSearch again to update the list.\n", false);
+                    return false;
+                }
+            }
+            bool updateList = false;
+            processAction(A_DELETE, updateList, resetCursor);
+            if(updateList) {
+                // deleted files leave their group, a group is done once a single file is left
+                for(std::set<std::string>::iterator it = targets.begin(); it != targets.end();) {
+                    if(fsExists(*it)) targets.erase(it++);
+                    else it++;
+                }
+                for(std::vector<DupeGroup>::iterator it = dupeGroups.begin(); it != dupeGroups.end();) {
+                    std::vector<std::string> &paths = (*it).paths;
+                    paths.erase(std::remove_if(paths.begin(), paths.end(), [&](const std::string &path) {
+                        return targets.find(path) != targets.end();
+                    }), paths.end());
+                    if(paths.size() < 2) it = dupeGroups.erase(it);
+                    else it++;
+                }
+                if(dupeGroups.empty()) {
+                    uiPrompt(gpu::SCREEN_TOP, "No duplicate files left.\n", false);
+                    return true;
+                }
+                dupeElements(elements);
+                elementsDirty = true;
+            }
+        }
+        
+        return false;
+    };
+    
+    auto onLoopUsage = [&](std::vector<SelectableElement> &elements, bool &elementsDirty, bool &resetCursor) {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // B - BACK TO PARENT FOLDER / BROWSER
+        if(hid::pressed(hid::BUTTON_B)) {
+            if(usageDir == usageRoot) {
+                currentFile = { usageRoot, fsGetFileName(usageRoot) };
+                return true;
+            }
+            usageDir = usageDir.substr(0, usageDir.rfind('/'));
+            if(usageDir[usageDir.size() - 1] == ':') usageDir += "/";
+            usageRefresh = true;
+        }
+        
+        // Y - RESCAN FOLDER
+        if(hid::pressed(hid::BUTTON_Y)) {
+            usageClear();
+            if(!usageScan(usageRoot, true)) {
+                uiErrorPrompt(gpu::SCREEN_TOP, "Analyzing", uiTruncateString(usageRoot, 28, -8), true, false);
+                currentFile = { usageRoot, fsGetFileName(usageRoot) };
+                return true;
+            }
+            usageDir = usageRoot;
+            usageRefresh = true;
+        }
+        
+        // X - DELETE MARKED / SELECTED PATHS
+        if(hid::pressed(hid::BUTTON_X)) {
+            // summary lines are not paths
+            for(std::set<SelectableElement*>::iterator it = (*markedElements).begin(); it != (*markedElements).end();) {
+                if((**it).id.empty()) (*markedElements).erase(it++);
+                else it++;
+            }
+            if(!currentFile.id.empty() || !(*markedElements).empty()) {
+                bool updateList = false;
+                processAction(A_DELETE, updateList, resetCursor);
+                if(updateList) usageRefresh = true;
+            }
+        }
+        
+        if(usageRefresh) {
+            usageElements(elements);
+            currentDir = usageDir;
+            elementsDirty = true;
+            usageRefresh = false;
+        }
+        
+        return false;
+    };
+    
+    auto onLoopGrep = [&]() {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // B - BACK TO BROWSER
+        if(hid::pressed(hid::BUTTON_B)) {
+            currentFile = searchFrom;
+            return true;
+        }
+        
+        return false;
+    };
+    
+    auto onLoopSearch = [&]() {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // B - BACK TO BROWSER
+        if(hid::pressed(hid::BUTTON_B)) {
+            currentFile = searchFrom;
+            return true;
+        }
+        
+        return false;
+    };
+    
+    auto stringsElements = [&](std::vector<SelectableElement> &elements) {
+        elements.clear();
+        if(!stringsGet(stringsResult, stringsPage * STRINGS_PAGE, STRINGS_PAGE, stringsHits)) {
+            uiErrorPrompt(gpu::SCREEN_TOP, "Reading", STRINGS_TEMP_PATH, true, false);
+            return;
+        }
+        u32 nPages = (stringsResult.count + STRINGS_PAGE - 1) / STRINGS_PAGE;
+        std::stringstream ssPage;
+        ssPage << "page " << (stringsPage + 1) << " of " << nPages << " (" << stringsResult.count << " strings)";
+        for(std::vector<StringHit>::iterator it = stringsHits.begin(); it != stringsHits.end(); it++) {
+            std::stringstream id;
+            std::stringstream name;
+            std::stringstream info;
+            id << std::setfill('0') << std::uppercase << std::hex << std::setw(8) << (*it).offset;
+            std::string text = (*it).text;
+            std::replace(text.begin(), text.end(), '\t', ' ');
+            name << "[" << id.str() << "] " << text;
+            info << (((*it).wide) ? "UTF-16LE, " : "ASCII, ") << (*it).length << " chars";
+            elements.push_back({id.str(), name.str(), { info.str(), ssPage.str() }});
+        }
+    };
+    
+    auto onLoopStrings = [&](std::vector<SelectableElement> &elements, bool &elementsDirty, bool &resetCursor) {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // B - BACK TO HEX VIEWER
+        if(hid::pressed(hid::BUTTON_B)) return true;
+        
+        // X - NEXT PAGE / Y - PREVIOUS PAGE
+        if(hid::pressed(hid::BUTTON_X) && ((stringsPage + 1) * STRINGS_PAGE < stringsResult.count)) {
+            stringsPage++;
+            stringsRefresh = true;
+        } else if(hid::pressed(hid::BUTTON_Y) && (stringsPage > 0)) {
+            stringsPage--;
+            stringsRefresh = true;
+        }
+        
+        if(stringsRefresh) {
+            stringsElements(elements);
+            elementsDirty = true;
+            resetCursor = true;
+            stringsRefresh = false;
+        }
+        
+        return elements.empty();
+    };
+    
+    auto onLoopEntropy = [&](u32 &block, bool &forceRefresh) {
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // X - GO TO OFFSET
+        if(hid::pressed(hid::BUTTON_X)) {
+            std::string confirmMsg = "Enter new hexadecimal offset below:\n";
+            u32 offsetNew = uiNumberInput(gpu::SCREEN_TOP, entropyMap.offset + (block * entropyMap.blockSize), confirmMsg, true);
+            if((offsetNew != (u32) -1) && (offsetNew >= entropyMap.offset) && (offsetNew - entropyMap.offset < entropyMap.size))
+                block = (offsetNew - entropyMap.offset) / entropyMap.blockSize;
+            forceRefresh = true;
+        }
+        
+        // A - VIEW BLOCK IN HEX VIEWER
+        if(hid::pressed(hid::BUTTON_A)) {
+            u32 blockOffset = block * entropyMap.blockSize;
+            hvStartOffset = entropyMap.offset + blockOffset;
+            hvStartLength = (entropyMap.size - blockOffset < entropyMap.blockSize) ? entropyMap.size - blockOffset : entropyMap.blockSize;
+            return true;
+        }
+        
+        return false;
+    };
+    
+    auto onLoopHexViewer = [&](u32 &offset, u32 &markedOffset, u32 &markedLength, bool &forceRefresh) {
         bool breakLoop = false;
         
         onLoopDisplay();
@@ -546,6 +1339,39 @@ int main(int argc, char **argv) {
                 }
                 inputYHoldTime = 0;
             }
+            
+            // SELECT - REPLACE ALL
+            if(hid::pressed(hid::BUTTON_SELECT)) {
+                std::vector<u8> searchTerm = uiDataInput(gpu::SCREEN_TOP, hvLastSearchHex, "Enter value to replace below:\n");
+                std::vector<u8> replaceTerm;
+                if(!searchTerm.empty()) {
+                    hvLastSearchHex = searchTerm;
+                    replaceTerm = uiDataInput(gpu::SCREEN_TOP, hvLastReplaceHex, "Enter replacement value below:\n");
+                }
+                if(!replaceTerm.empty()) {
+                    hvLastReplaceHex = replaceTerm;
+                    u32 count = fsDataReplaceAll(currentFile.id, searchTerm, replaceTerm, true, true);
+                    if(count == (u32) -1) {
+                        uiErrorPrompt(gpu::SCREEN_TOP, "Searching", currentFile.id, true, false);
+                    } else if(count == 0) {
+                        std::stringstream searchText;
+                        for(std::vector<u8>::iterator it = searchTerm.begin(); it != searchTerm.end(); it++)
+                            searchText << std::setfill('0') << std::uppercase << std::hex << std::setw(2) << (u32) (*it);
+                        uiErrorPrompt(gpu::SCREEN_TOP, "Searching", "Not found: " + searchText.str(), false, false);
+                    } else {
+                        std::stringstream confirmMsg;
+                        confirmMsg << "Replace " << count << " occurrence(s)?" << "\n";
+                        if(searchTerm.size() != replaceTerm.size()) confirmMsg << "Warning: This will change file size." << "\n";
+                        if(uiPrompt(gpu::SCREEN_TOP, confirmMsg.str(), true)) {
+                            // the file gets swapped for the result, the viewer is left (closing it) and reopened here
+                            hvReplacePending = true;
+                            hvStartOffset = offset;
+                            hvStartLength = 0;
+                            breakLoop = true;
+                        }
+                    }
+                }
+            }
         } else {
             // SELECT - CLEAR PASTE DATA
             if(hid::pressed(hid::BUTTON_SELECT)) {
@@ -570,8 +1396,82 @@ int main(int argc, char **argv) {
         return breakLoop;
     };
     
+    auto onLoopCompare = [&](u32 &offset, bool &forceRefresh) {
+        const std::string alphabet = " ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz(){}[]'`^,~!@#$%&0123456789=+-_.";
+        bool breakLoop = false;
+        
+        auto createPatch = [&](PatchType type) {
+            std::string typeStr = (type == P_IPS) ? "IPS" : "BPS";
+            // the two files come in listing order, so the direction is asked for
+            const std::string name0 = uiTruncateString(currentFile.name, 14, -6);
+            const std::string name1 = uiTruncateString(fsGetFileName(cmpPath), 14, -6);
+            const std::vector<std::string> directions = { name0 + " -> " + name1, name1 + " -> " + name0 };
+            int direction = uiMenu("Create " + typeStr + " patch (original -> modified):", directions);
+            forceRefresh = true; // bottom screen was used by the menu
+            if(direction < 0) return;
+            const std::string source = (direction == 0) ? currentFile.id : cmpPath;
+            const std::string target = (direction == 0) ? cmpPath : currentFile.id;
+            std::string name = fsGetFileName(target);
+            std::string::size_type dotPos = name.rfind('.');
+            if(dotPos != std::string::npos) name = name.substr(0, dotPos);
+            std::string confirmMsg = "Create " + typeStr + " patch from\n\"" + uiTruncateString(fsGetFileName(source), 24, -8) + "\"\nto \"" +
+                uiTruncateString(fsGetFileName(target), 24, -8) + "\"?\nEnter patch name below:\n";
+            name = uiStringInput(gpu::SCREEN_TOP, name + "." + ((type == P_IPS) ? "ips" : "bps"), alphabet, confirmMsg, 1, true);
+            if(!name.empty()) {
+                if(!patchCreate(source, target, currentDir + "/" + name, type, true))
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Creating patch", name, true, false);
+                freeSpace = fsGetFreeSpace();
+            }
+            forceRefresh = true;
+        };
+        
+        onLoopDisplay();
+        
+        // START - EXIT TO HB LAUNCHER
+        if(hid::pressed(hid::BUTTON_START) && launcher) {
+            exit = true;
+            return true;
+        }
+        
+        // R - (TAP) NEXT / (HOLD) PREVIOUS DIFFERENCE
+        if(hid::held(hid::BUTTON_R) && (inputRHoldTime != (u64) -1)) {
+            if(inputRHoldTime == 0) inputRHoldTime = core::time();
+            else if(core::time() - inputRHoldTime >= tapDelay) {
+                std::vector<DataRange>::iterator it = std::lower_bound(cmpDiffs.begin(), cmpDiffs.end(), offset,
+                    [](const DataRange &range, u32 offset) { return range.offset < offset; });
+                if(it != cmpDiffs.begin()) offset = (*(it - 1)).offset;
+                inputRHoldTime = (u64) -1;
+            }
+        }
+        if(hid::released(hid::BUTTON_R) && (inputRHoldTime != 0)) {
+            if(inputRHoldTime != (u64) -1) {
+                // differences in the first row are already shown, the compare view shows 4 byte per row
+                std::vector<DataRange>::iterator it = std::lower_bound(cmpDiffs.begin(), cmpDiffs.end(), offset + 4,
+                    [](const DataRange &range, u32 offset) { return range.offset < offset; });
+                if(it != cmpDiffs.end()) offset = (*it).offset;
+            }
+            inputRHoldTime = 0;
+        }
+        
+        // Y - CREATE (TAP) IPS / (HOLD) BPS PATCH
+        if(hid::held(hid::BUTTON_Y) && (inputYHoldTime != (u64) -1)) {
+            if(inputYHoldTime == 0) inputYHoldTime = core::time();
+            else if(core::time() - inputYHoldTime >= tapDelay) {
+                createPatch(P_BPS);
+                inputYHoldTime = (u64) -1;
+            }
+        }
+        if(hid::released(hid::BUTTON_Y) && (inputYHoldTime != 0)) {
+            if(inputYHoldTime != (u64) -1) createPatch(P_IPS);
+            inputYHoldTime = 0;
+        }
+        
+        return breakLoop;
+    };
+    
     auto onSelectHexViewer = [&](u32 selectedOffset, u32 selectedLength, hid::Button selectButton, bool &forceRefresh) {
         bool breakLoop = false;
+        bool hashSelected = false;
         
         if(selectButton == hid::BUTTON_R) { // R - EDIT STRING
             const std::string alphabet = " ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz(){}[]<>/\\|*:=+-_.'\"`^,~!@#$%&?0123456789";
@@ -610,6 +1510,68 @@ int main(int argc, char **argv) {
                     uiErrorPrompt(gpu::SCREEN_TOP, "Resizing", currentFile.id, true, false);
                 else forceRefresh = true;
             }
+        } else if(selectButton == hid::BUTTON_L) { // L - TRANSFORM / HASH DATA
+            const std::vector<std::string> transforms = { "Fill with pattern", "XOR with key", "Add constant",
+                "Swap 16 bit endianness", "Swap 32 bit endianness", "Swap 64 bit endianness", "Invert bits",
+                "Hash (CRC32, MD5, SHA-1, SHA-256)", "Entropy / byte histogram map", "Extract strings (ASCII, UTF-16LE)" };
+            const int hashEntry = T_INVERT + 1;
+            const int entropyEntry = hashEntry + 1;
+            const int stringsEntry = entropyEntry + 1;
+            int transform = uiMenu("Select transform for marked data:", transforms);
+            int scope = -1;
+            if(transform >= 0) {
+                u32 fileSize = fsGetFileSize(currentFile.id);
+                const std::vector<std::string> scopes = { "Marked data (" + uiFormatBytes(selectedLength) + ")",
+                    "Whole file (" + uiFormatBytes(fileSize) + ")" };
+                scope = uiMenu("Apply \"" + transforms.at(transform) + "\" to:", scopes);
+                if(scope == 1) {
+                    selectedOffset = 0;
+                    selectedLength = fileSize;
+                }
+            }
+            if((scope >= 0) && (transform == hashEntry)) {
+                hashSelected = true;
+            } else if((scope >= 0) && (transform == entropyEntry)) {
+                const std::vector<std::string> blockSizes = { "Automatic", "256 byte", "4 KB", "64 KB", "1 MB" };
+                const u32 blockSizeValues[] = { 0, 256, 4 * 1024, 64 * 1024, 1024 * 1024 };
+                int blockSize = uiMenu("Select block size for entropy map:", blockSizes);
+                if((blockSize >= 0) && (selectedLength > 0)) {
+                    if(!entropyScan(currentFile.id, selectedOffset, selectedLength, blockSizeValues[blockSize], entropyMap, true)) {
+                        uiErrorPrompt(gpu::SCREEN_TOP, "Analyzing", currentFile.id, true, false);
+                    } else {
+                        entropyBlock = 0;
+                        mode = M_ENTROPY;
+                        breakLoop = true;
+                    }
+                }
+            } else if((scope >= 0) && (transform == stringsEntry)) {
+                u32 minLength = uiNumberInput(gpu::SCREEN_TOP, 4, "Enter minimum string length below:\n", false);
+                if(minLength != (u32) -1) {
+                    if(!stringsFind(currentFile.id, selectedOffset, selectedLength, minLength, stringsResult, true)) {
+                        uiErrorPrompt(gpu::SCREEN_TOP, "Extracting", currentFile.id, true, false);
+                    } else if(stringsResult.count == 0) {
+                        uiPrompt(gpu::SCREEN_TOP, "No strings found.\n", false);
+                    } else {
+                        stringsPage = 0;
+                        stringsOffset = selectedOffset;
+                        stringsReturnMode = hvReturnMode;
+                        stringsLastId = "";
+                        mode = M_STRINGS;
+                        breakLoop = true;
+                    }
+                }
+            } else if(scope >= 0) {
+                std::vector<u8> param;
+                if(transform == T_FILL) param = uiDataInput(gpu::SCREEN_TOP, std::vector<u8>(1, 0x00), "Enter fill pattern below:\n", true);
+                else if(transform == T_XOR) param = uiDataInput(gpu::SCREEN_TOP, std::vector<u8>(1, 0xFF), "Enter XOR key below:\n", true);
+                else if(transform == T_ADD) param = uiDataInput(gpu::SCREEN_TOP, std::vector<u8>(1, 0x01), "Enter value to add below:\n", false);
+                bool needsParam = (transform == T_FILL) || (transform == T_XOR) || (transform == T_ADD);
+                if(!needsParam || !param.empty()) {
+                    if(!fsDataTransform(currentFile.id, (Transform) transform, param, selectedOffset, selectedLength, true))
+                        uiErrorPrompt(gpu::SCREEN_TOP, "Transforming", currentFile.id, true, false);
+                }
+            }
+            forceRefresh = true; // bottom screen was used by the menu
         } else if((selectButton == hid::BUTTON_Y) && hvClipboard.empty()) { // Y - COPY DATA
             hvClipboard = fsDataGet(currentFile.id, selectedOffset, selectedLength);
             if(hvClipboard.size() != selectedLength)
@@ -624,27 +1586,57 @@ int main(int argc, char **argv) {
             else forceRefresh = true;
         }
         
-        if(forceRefresh)
-            currentFile.details.at(2) = uiFormatBytes((u64) fsGetFileSize(currentFile.id)); 
+        if(forceRefresh) {
+            currentFile.details.at(2) = uiFormatBytes((u64) fsGetFileSize(currentFile.id));
+            hashPath = "";
+        }
+        
+        if(hashSelected)
+            hashData(currentFile.id, selectedOffset, selectedLength, selectedLength == fsGetFileSize(currentFile.id)); 
         
         return breakLoop;
     };
     
+    // viewer details are reformatted on every scroll step, they go through fmt and reuse the strings' memory
+    auto formatOffset = [](FmtBuffer &buf, u32 offset) {
+        fmtChar(buf, '@');
+        fmtHex(buf, offset, 8);
+        fmtString(buf, " (");
+        fmtDec(buf, offset);
+        fmtChar(buf, ')');
+    };
+    
+    indexStart(true); // revalidates the file name index in the background
+    
     while(core::running()) {
         uiInit();
         if(mode == M_HEXVIEWER) {
-            hvStoredOffset = (u32) -1;
+            if(hvReplacePending) {
+                hvReplacePending = false;
+                if(fsDataReplaceAll(currentFile.id, hvLastSearchHex, hvLastReplaceHex, false, true) == (u32) -1)
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Replacing", currentFile.id, true, false);
+                hvLastFoundOffset = (u32) -1;
+                currentFile.details.at(1) = uiFormatBytes((u64) fsGetFileSize(currentFile.id));
+                hashPath = "";
+                freeSpace = fsGetFreeSpace();
+            } else hvStoredOffset = (u32) -1;
             currentFile.details.insert(currentFile.details.begin(), "@FFFFFFFF (-1)");
             if(!uiHexViewer(currentFile.id, 0,
-                [&](u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode) { // onLoop
+                [&](u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode, bool &forceRefresh) { // onLoop
                     if(hvSelectMode != selectMode) hvSelectMode = selectMode;
-                    return onLoopHexViewer(offset, markedOffset, markedLength);
+                    if(hvStartOffset != (u32) -1) { // opened at a content search hit or an entropy map block
+                        offset = markedOffset = hvStartOffset;
+                        markedLength = hvStartLength;
+                        hvStartOffset = (u32) -1;
+                    }
+                    return onLoopHexViewer(offset, markedOffset, markedLength, forceRefresh);
                 },
                 [&](u32 offset) { // onUpdate
-                    std::stringstream ssOffset;
-                    ssOffset << "@" << std::setfill('0') << std::uppercase;
-                    ssOffset << std::hex << std::setw(8) << offset << " (" << std::dec << offset << ")";
-                    currentFile.details.at(0) = ssOffset.str();
+                    char str[32];
+                    FmtBuffer buf;
+                    fmtStart(buf, str, sizeof(str));
+                    formatOffset(buf, offset);
+                    currentFile.details.at(0).assign(buf.data, buf.size);
                     return false;
                 },
                 [&](u32 selectedOffset, u32 selectedLength, hid::Button selectButton, bool &forceRefresh) { // onSelect
@@ -652,20 +1644,277 @@ int main(int argc, char **argv) {
                 })) {
                 uiErrorPrompt(gpu::SCREEN_TOP, "Hexview", currentFile.name, true, false);
             }
-            mode = M_BROWSER;
+            currentFile.details.erase(currentFile.details.begin());
+            if((mode == M_HEXVIEWER) && !hvReplacePending) {
+                mode = hvReturnMode;
+                hvReturnMode = M_BROWSER;
+            }
+        } else if(mode == M_ENTROPY) {
+            std::vector<std::string> details = currentFile.details;
+            std::stringstream ssRegion;
+            ssRegion << "region " << std::fixed << std::setprecision(2) << entropyBits(entropyMap.histogram, entropyMap.size) << " bit/byte";
+            currentFile.details = { "@FFFFFFFF (-1)", "", ssRegion.str() };
+            if(!uiEntropyViewer(entropyMap, entropyBlock,
+                [&](u32 &block, bool &forceRefresh) { // onLoop
+                    return onLoopEntropy(block, forceRefresh);
+                },
+                [&](u32 block) { // onUpdate
+                    u32 offset = entropyMap.offset + (block * entropyMap.blockSize);
+                    u32 bits100 = ((entropyMap.entropy.at(block) * 100) + 16) / 32; // 1/32 bit steps, shown with two decimals
+                    char str[48];
+                    FmtBuffer buf;
+                    fmtStart(buf, str, sizeof(str));
+                    formatOffset(buf, offset);
+                    currentFile.details.at(0).assign(buf.data, buf.size);
+                    fmtStart(buf, str, sizeof(str));
+                    fmtString(buf, "block ");
+                    fmtDec(buf, block + 1);
+                    fmtString(buf, " of ");
+                    fmtDec(buf, entropyMap.entropy.size());
+                    fmtString(buf, ": ");
+                    fmtDec(buf, bits100 / 100);
+                    fmtChar(buf, '.');
+                    if(bits100 % 100 < 10) fmtChar(buf, '0');
+                    fmtDec(buf, bits100 % 100);
+                    fmtString(buf, " bit");
+                    currentFile.details.at(1).assign(buf.data, buf.size);
+                    entropyBlock = block;
+                    return false;
+                })) {
+                uiErrorPrompt(gpu::SCREEN_TOP, "Entropyview", currentFile.name, true, false);
+            }
+            currentFile.details = details;
+            if(hvStartOffset == (u32) -1) { // back to where the map was made
+                hvStartOffset = entropyMap.offset;
+                hvStartLength = 0;
+            }
+            mode = M_HEXVIEWER;
+        } else if(mode == M_STRINGS) {
+            std::vector<SelectableElement> elements;
+            const SelectableElement file = currentFile;
+            stringsElements(elements);
+            uiSelectMultiple(stringsLastId, elements,
+                [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) { // onLoop
+                    return onLoopStrings(currElements, elementsDirty, resetCursorIfDirty);
+                },
+                [&](SelectableElement* entry) { // onUpdateCursor
+                    currentFile = *entry;
+                },
+                NULL,
+                [&](SelectableElement* selected) { // onSelect
+                    u32 offset = strtoul((*selected).id.c_str(), NULL, 16);
+                    for(std::vector<StringHit>::iterator it = stringsHits.begin(); it != stringsHits.end(); it++) {
+                        if((*it).offset == offset) hvStartLength = ((*it).wide) ? (*it).length * 2 : (*it).length;
+                    }
+                    stringsLastId = (*selected).id;
+                    hvStartOffset = offset;
+                    hvReturnMode = M_STRINGS;
+                    mode = M_HEXVIEWER;
+                    return true;
+                },
+                false, false);
+            currentFile = file;
+            if(mode == M_STRINGS) { // back to where the strings were extracted
+                stringsClear(stringsResult);
+                stringsHits.clear();
+                hvStartOffset = stringsOffset;
+                hvStartLength = 0;
+                hvReturnMode = stringsReturnMode;
+                mode = M_HEXVIEWER;
+            }
         } else if(mode == M_TEXTVIEWER) {
             currentFile.details.insert(currentFile.details.begin(), "@FFFFFFFF+F (-1+-1)");
+            currentFile.details.insert(currentFile.details.begin() + 1, "line ? of ?");
+            currentFile.details.insert(currentFile.details.begin() + 2, "");
             if(!uiTextViewer(currentFile.id, onLoopTextViewer,
-                [&](u32 offset, u32 plus) { // onUpdate
-                    std::stringstream ssOffset;
-                    ssOffset << "@" << std::setfill('0') << std::uppercase;
-                    ssOffset << std::hex << std::setw(8) << offset << "+" << plus;
-                    ssOffset << " (" << std::dec << offset << "+" << plus << ")";
-                    currentFile.details.at(0) = ssOffset.str();
+                [&](u32 offset, u32 plus, u32 line, u32 nLines, bool indexing, u32 hit, u32 nHits, bool searching, bool following) { // onUpdate
+                    char str[48];
+                    FmtBuffer buf;
+                    u32 plusDigits = 1;
+                    for (u32 p = plus >> 4; p > 0; p >>= 4) plusDigits++;
+                    fmtStart(buf, str, sizeof(str));
+                    fmtChar(buf, '@');
+                    fmtHex(buf, offset, 8);
+                    fmtChar(buf, '+');
+                    fmtHex(buf, plus, plusDigits);
+                    fmtString(buf, " (");
+                    fmtDec(buf, offset);
+                    fmtChar(buf, '+');
+                    fmtDec(buf, plus);
+                    fmtChar(buf, ')');
+                    currentFile.details.at(0).assign(buf.data, buf.size);
+                    fmtStart(buf, str, sizeof(str));
+                    fmtString(buf, "line ");
+                    if(line != (u32) -1) fmtDec(buf, line + 1);
+                    else fmtChar(buf, '?');
+                    fmtString(buf, " of ");
+                    fmtDec(buf, nLines);
+                    if(indexing) fmtChar(buf, '+');
+                    if(following) fmtString(buf, " (follow)");
+                    currentFile.details.at(1).assign(buf.data, buf.size);
+                    fmtStart(buf, str, sizeof(str));
+                    if(nHits != (u32) -1) {
+                        fmtString(buf, "hit ");
+                        if(hit != (u32) -1) fmtDec(buf, hit + 1);
+                        else fmtChar(buf, '-');
+                        fmtString(buf, " of ");
+                        fmtDec(buf, nHits);
+                        if(searching || (nHits >= 0x10000)) fmtChar(buf, '+');
+                    }
+                    currentFile.details.at(2).assign(buf.data, buf.size);
                     return false;
                 }))
                 uiErrorPrompt(gpu::SCREEN_TOP, "Textview", currentFile.name, true, false);
             mode = M_BROWSER;
+        } else if(mode == M_COMPARE) {
+            if(!fsDataCompare(currentFile.id, cmpPath, cmpDiffs, 0x10000, true)) {
+                uiErrorPrompt(gpu::SCREEN_TOP, "Comparing", currentFile.name, true, false);
+            } else if(cmpDiffs.empty()) {
+                uiPrompt(gpu::SCREEN_TOP, "Files are identical.\n", false);
+            } else {
+                currentFile.details = { "@FFFFFFFF (-1)", "vs. " + uiTruncateString(fsGetFileName(cmpPath), 18, -8), "" };
+                if(!uiCompareViewer(currentFile.id, cmpPath, cmpDiffs.front().offset, 
+                    [&](u32 &offset, bool &forceRefresh) { // onLoop
+                        return onLoopCompare(offset, forceRefresh);
+                    },
+                    [&](u32 offset) { // onUpdate
+                        char str[48];
+                        FmtBuffer buf;
+                        fmtStart(buf, str, sizeof(str));
+                        formatOffset(buf, offset);
+                        currentFile.details.at(0).assign(buf.data, buf.size);
+                        std::vector<DataRange>::iterator it = std::upper_bound(cmpDiffs.begin(), cmpDiffs.end(), offset,
+                            [](u32 offset, const DataRange &range) { return offset < range.offset + range.size; });
+                        fmtStart(buf, str, sizeof(str));
+                        fmtString(buf, "diff ");
+                        fmtDec(buf, it - cmpDiffs.begin() + ((it != cmpDiffs.end()) ? 1 : 0));
+                        fmtString(buf, " of ");
+                        fmtDec(buf, cmpDiffs.size());
+                        if(cmpDiffs.size() >= 0x10000) fmtChar(buf, '+');
+                        currentFile.details.at(2).assign(buf.data, buf.size);
+                        return false;
+                    })) {
+                    uiErrorPrompt(gpu::SCREEN_TOP, "Compareview", currentFile.name, true, false);
+                }
+            }
+            cmpDiffs.clear();
+            mode = M_BROWSER;
+        } else if(mode == M_DUPES) {
+            std::vector<SelectableElement> elements;
+            dupeElements(elements);
+            uiSelectMultiple(currentFile.id, elements,
+                [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) { // onLoop
+                    return onLoopDupes(currElements, elementsDirty, resetCursorIfDirty);
+                },
+                [&](SelectableElement* entry) { // onUpdateCursor
+                    currentFile = *entry;
+                },
+                [&](std::set<SelectableElement*>* marked) { // onUpdateMarked
+                    markedElements = marked;
+                },
+                [&](SelectableElement* selected) { // onSelect
+                    return false;
+                },
+                false, false);
+            markedElements = NULL;
+            dupeGroups.clear();
+            mode = M_BROWSER;
+        } else if(mode == M_USAGE) {
+            std::vector<SelectableElement> elements;
+            usageElements(elements);
+            currentDir = usageDir;
+            uiSelectMultiple("", elements,
+                [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) { // onLoop
+                    return onLoopUsage(currElements, elementsDirty, resetCursorIfDirty);
+                },
+                [&](SelectableElement* entry) { // onUpdateCursor
+                    currentFile = *entry;
+                },
+                [&](std::set<SelectableElement*>* marked) { // onUpdateMarked
+                    markedElements = marked;
+                },
+                [&](SelectableElement* selected) { // onSelect
+                    if((*selected).id.empty()) return false;
+                    if((*selected).details.front().compare("folder") != 0) return true; // browser opens at the file
+                    usageDir = (*selected).id;
+                    usageRefresh = true;
+                    return false;
+                },
+                false, false);
+            markedElements = NULL;
+            mode = M_BROWSER;
+        } else if(mode == M_SEARCH) {
+            std::vector<SelectableElement> elements;
+            for(std::vector<FileInfoEx>::iterator it = searchResults.begin(); it != searchResults.end(); it++) {
+                const std::string name = (*it).path.substr(std::string(INDEX_ROOT).size()) + (((*it).isDirectory) ? "/" : "");
+                elements.push_back({(*it).path, name, { ((*it).isDirectory) ? "folder" : "file", searchInfo }});
+            }
+            currentDir = "\"" + searchQuery + "\"";
+            uiSelectMultiple("", elements,
+                [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) { // onLoop
+                    return onLoopSearch();
+                },
+                [&](SelectableElement* entry) { // onUpdateCursor
+                    currentFile = *entry;
+                },
+                NULL,
+                [&](SelectableElement* selected) { // onSelect
+                    currentFile = *selected; // the browser opens at the selected path
+                    return true;
+                },
+                false, false);
+            searchResults.clear();
+            mode = M_BROWSER;
+        } else if(mode == M_GREP) {
+            std::vector<SelectableElement> elements;
+            const std::string base = (grepDir[grepDir.size() - 1] == '/') ? grepDir : grepDir + "/";
+            for(std::vector<GrepHit>::iterator it = grepHits.begin(); it != grepHits.end(); it++) {
+                const std::vector<u8> &pattern = grepPatterns.at((*it).pattern);
+                std::stringstream id;
+                std::stringstream name;
+                std::stringstream patternStr;
+                id << (*it).path << "@" << std::hex << (*it).offset;
+                name << "[" << std::setfill('0') << std::uppercase << std::hex << std::setw(8) << (*it).offset << "] ";
+                name << (*it).path.substr(base.size());
+                bool isText = std::all_of(pattern.begin(), pattern.end(), [](u8 c) { return (c >= 0x20) && (c < 0x7F); });
+                if(isText) patternStr << "\"" << uiTruncateString(std::string(pattern.begin(), pattern.end()), 28, -8) << "\"";
+                else {
+                    patternStr << std::setfill('0') << std::uppercase << std::hex;
+                    for(u32 i = 0; (i < pattern.size()) && (i < 16); i++) patternStr << std::setw(2) << (u32) pattern.at(i);
+                    if(pattern.size() > 16) patternStr << "...";
+                }
+                elements.push_back({id.str(), name.str(), { patternStr.str(), grepInfo }});
+            }
+            currentDir = grepDir;
+            uiSelectMultiple(grepLastId, elements,
+                [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) { // onLoop
+                    return onLoopGrep();
+                },
+                [&](SelectableElement* entry) { // onUpdateCursor
+                    currentFile = *entry;
+                },
+                NULL,
+                [&](SelectableElement* selected) { // onSelect
+                    // ids are "path@offset", the list comes back here once the hex viewer is closed
+                    std::string::size_type atPos = (*selected).id.rfind('@');
+                    const std::string path = (*selected).id.substr(0, atPos);
+                    u32 offset = strtoul((*selected).id.c_str() + atPos + 1, NULL, 16);
+                    for(std::vector<GrepHit>::iterator it = grepHits.begin(); it != grepHits.end(); it++) {
+                        if(((*it).offset == offset) && ((*it).path == path)) hvLastSearch = grepPatterns.at((*it).pattern);
+                    }
+                    grepLastId = (*selected).id;
+                    hvStartOffset = hvLastFoundOffset = offset;
+                    hvStartLength = hvLastSearch.size();
+                    hvReturnMode = M_GREP;
+                    currentFile = { path, fsGetFileName(path), { "file", uiFormatBytes(fsGetFileSize(path)) } };
+                    mode = M_HEXVIEWER;
+                    return true;
+                },
+                false, false);
+            if(mode == M_GREP) {
+                grepHits.clear();
+                mode = M_BROWSER;
+            }
         } else {
             uiFileBrowser( "sdmc:/", currentFile.id,
                 [&](bool &updateList, bool &resetCursor) { // onLoop function
@@ -681,10 +1930,42 @@ int main(int argc, char **argv) {
                     markedElements = marked;
                 },
                 [&](std::string selectedPath, bool &updateList) { // onSelect function
+                    if((markedElements != NULL) && ((*markedElements).size() == 2)) {
+                        SelectableElement* first = *((*markedElements).begin());
+                        SelectableElement* second = *(++((*markedElements).begin()));
+                        if(fsIsDirectory((*first).id) || fsIsDirectory((*second).id)) {
+                            uiPrompt(gpu::SCREEN_TOP, "Only files can be compared.\n", false);
+                            return false;
+                        }
+                        // a marked IPS / BPS patch gets applied to the other file
+                        SelectableElement* patch = (fsHasExtensions((*first).id, patchExtensions)) ? first :
+                            (fsHasExtensions((*second).id, patchExtensions)) ? second : NULL;
+                        if(patch != NULL) {
+                            const std::string alphabet = " ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz(){}[]'`^,~!@#$%&0123456789=+-_.";
+                            SelectableElement* source = (patch == first) ? second : first;
+                            std::string name = (*source).name;
+                            std::string::size_type dotPos = name.rfind('.');
+                            name.insert((dotPos != std::string::npos) ? dotPos : name.length(), "_patched");
+                            std::string confirmMsg = "Apply \"" + uiTruncateString((*patch).name, 24, -8) + "\"\nto \"" +
+                                uiTruncateString((*source).name, 24, -8) + "\"?\nEnter output name below:\n";
+                            name = uiStringInput(gpu::SCREEN_TOP, name, alphabet, confirmMsg, 1, true);
+                            if(!name.empty()) {
+                                if(!patchApply((*patch).id, (*source).id, currentDir + "/" + name, true))
+                                    uiErrorPrompt(gpu::SCREEN_TOP, "Patching", (*source).name, true, false);
+                                freeSpace = fsGetFreeSpace();
+                                updateList = true;
+                            }
+                            return false;
+                        }
+                        currentFile = *first;
+                        cmpPath = (*second).id;
+                        mode = M_COMPARE;
+                        return true;
+                    }
                     u64 inputAHoldTime = core::time();
                     for (hid::poll();
                         hid::held(hid::BUTTON_A) && core::time() - inputAHoldTime < tapDelay;
-                        hid::poll()) gpu::swapBuffers(true);
+                        hid::poll()) uiSwapBuffers(true);
                     mode = (core::time() - inputAHoldTime >= tapDelay) ? M_TEXTVIEWER : M_HEXVIEWER;
                     return true;
                 });
@@ -695,6 +1976,8 @@ int main(int argc, char **argv) {
         }
     }
 
+    stringsClear(stringsResult);
+    indexStop();
     core::exit();
     uiCleanup();
     
@@ -0,0 +1,351 @@
+#include "mem.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+// ARM11 (ARMv6K) has byte-wise SIMD (uadd8 / sel / usada8), use it when compiling for the console
+#if defined(__arm__) && defined(__ARM_ARCH) && (__ARM_ARCH >= 6) && (!defined(__thumb__) || defined(__thumb2__))
+#define CTRX_ARMV6_SIMD
+#endif
+
+#define MEM_ALIGNED(ptr) (((uintptr_t) (ptr) & 3) == 0)
+
+static inline u32 memLoad(const u8* ptr) {
+    u32 word;
+    memcpy(&word, ptr, 4);
+    return word;
+}
+
+static inline void memStore(u8* ptr, u32 word) {
+    memcpy(ptr, &word, 4);
+}
+
+// returns a mask with the high bit set in every zero byte of word (no false positives)
+static inline u32 memZeroBytes(u32 word) {
+    #if defined CTRX_ARMV6_SIMD
+    u32 mask;
+    // GE flags are set for every nonzero byte, sel then picks 0x00 for those and 0xFF for zero bytes
+    __asm__ ("uadd8 %0, %1, %2\n\tsel %0, %3, %2" : "=&r" (mask) : "r" (word), "r" (0xFFFFFFFF), "r" (0) : "cc");
+    return mask;
+    #else
+    return ~(((word & 0x7F7F7F7F) + 0x7F7F7F7F) | word | 0x7F7F7F7F);
+    #endif
+}
+
+// byte positions in a mask / difference (little endian)
+static inline u32 memFirstByte(u32 mask) {
+    return __builtin_ctz(mask) >> 3;
+}
+
+static inline u32 memLastByte(u32 mask) {
+    return (31 - __builtin_clz(mask)) >> 3;
+}
+
+u32 memFindByte(const u8* data, u32 size, u8 value) {
+    const u32 pattern = (u32) value * 0x01010101;
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        if(data[pos] == value) return pos;
+    for (; pos + 8 <= size; pos += 8) {
+        u32 mask0 = memZeroBytes(memLoad(data + pos) ^ pattern);
+        u32 mask1 = memZeroBytes(memLoad(data + pos + 4) ^ pattern);
+        if(mask0 | mask1) return (mask0) ? pos + memFirstByte(mask0) : pos + 4 + memFirstByte(mask1);
+    }
+    for (; pos < size; pos++)
+        if(data[pos] == value) return pos;
+    return (u32) -1;
+}
+
+u32 memFindLastByte(const u8* data, u32 size, u8 value) {
+    const u32 pattern = (u32) value * 0x01010101;
+    u32 pos = size;
+    for (; (pos > 0) && !MEM_ALIGNED(data + pos); pos--)
+        if(data[pos - 1] == value) return pos - 1;
+    for (; pos >= 4; pos -= 4) {
+        u32 mask = memZeroBytes(memLoad(data + pos - 4) ^ pattern);
+        if(mask) return pos - 4 + memLastByte(mask);
+    }
+    for (; pos > 0; pos--)
+        if(data[pos - 1] == value) return pos - 1;
+    return (u32) -1;
+}
+
+u32 memFindAnyOf(const u8* data, u32 size, const u8* values, u32 nValues) {
+    if(nValues == 0) return (u32) -1;
+    if(nValues == 1) return memFindByte(data, size, values[0]);
+    if(nValues > 4) { // large sets are faster with a lookup table
+        u8 table[256] = { 0 };
+        for (u32 i = 0; i < nValues; i++) table[values[i]] = 1;
+        for (u32 pos = 0; pos < size; pos++)
+            if(table[data[pos]]) return pos;
+        return (u32) -1;
+    }
+
+    u32 patterns[4];
+    for (u32 i = 0; i < 4; i++) // unused slots repeat the first value
+        patterns[i] = (u32) values[(i < nValues) ? i : 0] * 0x01010101;
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        for (u32 i = 0; i < nValues; i++)
+            if(data[pos] == values[i]) return pos;
+    for (; pos + 4 <= size; pos += 4) {
+        u32 word = memLoad(data + pos);
+        u32 mask = memZeroBytes(word ^ patterns[0]) | memZeroBytes(word ^ patterns[1]) |
+            memZeroBytes(word ^ patterns[2]) | memZeroBytes(word ^ patterns[3]);
+        if(mask) return pos + memFirstByte(mask);
+    }
+    for (; pos < size; pos++)
+        for (u32 i = 0; i < nValues; i++)
+            if(data[pos] == values[i]) return pos;
+    return (u32) -1;
+}
+
+static inline bool memMatchAt(const u8* data, const u8* term, u32 termSize) {
+    // the first byte is already known to match, the last one is checked before the rest
+    return (data[termSize - 1] == term[termSize - 1]) && (memMismatch(data + 1, term + 1, termSize - 1) == (u32) -1);
+}
+
+u32 memFind(const u8* data, u32 size, const u8* term, u32 termSize) {
+    if((termSize == 0) || (termSize > size)) return (u32) -1;
+    if(termSize == 1) return memFindByte(data, size, term[0]);
+    // one pass over the words, positions matching the first two term bytes are tried in order
+    // (pos + 1 + 4 <= size holds in the word loop, the term is at least two bytes long)
+    const u32 pattern0 = (u32) term[0] * 0x01010101;
+    const u32 pattern1 = (u32) term[1] * 0x01010101;
+    const u32 end = size - termSize + 1; // end of possible match positions
+    u32 pos = 0;
+    for (; (pos < end) && !MEM_ALIGNED(data + pos); pos++)
+        if((data[pos] == term[0]) && memMatchAt(data + pos, term, termSize)) return pos;
+    for (; pos + 4 <= end; pos += 4) {
+        u32 mask = memZeroBytes(memLoad(data + pos) ^ pattern0) & memZeroBytes(memLoad(data + pos + 1) ^ pattern1);
+        while(mask) {
+            u32 byte = memFirstByte(mask);
+            if(memMatchAt(data + pos + byte, term, termSize)) return pos + byte;
+            mask &= ~(0xFFu << (byte * 8));
+        }
+    }
+    for (; pos < end; pos++)
+        if((data[pos] == term[0]) && memMatchAt(data + pos, term, termSize)) return pos;
+    return (u32) -1;
+}
+
+u32 memMismatch(const u8* data0, const u8* data1, u32 size) {
+    u32 pos = 0;
+    if(MEM_ALIGNED((uintptr_t) data0 ^ (uintptr_t) data1)) {
+        for (; (pos < size) && !MEM_ALIGNED(data0 + pos); pos++)
+            if(data0[pos] != data1[pos]) return pos;
+    }
+    for (; pos + 8 <= size; pos += 8) {
+        u32 diff0 = memLoad(data0 + pos) ^ memLoad(data1 + pos);
+        u32 diff1 = memLoad(data0 + pos + 4) ^ memLoad(data1 + pos + 4);
+        if(diff0 | diff1) return (diff0) ? pos + memFirstByte(diff0) : pos + 4 + memFirstByte(diff1);
+    }
+    for (; pos < size; pos++)
+        if(data0[pos] != data1[pos]) return pos;
+    return (u32) -1;
+}
+
+bool memIsAll(const u8* data, u32 size, u8 value) {
+    const u32 pattern = (u32) value * 0x01010101;
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        if(data[pos] != value) return false;
+    for (; pos + 8 <= size; pos += 8)
+        if((memLoad(data + pos) ^ pattern) | (memLoad(data + pos + 4) ^ pattern)) return false;
+    for (; pos < size; pos++)
+        if(data[pos] != value) return false;
+    return true;
+}
+
+u32 memCountByte(const u8* data, u32 size, u8 value) {
+    const u32 pattern = (u32) value * 0x01010101;
+    u32 count = 0;
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        if(data[pos] == value) count++;
+    #if defined CTRX_ARMV6_SIMD
+    for (; pos + 4 <= size; pos += 4) {
+        // 0x01 for every matching byte, then summed up by usada8
+        u32 tmp;
+        __asm__ ("uadd8 %0, %2, %3\n\tsel %0, %4, %5\n\tusada8 %1, %0, %4, %1" : "=&r" (tmp), "+r" (count) :
+            "r" (memLoad(data + pos) ^ pattern), "r" (0xFFFFFFFF), "r" (0), "r" (0x01010101) : "cc");
+    }
+    #else
+    // 0x01 for every matching byte, summed up per byte lane and added to count before a lane can overflow
+    // (a popcount per word is a library call on cores without a popcount instruction)
+    while(pos + 4 <= size) {
+        u32 lanes = 0;
+        u32 blockEnd = pos + (((size - pos) / 4 < 255) ? ((size - pos) & ~3) : 4 * 255);
+        for (; pos < blockEnd; pos += 4)
+            lanes += memZeroBytes(memLoad(data + pos) ^ pattern) >> 7;
+        lanes = (lanes & 0x00FF00FF) + ((lanes >> 8) & 0x00FF00FF);
+        count += (lanes & 0xFFFF) + (lanes >> 16);
+    }
+    #endif
+    for (; pos < size; pos++)
+        if(data[pos] == value) count++;
+    return count;
+}
+
+void memHistogram(const u8* data, u32 size, u32* histogram) {
+    // four interleaved sub-histograms avoid stalls on repeated bytes
+    u32 hist[4][256];
+    memset(hist, 0, sizeof(hist));
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        hist[0][data[pos]]++;
+    for (; pos + 4 <= size; pos += 4) {
+        u32 word = memLoad(data + pos);
+        hist[0][word & 0xFF]++;
+        hist[1][(word >> 8) & 0xFF]++;
+        hist[2][(word >> 16) & 0xFF]++;
+        hist[3][word >> 24]++;
+    }
+    for (; pos < size; pos++)
+        hist[0][data[pos]]++;
+    for (u32 i = 0; i < 256; i++)
+        histogram[i] += hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+}
+
+void memFill(u8* data, u32 size, u8 value) {
+    memFillPattern(data, size, &value, 1, 0);
+}
+
+void memFillPattern(u8* data, u32 size, const u8* pattern, u32 patternSize, u32 phase) {
+    if((size == 0) || (patternSize == 0)) return;
+    phase %= patternSize;
+    if(patternSize == 1) {
+        memset(data, pattern[0], size);
+        return;
+    }
+    // write the pattern once, then keep doubling the filled area
+    u32 filled = 0;
+    for (; (filled < size) && (filled < patternSize); filled++)
+        data[filled] = pattern[(phase + filled) % patternSize];
+    while(filled < size) {
+        u32 copy = (size - filled < filled) ? size - filled : filled;
+        memcpy(data + filled, data, copy);
+        filled += copy;
+    }
+}
+
+static void memXorBlock(u8* data, const u8* key, u32 size) {
+    u32 pos = 0;
+    for (; pos + 4 <= size; pos += 4)
+        memStore(data + pos, memLoad(data + pos) ^ memLoad(key + pos));
+    for (; pos < size; pos++)
+        data[pos] ^= key[pos];
+}
+
+void memXorPattern(u8* data, u32 size, const u8* pattern, u32 patternSize, u32 phase) {
+    if((size == 0) || (patternSize == 0)) return;
+    // short keys are repeated into a block, so the word loop gets long runs
+    u8 block[256];
+    const u8* key = pattern;
+    u32 keySize = patternSize;
+    if(patternSize <= sizeof(block) / 2) {
+        keySize = (sizeof(block) / patternSize) * patternSize;
+        for (u32 i = 0; i < keySize; i++) block[i] = pattern[i % patternSize];
+        key = block;
+    }
+    for (u32 pos = phase % patternSize; size > 0; pos = 0) {
+        u32 run = (size < keySize - pos) ? size : keySize - pos;
+        memXorBlock(data, key + pos, run);
+        data += run;
+        size -= run;
+    }
+}
+
+void memAddByte(u8* data, u32 size, u8 value) {
+    const u32 pattern = (u32) value * 0x01010101;
+    u32 pos = 0;
+    for (; pos + 4 <= size; pos += 4) {
+        u32 word = memLoad(data + pos);
+        #if defined CTRX_ARMV6_SIMD
+        __asm__ ("uadd8 %0, %0, %1" : "+r" (word) : "r" (pattern) : "cc");
+        #else
+        // bytewise add, no carry into the next byte
+        word = ((word & 0x7F7F7F7F) + (pattern & 0x7F7F7F7F)) ^ ((word ^ pattern) & 0x80808080);
+        #endif
+        memStore(data + pos, word);
+    }
+    for (; pos < size; pos++)
+        data[pos] += value;
+}
+
+void memInvert(u8* data, u32 size) {
+    u32 pos = 0;
+    for (; pos + 4 <= size; pos += 4)
+        memStore(data + pos, ~memLoad(data + pos));
+    for (; pos < size; pos++)
+        data[pos] = ~data[pos];
+}
+
+void memSwap(u8* data, u32 size, u32 unit) {
+    // size has to be a multiple of unit (2, 4 or 8 byte)
+    u32 pos = 0;
+    if(unit == 2) {
+        for (; pos + 4 <= size; pos += 4) {
+            u32 word = memLoad(data + pos);
+            #if defined CTRX_ARMV6_SIMD
+            __asm__ ("rev16 %0, %0" : "+r" (word));
+            #else
+            word = ((word & 0x00FF00FF) << 8) | ((word >> 8) & 0x00FF00FF);
+            #endif
+            memStore(data + pos, word);
+        }
+        if(pos + 2 <= size) {
+            u8 tmp = data[pos];
+            data[pos] = data[pos + 1];
+            data[pos + 1] = tmp;
+        }
+    } else if(unit == 4) {
+        for (; pos + 4 <= size; pos += 4)
+            memStore(data + pos, __builtin_bswap32(memLoad(data + pos)));
+    } else if(unit == 8) {
+        for (; pos + 8 <= size; pos += 8) {
+            u32 word0 = memLoad(data + pos);
+            memStore(data + pos, __builtin_bswap32(memLoad(data + pos + 4)));
+            memStore(data + pos + 4, __builtin_bswap32(word0));
+        }
+    }
+}
+
+void memMove(u8* dest, const u8* src, u32 size) {
+    // memcpy is the faster path and safe as long as the areas don't overlap
+    if((dest + size <= src) || (src + size <= dest)) memcpy(dest, src, size);
+    else if(dest != src) memmove(dest, src, size);
+}
+
+u32 memCrc32(u32 crc, const u8* data, u32 size) {
+    // CRC32 (zlib / PKZIP polynomial), pass the previous result to continue a running checksum
+    // slicing-by-8: table[k][i] is the CRC of byte i followed by k zero bytes, 8 bytes per step (little endian)
+    static u32 table[8][256];
+    static bool tableReady = false;
+    if(!tableReady) {
+        for (u32 i = 0; i < 256; i++) {
+            u32 c = i;
+            for (u32 b = 0; b < 8; b++)
+                c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : c >> 1;
+            table[0][i] = c;
+        }
+        for (u32 i = 0; i < 256; i++) {
+            for (u32 k = 1; k < 8; k++)
+                table[k][i] = table[0][table[k - 1][i] & 0xFF] ^ (table[k - 1][i] >> 8);
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    u32 pos = 0;
+    for (; (pos < size) && !MEM_ALIGNED(data + pos); pos++)
+        crc = table[0][(crc ^ data[pos]) & 0xFF] ^ (crc >> 8);
+    for (; pos + 8 <= size; pos += 8) {
+        u32 word0 = memLoad(data + pos) ^ crc;
+        u32 word1 = memLoad(data + pos + 4);
+        crc = table[7][word0 & 0xFF] ^ table[6][(word0 >> 8) & 0xFF] ^ table[5][(word0 >> 16) & 0xFF] ^ table[4][word0 >> 24] ^
+              table[3][word1 & 0xFF] ^ table[2][(word1 >> 8) & 0xFF] ^ table[1][(word1 >> 16) & 0xFF] ^ table[0][word1 >> 24];
+    }
+    for (; pos < size; pos++)
+        crc = table[0][(crc ^ data[pos]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
@@ -0,0 +1,26 @@
+#ifndef __CTRX_MEM_HPP__
+#define __CTRX_MEM_HPP__
+
+#include <citrus/types.hpp>
+
+// word-at-a-time byte kernels, ARMv6 SIMD on the console, portable elsewhere
+// search functions return an index into data, (u32) -1 if nothing was found
+
+u32 memFindByte(const u8* data, u32 size, u8 value);
+u32 memFindLastByte(const u8* data, u32 size, u8 value);
+u32 memFindAnyOf(const u8* data, u32 size, const u8* values, u32 nValues);
+u32 memFind(const u8* data, u32 size, const u8* term, u32 termSize);
+u32 memMismatch(const u8* data0, const u8* data1, u32 size);
+bool memIsAll(const u8* data, u32 size, u8 value);
+u32 memCountByte(const u8* data, u32 size, u8 value);
+void memHistogram(const u8* data, u32 size, u32* histogram);
+void memFill(u8* data, u32 size, u8 value);
+void memFillPattern(u8* data, u32 size, const u8* pattern, u32 patternSize, u32 phase = 0);
+void memXorPattern(u8* data, u32 size, const u8* pattern, u32 patternSize, u32 phase = 0);
+void memAddByte(u8* data, u32 size, u8 value);
+void memInvert(u8* data, u32 size);
+void memSwap(u8* data, u32 size, u32 unit);
+void memMove(u8* dest, const u8* src, u32 size);
+u32 memCrc32(u32 crc, const u8* data, u32 size);
+
+#endif
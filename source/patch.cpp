@@ -0,0 +1,531 @@
+#include "patch.hpp"
+#include "fs.hpp"
+#include "mem.hpp"
+
+#include <sys/errno.h>
+#include <sys/unistd.h>
+#include <string.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#define PATCH_BUFSIZ (64 * 1024)
+
+#define IPS_EOF 0x454F46 // "EOF", can't be used as a record offset
+#define IPS_MAX_OFFSET 0x1000000
+#define IPS_MAX_RECORD 0xFFFF
+#define IPS_MIN_RLE 16
+
+#define BPS_SOURCE_READ 0
+#define BPS_TARGET_READ 1
+#define BPS_SOURCE_COPY 2
+#define BPS_TARGET_COPY 3
+
+// buffered sequential output with a running CRC32, data already written can be read back
+typedef struct {
+    FILE* fp;
+    u8* buffer;
+    u32 fill;
+    u64 flushed; // file position of buffer start
+    u32 crc;
+} PatchOutput;
+
+static bool patchFlush(PatchOutput &out) {
+    if(out.fill == 0) return true;
+    if((fseek(out.fp, out.flushed, SEEK_SET) != 0) || (fwrite(out.buffer, 1, out.fill, out.fp) != out.fill))
+        return false;
+    out.crc = memCrc32(out.crc, out.buffer, out.fill);
+    out.flushed += out.fill;
+    out.fill = 0;
+    return true;
+}
+
+static bool patchWrite(PatchOutput &out, const u8* data, u32 size) {
+    while(size > 0) {
+        u32 l_size = (size < PATCH_BUFSIZ - out.fill) ? size : PATCH_BUFSIZ - out.fill;
+        memcpy(out.buffer + out.fill, data, l_size);
+        out.fill += l_size;
+        data += l_size;
+        size -= l_size;
+        if((out.fill == PATCH_BUFSIZ) && !patchFlush(out)) return false;
+    }
+    return true;
+}
+
+static bool patchWriteU24BE(PatchOutput &out, u32 value) {
+    u8 data[3] = { (u8) (value >> 16), (u8) (value >> 8), (u8) value };
+    return patchWrite(out, data, 3);
+}
+
+static bool patchWriteU16BE(PatchOutput &out, u32 value) {
+    u8 data[2] = { (u8) (value >> 8), (u8) value };
+    return patchWrite(out, data, 2);
+}
+
+static bool patchWriteU32LE(PatchOutput &out, u32 value) {
+    u8 data[4] = { (u8) value, (u8) (value >> 8), (u8) (value >> 16), (u8) (value >> 24) };
+    return patchWrite(out, data, 4);
+}
+
+static bool patchWriteNumber(PatchOutput &out, u64 value) {
+    // BPS variable length number, 7 bits per byte, high bit terminates
+    u8 data[10];
+    u32 size = 0;
+    while(true) {
+        u8 x = value & 0x7F;
+        value >>= 7;
+        if(value == 0) {
+            data[size++] = 0x80 | x;
+            break;
+        }
+        data[size++] = x;
+        value--;
+    }
+    return patchWrite(out, data, size);
+}
+
+static bool patchReadNumber(FILE* fp, u64 &value) {
+    u64 shift = 1;
+    value = 0;
+    for (u32 i = 0; i < 10; i++) {
+        int c = fgetc(fp);
+        if(c == EOF) return false;
+        value += (c & 0x7F) * shift;
+        if(c & 0x80) return true;
+        shift <<= 7;
+        value += shift;
+    }
+    return false;
+}
+
+static u32 patchReadU32LE(const u8* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((u32) data[3] << 24);
+}
+
+static bool patchCopyFrom(PatchOutput &out, FILE* fp, u64 offset, u64 size, u8* buffer) {
+    if(fseek(fp, offset, SEEK_SET) != 0) return false;
+    while(size > 0) {
+        u32 l_size = (size < PATCH_BUFSIZ) ? size : PATCH_BUFSIZ;
+        if((fread(buffer, 1, l_size, fp) != l_size) || !patchWrite(out, buffer, l_size))
+            return false;
+        size -= l_size;
+    }
+    return true;
+}
+
+static bool patchCrcFile(FILE* fp, u64 size, u32 &crc, u8* buffer, const std::string path, bool showProgress) {
+    crc = 0;
+    if(fseek(fp, 0, SEEK_SET) != 0) return false;
+    for (u64 pos = 0; pos < size; ) {
+        if(showProgress && !fsShowProgress("Verifying", path, pos, size)) {
+            errno = ECANCELED;
+            return false;
+        }
+        u32 l_size = (size - pos < PATCH_BUFSIZ) ? size - pos : PATCH_BUFSIZ;
+        if(fread(buffer, 1, l_size, fp) != l_size) return false;
+        crc = memCrc32(crc, buffer, l_size);
+        pos += l_size;
+    }
+    return true;
+}
+
+PatchType patchGetType(const std::string path) {
+    u8 magic[5];
+    FILE* fp = fopen(path.c_str(), "rb");
+    if(fp == NULL) return P_UNKNOWN;
+    size_t size = fread(magic, 1, 5, fp);
+    fclose(fp);
+    if((size >= 5) && (memcmp(magic, "PATCH", 5) == 0)) return P_IPS;
+    if((size >= 4) && (memcmp(magic, "BPS1", 4) == 0)) return P_BPS;
+    return P_UNKNOWN;
+}
+
+static bool patchApplyIPS(FILE* fp, u64 patchSize, const std::string destPath, u8* buffer, bool showProgress) {
+    // destination starts out as a copy of the source, records are written in place
+    u64 size = fsGetFileSize(destPath);
+    u8 header[5];
+    FILE* fd = fopen(destPath.c_str(), "rb+");
+    if(fd == NULL) return false;
+
+    bool ret = (fread(header, 1, 5, fp) == 5) && (memcmp(header, "PATCH", 5) == 0);
+    if(!ret) errno = EBADMSG;
+    while(ret) {
+        if(showProgress && !fsShowProgress("Patching", destPath, ftell(fp), patchSize)) {
+            errno = ECANCELED;
+            ret = false;
+            break;
+        }
+        u8 record[5];
+        if(fread(record, 1, 3, fp) != 3) {
+            errno = EBADMSG;
+            ret = false;
+            break;
+        }
+        u32 offset = (record[0] << 16) | (record[1] << 8) | record[2];
+        if(offset == IPS_EOF) { // optional truncation size follows
+            if(fread(record, 1, 3, fp) == 3)
+                ret = (fflush(fd) == 0) && (ftruncate(fileno(fd), (record[0] << 16) | (record[1] << 8) | record[2]) == 0);
+            break;
+        }
+        if(fread(record + 3, 1, 2, fp) != 2) {
+            errno = EBADMSG;
+            ret = false;
+            break;
+        }
+        u32 count = (record[3] << 8) | record[4];
+        if(count > 0) {
+            ret = (fread(buffer, 1, count, fp) == count);
+        } else { // RLE record
+            u8 rle[3];
+            ret = (fread(rle, 1, 3, fp) == 3);
+            count = (rle[0] << 8) | rle[1];
+            memFill(buffer, count, rle[2]);
+        }
+        if(!ret) {
+            errno = EBADMSG;
+            break;
+        }
+        if(offset > size) // records may start past the end of the file
+            ret = (fflush(fd) == 0) && (ftruncate(fileno(fd), offset) == 0);
+        ret = ret && (fseek(fd, offset, SEEK_SET) == 0);
+        ret = ret && (fwrite(buffer, 1, count, fd) == count);
+        if(offset + count > size) size = offset + count;
+    }
+
+    return (fclose(fd) == 0) && ret;
+}
+
+static bool patchApplyBPS(FILE* fp, u64 patchSize, const std::string patchPath, const std::string sourcePath, const std::string destPath, u8* buffer, bool showProgress) {
+    // the patch and the source are checked up front, the target while it is written
+    u8 footer[12];
+    u32 crc;
+    bool ret = (patchSize >= 4 + 3 + 12);
+    ret = ret && (fseek(fp, patchSize - 12, SEEK_SET) == 0) && (fread(footer, 1, 12, fp) == 12);
+    ret = ret && patchCrcFile(fp, patchSize - 4, crc, buffer, patchPath, showProgress);
+    if(!ret) {
+        if(errno != ECANCELED) errno = EBADMSG;
+        return false;
+    }
+
+    u8 magic[4];
+    u64 sourceSize, targetSize, metaSize;
+    ret = (crc == patchReadU32LE(footer + 8)) && (fseek(fp, 0, SEEK_SET) == 0);
+    ret = ret && (fread(magic, 1, 4, fp) == 4) && (memcmp(magic, "BPS1", 4) == 0);
+    ret = ret && patchReadNumber(fp, sourceSize) && patchReadNumber(fp, targetSize) && patchReadNumber(fp, metaSize);
+    ret = ret && (fseek(fp, metaSize, SEEK_CUR) == 0);
+    ret = ret && (sourceSize == fsGetFileSize(sourcePath)) && (targetSize <= 0xFFFFFFFF);
+    if(!ret) {
+        errno = EBADMSG;
+        return false;
+    }
+    u64 actionsEnd = patchSize - 12;
+    u64 actionsPos = ftell(fp);
+
+    FILE* fps = fopen(sourcePath.c_str(), "rb");
+    if(fps == NULL) return false;
+    ret = patchCrcFile(fps, sourceSize, crc, buffer, sourcePath, showProgress);
+    if(ret && (crc != patchReadU32LE(footer))) {
+        errno = EBADMSG;
+        ret = false;
+    }
+
+    PatchOutput out = { fopen(destPath.c_str(), "wb+"), (u8*) malloc( PATCH_BUFSIZ ), 0, 0, 0 };
+    ret = ret && (out.fp != NULL) && (out.buffer != NULL) && (fseek(fp, actionsPos, SEEK_SET) == 0);
+    s64 sourceRelative = 0;
+    s64 targetRelative = 0;
+    u64 lastProgress = (u64) -1;
+    while(ret && ((u64) ftell(fp) < actionsEnd)) {
+        u64 outPos = out.flushed + out.fill;
+        if(showProgress && ((outPos >> 16) != lastProgress)) {
+            lastProgress = outPos >> 16;
+            if(!fsShowProgress("Patching", destPath, outPos, targetSize + 1)) {
+                errno = ECANCELED;
+                ret = false;
+                break;
+            }
+        }
+        u64 data, offset;
+        if(!patchReadNumber(fp, data)) {
+            errno = EBADMSG;
+            ret = false;
+            break;
+        }
+        u32 command = data & 3;
+        u64 length = (data >> 2) + 1;
+        if(outPos + length > targetSize) {
+            errno = EBADMSG;
+            ret = false;
+            break;
+        }
+        switch(command) {
+            case BPS_SOURCE_READ:
+                ret = (outPos + length <= sourceSize) && patchCopyFrom(out, fps, outPos, length, buffer);
+                break;
+            case BPS_TARGET_READ:
+                for (u64 pos = 0; ret && (pos < length); ) {
+                    u32 l_size = (length - pos < PATCH_BUFSIZ) ? length - pos : PATCH_BUFSIZ;
+                    ret = (fread(buffer, 1, l_size, fp) == l_size) && patchWrite(out, buffer, l_size);
+                    pos += l_size;
+                }
+                break;
+            case BPS_SOURCE_COPY:
+                ret = patchReadNumber(fp, offset);
+                sourceRelative += (offset & 1) ? -(s64) (offset >> 1) : (s64) (offset >> 1);
+                ret = ret && (sourceRelative >= 0) && ((u64) sourceRelative + length <= sourceSize);
+                ret = ret && patchCopyFrom(out, fps, sourceRelative, length, buffer);
+                sourceRelative += length;
+                break;
+            case BPS_TARGET_COPY:
+                ret = patchReadNumber(fp, offset);
+                targetRelative += (offset & 1) ? -(s64) (offset >> 1) : (s64) (offset >> 1);
+                ret = ret && (targetRelative >= 0) && ((u64) targetRelative < outPos);
+                for (u64 pos = targetRelative, end = targetRelative + length; ret && (pos < end); ) {
+                    if(pos >= out.flushed) { // still in the buffer, may overlap what is written (RLE)
+                        u8 byte = out.buffer[pos - out.flushed];
+                        ret = patchWrite(out, &byte, 1);
+                        pos++;
+                    } else { // read back what was already written
+                        u64 l_size = out.flushed - pos;
+                        if(l_size > end - pos) l_size = end - pos;
+                        if(l_size > PATCH_BUFSIZ) l_size = PATCH_BUFSIZ;
+                        ret = (fseek(out.fp, pos, SEEK_SET) == 0) && (fread(buffer, 1, l_size, out.fp) == l_size);
+                        ret = ret && patchWrite(out, buffer, l_size);
+                        pos += l_size;
+                    }
+                }
+                targetRelative += length;
+                break;
+        }
+        if(!ret && (errno != ECANCELED)) errno = EBADMSG;
+    }
+    if(ret && (!patchFlush(out) || (out.flushed != targetSize) || (out.crc != patchReadU32LE(footer + 4)))) {
+        errno = EBADMSG;
+        ret = false;
+    }
+
+    if(out.buffer != NULL) free(out.buffer);
+    if(out.fp != NULL) ret = (fclose(out.fp) == 0) && ret;
+    fclose(fps);
+
+    return ret;
+}
+
+bool patchApply(const std::string patchPath, const std::string sourcePath, const std::string destPath, bool showProgress) {
+    PatchType type = patchGetType(patchPath);
+    if(type == P_UNKNOWN) {
+        errno = ENOTSUP;
+        return false;
+    }
+    if(fsExists(destPath)) {
+        errno = EEXIST;
+        return false;
+    }
+
+    bool ret = true;
+    u64 patchSize = fsGetFileSize(patchPath);
+    u8* buffer = (u8*) malloc( PATCH_BUFSIZ );
+    FILE* fp = fopen(patchPath.c_str(), "rb");
+    if((fp != NULL) && (buffer != NULL)) {
+        setvbuf(fp, NULL, _IOFBF, PATCH_BUFSIZ);
+        if(type == P_IPS) {
+            ret = fsPathCopy(sourcePath, destPath, false, showProgress) && patchApplyIPS(fp, patchSize, destPath, buffer, showProgress);
+        } else ret = patchApplyBPS(fp, patchSize, patchPath, sourcePath, destPath, buffer, showProgress);
+    } else ret = false;
+
+    if(buffer != NULL) free(buffer);
+    if(fp != NULL) fclose(fp);
+    if(!ret && fsExists(destPath)) {
+        int err = errno;
+        remove(destPath.c_str());
+        errno = err;
+    }
+
+    return ret;
+}
+
+// IPS records are collected in memory (max 64KiB each) and split into RLE runs when written
+typedef struct {
+    u32 offset;
+    u32 size;
+    u8* data;
+} PatchRecord;
+
+static bool patchFlushRecordIPS(PatchOutput &out, PatchRecord &record) {
+    bool ret = true;
+    u32 start = 0;
+    for (u32 pos = 0; ret && (pos <= record.size); ) {
+        u32 run = 0;
+        if(pos < record.size)
+            for (run = 1; (pos + run < record.size) && (record.data[pos + run] == record.data[pos]); run++);
+        bool rle = (run >= IPS_MIN_RLE) && (record.offset + pos != IPS_EOF) && (record.offset + pos + run != IPS_EOF);
+        if(rle || (pos == record.size)) {
+            if(pos > start) {
+                ret = ret && patchWriteU24BE(out, record.offset + start) && patchWriteU16BE(out, pos - start);
+                ret = ret && patchWrite(out, record.data + start, pos - start);
+            }
+            if(rle) {
+                ret = ret && patchWriteU24BE(out, record.offset + pos) && patchWriteU16BE(out, 0);
+                ret = ret && patchWriteU16BE(out, run) && patchWrite(out, record.data + pos, 1);
+            }
+            start = pos + run;
+        }
+        pos += (run > 0) ? run : 1;
+    }
+    record.size = 0;
+    return ret;
+}
+
+bool patchCreate(const std::string sourcePath, const std::string targetPath, const std::string patchPath, PatchType type, bool showProgress) {
+    // linear diff, target data is compared against source data at the same offset
+    u64 sourceSize = fsGetFileSize(sourcePath);
+    u64 targetSize = fsGetFileSize(targetPath);
+    u64 total = (sourceSize > targetSize) ? sourceSize : targetSize;
+    if(((type == P_IPS) && ((targetSize > IPS_MAX_OFFSET) || (sourceSize > IPS_MAX_OFFSET))) || (type == P_UNKNOWN)) {
+        errno = ENOTSUP;
+        return false;
+    }
+    if(fsExists(patchPath)) {
+        errno = EEXIST;
+        return false;
+    }
+
+    bool ret = true;
+    u8* buffer0 = (u8*) malloc( PATCH_BUFSIZ );
+    u8* buffer1 = (u8*) malloc( PATCH_BUFSIZ );
+    u8* pending = (u8*) malloc( PATCH_BUFSIZ ); // IPS record data / BPS TargetRead data
+    FILE* fp0 = fopen(sourcePath.c_str(), "rb");
+    FILE* fp1 = fopen(targetPath.c_str(), "rb");
+    PatchOutput out = { fopen(patchPath.c_str(), "wb"), (u8*) malloc( PATCH_BUFSIZ ), 0, 0, 0 };
+    if((fp0 != NULL) && (fp1 != NULL) && (out.fp != NULL) && (buffer0 != NULL) && (buffer1 != NULL) && (pending != NULL) && (out.buffer != NULL)) {
+        PatchRecord record = { 0, 0, pending };
+        u32 sourceCrc = 0;
+        u32 targetCrc = 0;
+        u64 targetRelative = 0;
+        u64 outPos = 0; // BPS output position of the pending action
+        u32 command = BPS_SOURCE_READ;
+        u64 length = 0;
+        u8 prevByte = 0;
+
+        auto emitBPS = [&]() -> bool {
+            if(length == 0) return true;
+            bool ok = patchWriteNumber(out, ((length - 1) << 2) | command);
+            if(command == BPS_TARGET_READ) ok = ok && patchWrite(out, pending, length);
+            outPos += length;
+            length = 0;
+            return ok;
+        };
+        auto addBPS = [&](u32 cmd, const u8* data, u32 size) -> bool {
+            bool ok = true;
+            if((cmd != command) || ((cmd == BPS_TARGET_READ) && (length + size > PATCH_BUFSIZ))) {
+                ok = emitBPS();
+                command = cmd;
+            }
+            if(cmd == BPS_TARGET_READ) memcpy(pending + length, data, size);
+            length += size;
+            return ok;
+        };
+        auto addIPS = [&](u32 offset, const u8* data, u32 size, u8 before) -> bool {
+            bool ok = true;
+            while(ok && (size > 0)) {
+                if((record.size > 0) && ((record.offset + record.size != offset) || (record.size == IPS_MAX_RECORD)))
+                    ok = patchFlushRecordIPS(out, record);
+                if(record.size == 0) {
+                    record.offset = offset;
+                    if(offset == IPS_EOF) { // start one byte earlier instead
+                        record.offset--;
+                        pending[record.size++] = before;
+                    }
+                }
+                u32 l_size = (size < IPS_MAX_RECORD - record.size) ? size : IPS_MAX_RECORD - record.size;
+                memcpy(pending + record.size, data, l_size);
+                record.size += l_size;
+                before = data[l_size - 1];
+                offset += l_size;
+                data += l_size;
+                size -= l_size;
+            }
+            return ok;
+        };
+
+        if(type == P_IPS) ret = patchWrite(out, (const u8*) "PATCH", 5);
+        else ret = patchWrite(out, (const u8*) "BPS1", 4) && patchWriteNumber(out, sourceSize) &&
+            patchWriteNumber(out, targetSize) && patchWriteNumber(out, 0);
+        for (u64 pos = 0; ret && (pos < total); pos += PATCH_BUFSIZ) {
+            if(showProgress && !fsShowProgress("Creating patch", patchPath, pos, total)) {
+                errno = ECANCELED;
+                ret = false;
+                break;
+            }
+            u32 size0 = (pos >= sourceSize) ? 0 : (sourceSize - pos < PATCH_BUFSIZ) ? sourceSize - pos : PATCH_BUFSIZ;
+            u32 size1 = (pos >= targetSize) ? 0 : (targetSize - pos < PATCH_BUFSIZ) ? targetSize - pos : PATCH_BUFSIZ;
+            ret = (fread(buffer0, 1, size0, fp0) == size0) && (fread(buffer1, 1, size1, fp1) == size1);
+            if(!ret) break;
+            sourceCrc = memCrc32(sourceCrc, buffer0, size0);
+            targetCrc = memCrc32(targetCrc, buffer1, size1);
+
+            u32 common = (size0 < size1) ? size0 : size1;
+            for (u32 p = 0; ret && (p < size1); ) {
+                // equal run first, then the differing run behind it
+                u32 equal = (p < common) ? memMismatch(buffer0 + p, buffer1 + p, common - p) : 0;
+                if(equal == (u32) -1) equal = common - p;
+                if(type == P_BPS) {
+                    bool fold = (command == BPS_TARGET_READ) && (equal < 3) && (p + equal < size1);
+                    if(equal) ret = addBPS(fold ? BPS_TARGET_READ : BPS_SOURCE_READ, buffer1 + p, equal);
+                } else if((equal <= 5) && (record.size > 0) && (record.offset + record.size == pos + p) && (p + equal < size1)) {
+                    // bridging a short gap is cheaper than starting a new record
+                    ret = addIPS(pos + p, buffer1 + p, equal, (p > 0) ? buffer1[p - 1] : prevByte);
+                }
+                p += equal;
+                u32 start = p;
+                for (; (p < size1) && ((p >= common) || (buffer0[p] != buffer1[p])); p++);
+                if(p == start) continue;
+                if(type == P_IPS) {
+                    ret = ret && addIPS(pos + start, buffer1 + start, p - start, (start > 0) ? buffer1[start - 1] : prevByte);
+                    continue;
+                }
+                for (u32 q = start; ret && (q < p); ) { // repeated bytes become a TargetCopy of the previous byte
+                    u32 run = 1;
+                    for (; (q + run < p) && (buffer1[q + run] == buffer1[q]); run++);
+                    if(run < 8) {
+                        ret = addBPS(BPS_TARGET_READ, buffer1 + q, run);
+                    } else {
+                        ret = addBPS(BPS_TARGET_READ, buffer1 + q, 1) && emitBPS();
+                        u64 relative = outPos - 1;
+                        s64 delta = (s64) relative - (s64) targetRelative;
+                        ret = ret && patchWriteNumber(out, ((u64) (run - 2) << 2) | BPS_TARGET_COPY);
+                        ret = ret && patchWriteNumber(out, (delta < 0) ? ((u64) -delta << 1) | 1 : (u64) delta << 1);
+                        targetRelative = relative + run - 1;
+                        outPos += run - 1;
+                    }
+                    q += run;
+                }
+            }
+            if(size1 > 0) prevByte = buffer1[size1 - 1];
+        }
+
+        if(type == P_IPS) {
+            ret = ret && ((record.size == 0) || patchFlushRecordIPS(out, record));
+            ret = ret && patchWrite(out, (const u8*) "EOF", 3);
+            if(targetSize < sourceSize) ret = ret && patchWriteU24BE(out, targetSize);
+        } else {
+            ret = ret && emitBPS() && patchWriteU32LE(out, sourceCrc) && patchWriteU32LE(out, targetCrc);
+            ret = ret && patchFlush(out) && patchWriteU32LE(out, out.crc);
+        }
+        ret = ret && patchFlush(out);
+    } else ret = false;
+
+    if(buffer0 != NULL) free(buffer0);
+    if(buffer1 != NULL) free(buffer1);
+    if(pending != NULL) free(pending);
+    if(out.buffer != NULL) free(out.buffer);
+    if(fp0 != NULL) fclose(fp0);
+    if(fp1 != NULL) fclose(fp1);
+    if(out.fp != NULL) ret = (fclose(out.fp) == 0) && ret;
+    if(!ret && fsExists(patchPath)) {
+        int err = errno;
+        remove(patchPath.c_str());
+        errno = err;
+    }
+
+    return ret;
+}
@@ -0,0 +1,21 @@
+#ifndef __CTRX_PATCH_HPP__
+#define __CTRX_PATCH_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+
+typedef enum {
+    P_UNKNOWN,
+    P_IPS,
+    P_BPS
+} PatchType;
+
+// patch data is streamed through small buffers, files are never loaded as a whole
+// functions return false and set errno on failure, EBADMSG for broken patches / checksum mismatches
+
+PatchType patchGetType(const std::string path);
+bool patchApply(const std::string patchPath, const std::string sourcePath, const std::string destPath, bool showProgress = false);
+bool patchCreate(const std::string sourcePath, const std::string targetPath, const std::string patchPath, PatchType type, bool showProgress = false);
+
+#endif
@@ -0,0 +1,90 @@
+#include "prof.hpp"
+
+#include <3ds.h>
+
+#include <malloc.h>
+
+#if defined CTRX_PROFILE
+
+#define PROF_TICKS_PER_US 268 // ARM11 system tick is 268MHz
+
+typedef struct {
+    u64 frameMin;
+    u64 frameMax;
+    u64 frameSum;
+    u32 nFrames;
+    u64 counters[P_COUNTERS];
+} ProfWindow;
+
+static ProfWindow current = { (u64) -1, 0, 0, 0, { 0 } };
+static ProfWindow shown = { 0, 0, 0, 0, { 0 } };
+static u64 lastFrame = 0;
+
+// the reader and index threads count too, their adds are atomic and go here first,
+// profFrame() moves them into the current window on the main thread (one frame's worth fits in 32 bit)
+static u32 pending[P_COUNTERS] = { 0 };
+
+u64 profTicks() {
+    return svcGetSystemTick();
+}
+
+void profAdd(ProfCounter counter, u64 value) {
+    __atomic_fetch_add(&pending[counter], (u32) value, __ATOMIC_RELAXED);
+}
+
+void profFrame() {
+    for (u32 i = 0; i < P_COUNTERS; i++)
+        current.counters[i] += __atomic_exchange_n(&pending[i], 0, __ATOMIC_RELAXED);
+
+    u64 now = profTicks();
+    if(lastFrame != 0) {
+        u64 frame = now - lastFrame;
+        if(frame < current.frameMin) current.frameMin = frame;
+        if(frame > current.frameMax) current.frameMax = frame;
+        current.frameSum += frame;
+        if(++current.nFrames >= PROF_WINDOW) {
+            shown = current;
+            current = (ProfWindow) { (u64) -1, 0, 0, 0, { 0 } };
+        }
+    }
+
+    lastFrame = now;
+}
+
+static void profTime(FmtBuffer &buf, u64 ticks) {
+    u64 us = ticks / PROF_TICKS_PER_US;
+    fmtDec(buf, us / 1000, 3);
+    fmtChar(buf, '.');
+    fmtDec(buf, (us / 100) % 10);
+}
+
+void profFormat(FmtBuffer &buf) {
+    u32 nFrames = (shown.nFrames) ? shown.nFrames : 1;
+
+    fmtString(buf, "PROFILER (last ");
+    fmtDec(buf, shown.nFrames);
+    fmtString(buf, " frames)\n");
+    fmtString(buf, "frame ms min");
+    profTime(buf, shown.frameMin);
+    fmtString(buf, " avg");
+    profTime(buf, shown.frameSum / nFrames);
+    fmtString(buf, " max");
+    profTime(buf, shown.frameMax);
+    fmtString(buf, "\nper frame ms read");
+    profTime(buf, shown.counters[P_READ_TIME] / nFrames);
+    fmtString(buf, " render");
+    profTime(buf, shown.counters[P_RENDER_TIME] / nFrames);
+    fmtString(buf, "\nread ");
+    fmtBytes(buf, shown.counters[P_BYTES_READ]);
+    fmtString(buf, " / written ");
+    fmtBytes(buf, shown.counters[P_BYTES_WRITTEN]);
+    fmtString(buf, "\nopens ");
+    fmtDec(buf, shown.counters[P_OPENS]);
+    fmtString(buf, " / seeks ");
+    fmtDec(buf, shown.counters[P_SEEKS]);
+    fmtString(buf, "\nheap in use ");
+    fmtBytes(buf, mallinfo().uordblks);
+    fmtString(buf, "\n");
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __CTRX_PROF_HPP__
+#define __CTRX_PROF_HPP__
+
+#include "fmt.hpp"
+
+#include <citrus/types.hpp>
+
+// #define CTRX_PROFILE // frame time and I/O profiler, tap the touch screen to show it on the top screen
+
+#define PROF_WINDOW 60 // frames per published sample
+
+typedef enum {
+    P_READ_TIME, // ticks
+    P_RENDER_TIME, // ticks
+    P_BYTES_READ,
+    P_BYTES_WRITTEN,
+    P_OPENS,
+    P_SEEKS,
+    P_COUNTERS
+} ProfCounter;
+
+// instrumentation points, these compile to nothing without CTRX_PROFILE
+#if defined CTRX_PROFILE
+#define PROF_ADD(counter, value) profAdd(counter, value)
+#define PROF_START(timer) u64 timer = profTicks()
+#define PROF_STOP(timer, counter) profAdd(counter, profTicks() - timer)
+#define PROF_FRAME() profFrame()
+
+u64 profTicks();
+void profAdd(ProfCounter counter, u64 value);
+void profFrame();
+void profFormat(FmtBuffer &buf);
+#else
+#define PROF_ADD(counter, value)
+#define PROF_START(timer)
+#define PROF_STOP(timer, counter)
+#define PROF_FRAME()
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+#include "strings.hpp"
+#include "fs.hpp"
+
+#include <sys/errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+// records in the temporary file have a fixed size, a page is found with a single seek
+typedef struct {
+    u32 offset;
+    u32 length;
+    u32 wide;
+    char text[STRINGS_MAX_TEXT];
+} StringsRecord;
+
+typedef struct {
+    u32 start;
+    u32 length;
+    std::string text;
+} StringsRun;
+
+static bool stringsPrintable(u8 c) {
+    return ((c >= 0x20) && (c < 0x7F)) || (c == '\t');
+}
+
+bool stringsFind(const std::string path, u32 offset, u32 size, u32 minLength, StringsResult &result, bool showProgress) {
+    stringsClear(result);
+    result.path = path;
+    if(minLength < STRINGS_MIN_LENGTH) minLength = STRINGS_MIN_LENGTH;
+
+    FILE* fp = NULL;
+    bool failed = false;
+
+    // strings are written out in batches once there are too many to hold
+    auto spill = [&]() {
+        std::stable_sort(result.hits.begin(), result.hits.end(), [](const StringHit &a, const StringHit &b) { return a.offset < b.offset; });
+        if(fp == NULL) {
+            fsCreateDir(STRINGS_TEMP_DIR);
+            fp = fopen(STRINGS_TEMP_PATH, "wb");
+            if(fp == NULL) return false;
+            result.spilled = true;
+        }
+        for (std::vector<StringHit>::iterator it = result.hits.begin(); it != result.hits.end(); it++) {
+            StringsRecord record;
+            memset(&record, 0, sizeof(record));
+            record.offset = (*it).offset;
+            record.length = (*it).length;
+            record.wide = ((*it).wide) ? 1 : 0;
+            memcpy(record.text, (*it).text.data(), (*it).text.size());
+            if(fwrite(&record, 1, sizeof(record), fp) != sizeof(record)) return false;
+        }
+        result.hits.clear();
+        return true;
+    };
+
+    auto finishRun = [&](StringsRun &run, bool wide) {
+        if(run.length >= minLength) {
+            result.hits.push_back({run.start, run.length, wide, run.text});
+            result.count++;
+            if((result.hits.size() >= ((result.spilled) ? STRINGS_PAGE : STRINGS_MAX_MEMORY)) && !spill()) failed = true;
+        }
+        run.length = 0;
+        run.text.clear();
+    };
+
+    // a UTF-16LE char ends at every byte, the two alignments are separate runs
+    StringsRun ascii = { 0, 0, "" };
+    StringsRun wide[2] = { { 0, 0, "" }, { 0, 0, "" } };
+    u32 pos = offset;
+    u8 prev = 0x00;
+    bool ret = fsDataStream(path, offset, size, "Extracting", [&](const u8* data, u32 l_size) {
+            for (u32 i = 0; i < l_size; i++, pos++) {
+                u8 c = data[i];
+                if(stringsPrintable(c)) {
+                    if(ascii.length++ == 0) ascii.start = pos;
+                    if(ascii.text.size() < STRINGS_MAX_TEXT) ascii.text += (char) c;
+                } else if(ascii.length) finishRun(ascii, false);
+                if(pos > offset) {
+                    StringsRun &run = wide[pos & 1];
+                    if((c == 0x00) && stringsPrintable(prev)) {
+                        if(run.length++ == 0) run.start = pos - 1;
+                        if(run.text.size() < STRINGS_MAX_TEXT) run.text += (char) prev;
+                    } else if(run.length) finishRun(run, true);
+                }
+                prev = c;
+            }
+            return !failed;
+        }, showProgress);
+    if(ret) {
+        finishRun(ascii, false);
+        finishRun(wide[0], true);
+        finishRun(wide[1], true);
+        if(result.spilled && !failed && !result.hits.empty()) failed = !spill();
+        else std::stable_sort(result.hits.begin(), result.hits.end(), [](const StringHit &a, const StringHit &b) { return a.offset < b.offset; });
+        ret = !failed;
+    }
+
+    if((fp != NULL) && (fclose(fp) != 0)) ret = false;
+    if(!ret) {
+        int errnoPrev = errno;
+        stringsClear(result);
+        errno = errnoPrev;
+    }
+
+    return ret;
+}
+
+bool stringsGet(const StringsResult &result, u32 first, u32 count, std::vector<StringHit> &hits) {
+    hits.clear();
+    if(first >= result.count) return true;
+    if(count > result.count - first) count = result.count - first;
+    if(!result.spilled) {
+        hits.assign(result.hits.begin() + first, result.hits.begin() + first + count);
+        return true;
+    }
+
+    FILE* fp = fopen(STRINGS_TEMP_PATH, "rb");
+    if(fp == NULL) return false;
+    bool ret = (fseek(fp, first * sizeof(StringsRecord), SEEK_SET) == 0);
+    std::vector<StringsRecord> records(count);
+    if(ret && (fread(records.data(), sizeof(StringsRecord), count, fp) != count)) {
+        errno = EIO;
+        ret = false;
+    }
+    fclose(fp);
+    if(!ret) return false;
+
+    for (std::vector<StringsRecord>::iterator it = records.begin(); it != records.end(); it++) {
+        const StringsRecord &record = *it;
+        u32 textSize = 0;
+        while((textSize < STRINGS_MAX_TEXT) && record.text[textSize]) textSize++;
+        hits.push_back({record.offset, record.length, record.wide != 0, std::string(record.text, textSize)});
+    }
+
+    return true;
+}
+
+void stringsClear(StringsResult &result) {
+    if(result.spilled) remove(STRINGS_TEMP_PATH);
+    result.path.clear();
+    result.count = 0;
+    result.spilled = false;
+    result.hits.clear();
+}
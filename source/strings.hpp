@@ -0,0 +1,37 @@
+#ifndef __CTRX_STRINGS_HPP__
+#define __CTRX_STRINGS_HPP__
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define STRINGS_TEMP_DIR "sdmc:/ctrx"
+#define STRINGS_TEMP_PATH STRINGS_TEMP_DIR "/strings.tmp"
+#define STRINGS_MIN_LENGTH 2
+#define STRINGS_MAX_TEXT 60 // longer strings are cut, their length is still known
+#define STRINGS_MAX_MEMORY 16384 // more strings than this go to STRINGS_TEMP_PATH
+#define STRINGS_PAGE 1000 // strings per page of the list
+
+typedef struct {
+    u32 offset;
+    u32 length; // in characters
+    bool wide; // UTF-16LE
+    std::string text;
+} StringHit;
+
+typedef struct {
+    std::string path;
+    u32 count;
+    bool spilled; // all strings are in STRINGS_TEMP_PATH instead of hits
+    std::vector<StringHit> hits;
+} StringsResult;
+
+// finds runs of printable ASCII (including tab) and of UTF-16LE chars in the same range in a single pass
+// strings of at least minLength chars (STRINGS_MIN_LENGTH or more) are listed in file order
+// functions return false and set errno on failure or cancel (ECANCELED)
+bool stringsFind(const std::string path, u32 offset, u32 size, u32 minLength, StringsResult &result, bool showProgress = false);
+bool stringsGet(const StringsResult &result, u32 first, u32 count, std::vector<StringHit> &hits);
+void stringsClear(StringsResult &result); // also removes the temporary file
+
+#endif
@@ -0,0 +1,717 @@
+#include "text.hpp"
+#include "fs.hpp"
+#include "mem.hpp"
+#include "prof.hpp"
+
+#include <string.h>
+
+#include <cstdlib>
+#include <algorithm>
+
+// unicode code points of CP437 0x80 - 0xFF, the font uses this codepage
+static const u16 cp437[128] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+    0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+    0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+};
+
+// decoding position, data points into the block cache (or tmp for chars crossing a block border)
+// only valid as long as nothing else reads through the cache
+typedef struct {
+    u32 offset;
+    const u8* data;
+    u32 avail;
+    u8 tmp[4];
+} TextCursor;
+
+static u32 textUnitSize(const TextFile &text) {
+    return ((text.encoding == E_UTF16LE) || (text.encoding == E_UTF16BE)) ? 2 : 1;
+}
+
+static u32 textDecode(TextEncoding encoding, const u8* data, u32 avail, u32 &codepoint) {
+    // decodes one char, returns its size in bytes (at least 1)
+    if(encoding == E_RAW) {
+        codepoint = data[0];
+        return 1;
+    } else if(encoding == E_UTF8) {
+        static const u32 minCodepoint[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+        u8 lead = data[0];
+        u32 size = (lead < 0x80) ? 1 : ((lead & 0xE0) == 0xC0) ? 2 : ((lead & 0xF0) == 0xE0) ? 3 : ((lead & 0xF8) == 0xF0) ? 4 : 0;
+        codepoint = lead; // invalid sequences are shown byte by byte
+        if((size <= 1) || (size > avail)) return 1;
+        u32 cp = lead & (0x7F >> size);
+        for (u32 i = 1; i < size; i++) {
+            if((data[i] & 0xC0) != 0x80) return 1;
+            cp = (cp << 6) | (data[i] & 0x3F);
+        }
+        if((cp < minCodepoint[size]) || (cp > 0x10FFFF) || ((cp >= 0xD800) && (cp < 0xE000))) return 1;
+        codepoint = cp;
+        return size;
+    } else {
+        bool le = (encoding == E_UTF16LE);
+        codepoint = 0xFFFD;
+        if(avail < 2) return avail;
+        u32 unit = (le) ? data[0] | (data[1] << 8) : (data[0] << 8) | data[1];
+        if((unit < 0xD800) || (unit >= 0xE000)) codepoint = unit;
+        else if((unit < 0xDC00) && (avail >= 4)) {
+            u32 low = (le) ? data[2] | (data[3] << 8) : (data[2] << 8) | data[3];
+            if((low >= 0xDC00) && (low < 0xE000)) {
+                codepoint = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                return 4;
+            }
+        }
+        return 2;
+    }
+}
+
+static TextEncoding textDetect(const u8* data, u32 size, u32 &start) {
+    start = 0;
+    if((size >= 3) && (data[0] == 0xEF) && (data[1] == 0xBB) && (data[2] == 0xBF)) {
+        start = 3;
+        return E_UTF8;
+    } else if((size >= 2) && (data[0] == 0xFF) && (data[1] == 0xFE)) {
+        start = 2;
+        return E_UTF16LE;
+    } else if((size >= 2) && (data[0] == 0xFE) && (data[1] == 0xFF)) {
+        start = 2;
+        return E_UTF16BE;
+    }
+
+    // no BOM: UTF-16 with mostly latin text has every other byte zero
+    u32 units = size / 2;
+    u32 zeroEven = 0;
+    u32 zeroOdd = 0;
+    for (u32 i = 0; i < units * 2; i += 2) {
+        if(data[i] == 0) zeroEven++;
+        if(data[i + 1] == 0) zeroOdd++;
+    }
+    if((units >= 4) && (zeroOdd >= units / 2) && (zeroEven < units / 16)) return E_UTF16LE;
+    if((units >= 4) && (zeroEven >= units / 2) && (zeroOdd < units / 16)) return E_UTF16BE;
+
+    // UTF-8 if there are multibyte sequences and all of them are valid
+    u32 multibyte = 0;
+    for (u32 i = 0; i < size; ) {
+        if(data[i] < 0x80) {
+            i++;
+            continue;
+        }
+        u32 codepoint;
+        u32 n = textDecode(E_UTF8, data + i, size - i, codepoint);
+        if(n == 1) {
+            if(size - i < 4) break; // possibly cut off
+            return E_RAW;
+        }
+        multibyte++;
+        i += n;
+    }
+    return (multibyte) ? E_UTF8 : E_RAW;
+}
+
+static u32 textFindIn(const TextFile &text, const u8* data, u32 base, u32 size, u8 value) {
+    // first ASCII char value in data (base is the offset of data), returns the index of its unit
+    if(textUnitSize(text) == 1) return memFindByte(data, size, value);
+    bool le = (text.encoding == E_UTF16LE);
+    for (u32 p = 0; p < size; ) {
+        u32 q = memFindByte(data + p, size - p, value);
+        if(q == (u32) -1) break;
+        q += p;
+        if(le && !((base + q) & 1) && (q + 1 < size) && (data[q + 1] == 0)) return q;
+        if(!le && ((base + q) & 1) && (q > 0) && (data[q - 1] == 0)) return q - 1;
+        p = q + 1;
+    }
+    return (u32) -1;
+}
+
+static u32 textFindLastIn(const TextFile &text, const u8* data, u32 base, u32 size, u8 value) {
+    if(textUnitSize(text) == 1) return memFindLastByte(data, size, value);
+    bool le = (text.encoding == E_UTF16LE);
+    for (u32 e = size; e > 0; ) {
+        u32 q = memFindLastByte(data, e, value);
+        if(q == (u32) -1) break;
+        if(le && !((base + q) & 1) && (q + 1 < size) && (data[q + 1] == 0)) return q;
+        if(!le && ((base + q) & 1) && (q > 0) && (data[q - 1] == 0)) return q - 1;
+        e = q;
+    }
+    return (u32) -1;
+}
+
+static u32 textCountIn(const TextFile &text, const u8* data, u32 base, u32 size, u8 value) {
+    if(textUnitSize(text) == 1) return memCountByte(data, size, value);
+    u32 count = 0;
+    for (u32 p = 0; p < size; ) {
+        u32 q = textFindIn(text, data + p, base + p, size - p, value);
+        if(q == (u32) -1) break;
+        count++;
+        p += q + 2;
+    }
+    return count;
+}
+
+static void textClampEnd(TextFile &text, u32 base, const u8* data, u32 size) {
+    // text ends at the first NUL char, found lazily in whatever gets read
+    u32 nul = (u32) -1;
+    if(textUnitSize(text) == 1) nul = memFindByte(data, size, '\0');
+    else for (u32 p = 0; p < size; ) {
+        u32 q = memFindByte(data + p, size - p, '\0');
+        if(q == (u32) -1) break;
+        q += p;
+        u32 unit = q - ((base + q - text.start) & 1);
+        if((unit != (u32) -1) && (unit + 1 < size) && (data[unit] == 0) && (data[unit + 1] == 0)) {
+            nul = unit;
+            break;
+        }
+        p = q + 1;
+    }
+    if((nul != (u32) -1) && (base + nul < text.size))
+        text.size = base + nul;
+}
+
+bool textOpen(TextFile &text, const std::string path) {
+    text.fp = fopen(path.c_str(), "rb");
+    PROF_ADD(P_OPENS, 1);
+    text.size = text.fileSize = fsGetFileSize(path);
+    text.cache = (u8*) malloc( TEXT_CACHE_BLOCKS * TEXT_BLOCK_SIZE );
+    text.indexBuffer = (u8*) malloc( TEXT_INDEX_BUFSIZ );
+    text.rangeBuffer = (u8*) malloc( TEXT_RANGE_BUFSIZ );
+    for (u32 i = 0; i < TEXT_CACHE_BLOCKS; i++)
+        text.blocks[i] = { (u32) -1, 0, 0 };
+    for (u32 i = 0; i < TEXT_COLUMN_LINES; i++) {
+        text.columns[i].lineStart = (u32) -1;
+        text.columns[i].lastUse = 0;
+    }
+    text.useCounter = 0;
+    if((text.fp == NULL) || (text.cache == NULL) || (text.indexBuffer == NULL) || (text.rangeBuffer == NULL)) {
+        textClose(text);
+        return false;
+    }
+
+    u32 size = fread(text.indexBuffer, 1, TEXT_DETECT_SIZE, text.fp);
+    text.encoding = textDetect(text.indexBuffer, size, text.start);
+    if(text.start > text.size) text.start = text.size;
+    text.checkpoints.clear();
+    text.checkpoints.push_back({ text.start, 0 });
+    text.indexedOffset = text.start;
+    text.indexedLines = 0;
+    return true;
+}
+
+bool textRefresh(TextFile &text) {
+    // picks up data appended to the file, only the new data gets read and indexed later on
+    if(fseek(text.fp, 0, SEEK_END) != 0) return false;
+    long pos = ftell(text.fp);
+    if((pos < 0) || ((u32) pos == text.fileSize)) return false;
+    u32 sizePrev = text.size;
+    if((u32) pos < text.fileSize) { // truncated, start over
+        for (u32 i = 0; i < TEXT_CACHE_BLOCKS; i++)
+            text.blocks[i].offset = (u32) -1;
+        for (u32 i = 0; i < TEXT_COLUMN_LINES; i++)
+            text.columns[i].lineStart = (u32) -1;
+        text.size = pos;
+        if(text.start > text.size) text.start = text.size;
+        text.checkpoints.clear();
+        text.checkpoints.push_back({ text.start, 0 });
+        text.indexedOffset = text.start;
+        text.indexedLines = 0;
+        text.fileSize = pos;
+        return true;
+    }
+    // the cached block holding the old end is incomplete
+    for (u32 i = 0; i < TEXT_CACHE_BLOCKS; i++)
+        if((text.blocks[i].offset != (u32) -1) && (text.blocks[i].size < TEXT_BLOCK_SIZE)) text.blocks[i].offset = (u32) -1;
+    if(text.size == text.fileSize) text.size = pos; // text doesn't end at a NUL char so far
+    text.fileSize = pos;
+    return text.size != sizePrev;
+}
+
+void textClose(TextFile &text) {
+    if(text.fp != NULL) fclose(text.fp);
+    if(text.cache != NULL) free(text.cache);
+    if(text.indexBuffer != NULL) free(text.indexBuffer);
+    if(text.rangeBuffer != NULL) free(text.rangeBuffer);
+    text.fp = NULL;
+    text.cache = NULL;
+    text.indexBuffer = NULL;
+    text.rangeBuffer = NULL;
+    text.checkpoints.clear();
+}
+
+static const u8* textGetBlock(TextFile &text, u32 offset, u32 &avail) {
+    // returns a pointer to the data at offset, valid for avail bytes
+    if(offset >= text.size) return NULL;
+    u32 blockOffset = offset - (offset % TEXT_BLOCK_SIZE);
+    u32 slot = 0;
+    for (u32 i = 0; i < TEXT_CACHE_BLOCKS; i++) {
+        if(text.blocks[i].offset == blockOffset) {
+            slot = i;
+            break;
+        } else if(text.blocks[i].lastUse < text.blocks[slot].lastUse) slot = i;
+    }
+    TextBlock &block = text.blocks[slot];
+    u8* data = text.cache + (slot * TEXT_BLOCK_SIZE);
+    if(block.offset != blockOffset) {
+        PROF_START(readStart);
+        PROF_ADD(P_SEEKS, 1);
+        block.offset = (u32) -1;
+        if(fseek(text.fp, blockOffset, SEEK_SET) != 0) return NULL;
+        block.size = fread(data, 1, TEXT_BLOCK_SIZE, text.fp);
+        PROF_ADD(P_BYTES_READ, block.size);
+        PROF_STOP(readStart, P_READ_TIME);
+        block.offset = blockOffset;
+        textClampEnd(text, blockOffset, data, block.size);
+    }
+    block.lastUse = ++text.useCounter;
+    u32 end = (blockOffset + block.size < text.size) ? blockOffset + block.size : text.size;
+    if(offset >= end) return NULL;
+    avail = end - offset;
+    return data + (offset - blockOffset);
+}
+
+u32 textRead(TextFile &text, u32 offset, u8* data, u32 size) {
+    u32 pos = 0;
+    while(pos < size) {
+        u32 avail;
+        const u8* block = textGetBlock(text, offset + pos, avail);
+        if(block == NULL) break;
+        if(avail > size - pos) avail = size - pos;
+        memcpy(data + pos, block, avail);
+        pos += avail;
+    }
+    return pos;
+}
+
+static bool textCursorNext(TextFile &text, TextCursor &cursor, u32 &codepoint) {
+    if(cursor.offset >= text.size) return false;
+    if(cursor.avail < 4) {
+        cursor.data = textGetBlock(text, cursor.offset, cursor.avail);
+        if(cursor.data == NULL) return false;
+        if((cursor.avail < 4) && (cursor.offset + cursor.avail < text.size)) {
+            cursor.avail = textRead(text, cursor.offset, cursor.tmp, 4);
+            cursor.data = cursor.tmp;
+        }
+    }
+    u32 size = textDecode(text.encoding, cursor.data, cursor.avail, codepoint);
+    cursor.offset += size;
+    cursor.data += size;
+    cursor.avail -= size;
+    return true;
+}
+
+static u32 textFindChar(TextFile &text, u32 offset, u32 end, u8 value) {
+    // first char value in [offset, end), (u32) -1 if not found
+    for (u32 pos = offset; pos < end; ) {
+        u32 avail;
+        const u8* block = textGetBlock(text, pos, avail);
+        if(block == NULL) break;
+        if(avail > end - pos) avail = end - pos;
+        u32 found = textFindIn(text, block, pos, avail, value);
+        if(found != (u32) -1) return pos + found;
+        pos += avail;
+    }
+    return (u32) -1;
+}
+
+static u32 textFindLastChar(TextFile &text, u32 offset, u32 end, u8 value) {
+    // last char value in [offset, end), (u32) -1 if not found
+    for (u32 pos = end; pos > offset; ) {
+        u32 start = pos - 1 - ((pos - 1) % TEXT_BLOCK_SIZE);
+        if(start < offset) start = offset;
+        u32 avail;
+        const u8* block = textGetBlock(text, start, avail);
+        if(block == NULL) break;
+        u32 found = textFindLastIn(text, block, start, pos - start, value);
+        if(found != (u32) -1) return start + found;
+        pos = start;
+    }
+    return (u32) -1;
+}
+
+bool textIndexStep(TextFile &text, u32 maxBytes) {
+    const u32 unit = textUnitSize(text);
+    for (u32 done = 0; (done < maxBytes) && (text.indexedOffset < text.size); ) {
+        u32 base = text.indexedOffset;
+        u32 size = (text.size - base < TEXT_INDEX_BUFSIZ) ? text.size - base : TEXT_INDEX_BUFSIZ;
+        const u8* data = text.indexBuffer;
+        PROF_START(readStart);
+        PROF_ADD(P_SEEKS, 1);
+        PROF_ADD(P_BYTES_READ, size);
+        if((fseek(text.fp, base, SEEK_SET) != 0) || (fread(text.indexBuffer, 1, size, text.fp) != size))
+            return false;
+        PROF_STOP(readStart, P_READ_TIME);
+        textClampEnd(text, base, data, size);
+        if(text.size < base + size) size = text.size - base;
+        for (u32 p = 0; p < size; ) {
+            // next checkpoint after TEXT_CHECKPOINT_LINES lines or TEXT_CHECKPOINT_BYTES, whatever comes first
+            TextCheckpoint last = text.checkpoints.back();
+            u32 limit = (last.offset + TEXT_CHECKPOINT_BYTES - base < size) ? last.offset + TEXT_CHECKPOINT_BYTES - base : size;
+            u32 need = TEXT_CHECKPOINT_LINES - (text.indexedLines - last.line);
+            u32 count = textCountIn(text, data + p, base + p, limit - p, '\n');
+            if(count < need) {
+                text.indexedLines += count;
+                p = limit;
+                if(base + p == last.offset + TEXT_CHECKPOINT_BYTES)
+                    text.checkpoints.push_back({ base + p, text.indexedLines });
+            } else {
+                for (u32 i = 0; i < need; i++)
+                    p += textFindIn(text, data + p, base + p, limit - p, '\n') + unit;
+                text.indexedLines += need;
+                text.checkpoints.push_back({ base + p, text.indexedLines });
+            }
+        }
+        text.indexedOffset = base + size;
+        done += size;
+    }
+    return true;
+}
+
+bool textIndexDone(const TextFile &text) {
+    return text.indexedOffset >= text.size;
+}
+
+static u32 textChunkBreak(TextFile &text, u32 boundary) {
+    // lines longer than a chunk are broken at chunk boundaries when wrapping, so wrapping
+    // never has to start more than two chunks back; returns the break at boundary, (u32) -1 if there is none
+    if((boundary < text.start + TEXT_LINE_CHUNK) || (boundary >= text.size)) return (u32) -1;
+    u32 pos = boundary;
+    u8 data[4];
+    if(text.encoding == E_UTF8) { // move on to the start of a char
+        u32 size = textRead(text, boundary, data, 3);
+        for (u32 i = 0; (i < size) && ((data[i] & 0xC0) == 0x80); i++) pos++;
+    } else if((text.encoding == E_UTF16LE) || (text.encoding == E_UTF16BE)) { // don't split surrogate pairs
+        u32 high;
+        u32 low;
+        if(textRead(text, boundary - 2, data, 4) == 4) {
+            high = (text.encoding == E_UTF16LE) ? data[0] | (data[1] << 8) : (data[0] << 8) | data[1];
+            low = (text.encoding == E_UTF16LE) ? data[2] | (data[3] << 8) : (data[2] << 8) | data[3];
+            if((high >= 0xD800) && (high < 0xDC00) && (low >= 0xDC00) && (low < 0xE000)) pos += 2;
+        }
+    }
+    if((pos >= text.size) || (textFindLastChar(text, boundary - TEXT_LINE_CHUNK, pos, '\n') != (u32) -1)) return (u32) -1;
+    return pos;
+}
+
+u32 textLineStart(TextFile &text, u32 offset) {
+    // start of the line containing offset, long lines are found through the line index
+    const u32 unit = textUnitSize(text);
+    if(unit == 2) offset &= ~1;
+    if(offset <= text.start) return text.start;
+    u32 from = (offset > text.start + TEXT_LINE_CHUNK) ? offset - TEXT_LINE_CHUNK : text.start;
+    u32 lf = textFindLastChar(text, from, offset, '\n');
+    if(lf != (u32) -1) return lf + unit;
+    if(from == text.start) return text.start;
+    // only the part that is not indexed yet gets searched
+    u32 indexed = (offset < text.indexedOffset) ? offset : text.indexedOffset;
+    if(from > indexed) {
+        lf = textFindLastChar(text, indexed, from, '\n');
+        if(lf != (u32) -1) return lf + unit;
+    }
+    return textLineOffset(text, textLineNumber(text, indexed));
+}
+
+u32 textLineNext(TextFile &text, u32 offset, u32 width) {
+    // start of the next line when lines are wrapped after width chars
+    const u32 unit = textUnitSize(text);
+    if(offset >= text.size) return text.size;
+    if(width == TEXT_NO_WRAP) {
+        u32 limit = (text.size - offset > TEXT_LINE_CHUNK) ? offset + TEXT_LINE_CHUNK : text.size;
+        u32 lf = textFindChar(text, offset, limit, '\n');
+        if(lf != (u32) -1) return lf + unit;
+        if(limit == text.size) return text.size;
+        // long line: close to the indexed part, index on demand so the line is only read once
+        if(offset < text.indexedOffset + TEXT_CHECKPOINT_BYTES) {
+            bool indexed = true;
+            while(indexed && !textIndexDone(text) && (text.indexedOffset <= offset))
+                indexed = textIndexStep(text, TEXT_INDEX_BUFSIZ);
+            u32 line = (indexed) ? textLineNumber(text, offset) : (u32) -1;
+            while(indexed && !textIndexDone(text) && (line + 1 > text.indexedLines))
+                indexed = textIndexStep(text, TEXT_INDEX_BUFSIZ);
+            if(indexed) return (line + 1 <= text.indexedLines) ? textLineOffset(text, line + 1) : text.size;
+        }
+        lf = textFindChar(text, limit, text.size, '\n');
+        return (lf != (u32) -1) ? lf + unit : text.size;
+    }
+    
+    // the next chunk break, if it is within reach
+    u32 boundary = offset - (offset % TEXT_LINE_CHUNK);
+    u32 brk = (offset - boundary < 4) ? textChunkBreak(text, boundary) : (u32) -1;
+    if((brk == (u32) -1) || (brk <= offset)) {
+        boundary += TEXT_LINE_CHUNK;
+        brk = (boundary - offset <= 4 * (width + 1)) ? textChunkBreak(text, boundary) : (u32) -1;
+    }
+    u32 end = (brk != (u32) -1) ? brk : text.size;
+    
+    if(text.encoding == E_RAW) { // one byte per char, search directly
+        u32 limit = (offset + width + 1 < end) ? offset + width + 1 : end;
+        u32 lf = textFindChar(text, offset, limit, '\n');
+        if(lf != (u32) -1) return lf + 1;
+        if(end - offset <= width) return end;
+        // wrap at the last space, forced wrap if there is none
+        u32 space = textFindLastChar(text, offset + 1, offset + width, ' ');
+        return (space == (u32) -1) ? offset + width : space;
+    }
+
+    TextCursor cursor = { offset, NULL, 0, { 0 } };
+    u32 space = (u32) -1;
+    for (u32 n = 0; ; n++) {
+        u32 pos = cursor.offset;
+        u32 codepoint;
+        if(pos == end) return end;
+        if(!textCursorNext(text, cursor, codepoint)) return text.size;
+        if(codepoint == '\n') return cursor.offset;
+        if(n == width) return (space == (u32) -1) ? pos : space;
+        if((codepoint == ' ') && (n > 0)) space = pos;
+    }
+}
+
+u32 textLineAlign(TextFile &text, u32 offset, u32 width) {
+    // start of the wrapped line containing offset
+    if(offset >= text.size) offset = (text.size > text.start) ? text.size - 1 : text.start;
+    if(textUnitSize(text) == 2) offset &= ~1;
+    if(width == TEXT_NO_WRAP) return textLineStart(text, offset);
+    // wrapping starts over after a line break or a chunk break, there is one within two chunks
+    u32 boundary = offset - (offset % TEXT_LINE_CHUNK);
+    u32 lower = (boundary >= text.start + 2 * TEXT_LINE_CHUNK) ? boundary - 2 * TEXT_LINE_CHUNK : text.start;
+    u32 lf = (offset > lower) ? textFindLastChar(text, lower, offset, '\n') : (u32) -1;
+    u32 start = (lf != (u32) -1) ? lf + textUnitSize(text) : lower;
+    for (u32 b = (boundary >= TEXT_LINE_CHUNK) ? boundary - TEXT_LINE_CHUNK : boundary; b <= boundary; b += TEXT_LINE_CHUNK) {
+        u32 brk = textChunkBreak(text, b);
+        if((brk != (u32) -1) && (brk <= offset) && (brk > start)) start = brk;
+    }
+    for (u32 next = textLineNext(text, start, width); (next <= offset) && (next < text.size); next = textLineNext(text, start, width))
+        start = next;
+    return start;
+}
+
+u32 textLineOffset(TextFile &text, u32 line) {
+    // start of a line, (u32) -1 if it is not indexed yet
+    if(line == 0) return text.start;
+    if(line > text.indexedLines) return (u32) -1;
+    std::vector<TextCheckpoint>::iterator it = std::lower_bound(text.checkpoints.begin(), text.checkpoints.end(), line,
+        [](const TextCheckpoint &cp, u32 line) { return cp.line < line; });
+    u32 pos = (*(it - 1)).offset;
+    for (u32 l = (*(it - 1)).line; l < line; l++) {
+        u32 lf = textFindChar(text, pos, text.size, '\n');
+        if(lf == (u32) -1) return (u32) -1;
+        pos = lf + textUnitSize(text);
+    }
+    return pos;
+}
+
+u32 textLineNumber(TextFile &text, u32 offset) {
+    // line containing offset, (u32) -1 if it is not indexed yet
+    if(offset > text.indexedOffset) return (u32) -1;
+    if(offset <= text.start) return 0;
+    std::vector<TextCheckpoint>::iterator it = std::upper_bound(text.checkpoints.begin(), text.checkpoints.end(), offset,
+        [](u32 offset, const TextCheckpoint &cp) { return offset < cp.offset; });
+    u32 line = (*(it - 1)).line;
+    for (u32 pos = (*(it - 1)).offset; pos < offset; ) {
+        u32 avail;
+        const u8* block = textGetBlock(text, pos, avail);
+        if(block == NULL) break;
+        if(avail > offset - pos) avail = offset - pos;
+        line += textCountIn(text, block, pos, avail, '\n');
+        pos += avail;
+    }
+    return line;
+}
+
+u32 textColumnOffset(TextFile &text, u32 lineStart, u32 end, u32 column) {
+    // offset of char #column of the line at lineStart (at most end), long lines keep a sparse column index
+    if(end > text.size) end = text.size;
+    if(text.encoding == E_RAW) return (column < end - lineStart) ? lineStart + column : end;
+    if(column < TEXT_COLUMN_STEP) {
+        TextCursor cursor = { lineStart, NULL, 0, { 0 } };
+        u32 codepoint;
+        for (u32 n = 0; (n < column) && (cursor.offset < end) && textCursorNext(text, cursor, codepoint); n++);
+        return (cursor.offset < end) ? cursor.offset : end;
+    }
+    u32 slot = 0;
+    for (u32 i = 0; i < TEXT_COLUMN_LINES; i++) {
+        if(text.columns[i].lineStart == lineStart) {
+            slot = i;
+            break;
+        } else if(text.columns[i].lastUse < text.columns[slot].lastUse) slot = i;
+    }
+    TextColumns &columns = text.columns[slot];
+    if((columns.lineStart != lineStart) || columns.offsets.empty()) {
+        columns.lineStart = lineStart;
+        columns.offsets.assign(1, lineStart);
+    }
+    columns.lastUse = ++text.useCounter;
+    // extend the column index as far as needed, then walk the rest
+    TextCursor cursor = { columns.offsets.back(), NULL, 0, { 0 } };
+    u32 codepoint;
+    while((columns.offsets.size() <= column / TEXT_COLUMN_STEP) && (cursor.offset < end)) {
+        u32 n = 0;
+        for (; (n < TEXT_COLUMN_STEP) && (cursor.offset < end) && textCursorNext(text, cursor, codepoint); n++);
+        if(n < TEXT_COLUMN_STEP) return end;
+        columns.offsets.push_back(cursor.offset);
+    }
+    if(columns.offsets.size() <= column / TEXT_COLUMN_STEP) return end;
+    cursor = { columns.offsets.at(column / TEXT_COLUMN_STEP), NULL, 0, { 0 } };
+    for (u32 n = 0; (n < column % TEXT_COLUMN_STEP) && (cursor.offset < end) && textCursorNext(text, cursor, codepoint); n++);
+    return (cursor.offset < end) ? cursor.offset : end;
+}
+
+u32 textGetGlyphs(TextFile &text, u32 offset, u32 end, FmtBuffer &glyphs, u32 maxGlyphs) {
+    // appends the glyphs of up to maxGlyphs chars in [offset, end), line breaks are left out
+    // returns the offset after the last char
+    if(end > text.size) end = text.size;
+    if(text.encoding == E_RAW) {
+        u32 pos = offset;
+        for (u32 count = 0; (pos < end) && (count < maxGlyphs); ) {
+            u32 avail;
+            const u8* block = textGetBlock(text, pos, avail);
+            if(block == NULL) break;
+            if(avail > end - pos) avail = end - pos;
+            if(avail > maxGlyphs - count) avail = maxGlyphs - count;
+            for (u32 i = 0; i < avail; i++)
+                if((block[i] != '\n') && (block[i] != '\r')) fmtChar(glyphs, (char) block[i]);
+            pos += avail;
+            count += avail;
+        }
+        return pos;
+    }
+
+    TextCursor cursor = { offset, NULL, 0, { 0 } };
+    u32 codepoint;
+    for (u32 count = 0; (count < maxGlyphs) && (cursor.offset < end) && textCursorNext(text, cursor, codepoint); count++)
+        if((codepoint != '\n') && (codepoint != '\r') && (codepoint != 0xFEFF)) fmtChar(glyphs, textGlyph(codepoint));
+    return (cursor.offset < end) ? cursor.offset : end;
+}
+
+char textGlyph(u32 codepoint) {
+    // code point -> font glyph, anything outside of CP437 is shown as '?'
+    static struct {
+        u32 codepoint;
+        char glyph;
+    } cache[256];
+    if(codepoint < 0x80) return (char) codepoint;
+    u32 slot = (codepoint ^ (codepoint >> 8)) & 0xFF;
+    if(cache[slot].codepoint != codepoint) {
+        const u16* found = (codepoint <= 0xFFFF) ? std::find(cp437, cp437 + 128, (u16) codepoint) : cp437 + 128;
+        cache[slot].codepoint = codepoint;
+        cache[slot].glyph = (found != cp437 + 128) ? (char) (0x80 + (found - cp437)) : '?';
+    }
+    return cache[slot].glyph;
+}
+
+u32 textCharCount(TextFile &text, u32 offset, u32 end) {
+    // number of chars in [offset, end)
+    if(end > text.size) end = text.size;
+    if(offset >= end) return 0;
+    if(text.encoding == E_RAW) return end - offset;
+    TextCursor cursor = { offset, NULL, 0, { 0 } };
+    u32 count = 0;
+    for (u32 codepoint; (cursor.offset < end) && textCursorNext(text, cursor, codepoint); count++);
+    return count;
+}
+
+static u8 textLower(u8 c) {
+    return ((c >= 'A') && (c <= 'Z')) ? c + ('a' - 'A') : c;
+}
+
+static bool textIsWordChar(TextFile &text, const u8* data, u32 base, u32 size, u32 offset) {
+    // non-ASCII chars count as word chars
+    u32 unit = textUnitSize(text);
+    u8 bytes[2];
+    if((offset < text.start) || (offset + unit < offset) || (offset + unit > text.size)) return false;
+    if((offset >= base) && (offset + unit <= base + size)) memcpy(bytes, data + (offset - base), unit);
+    else if(textRead(text, offset, bytes, unit) != unit) return false;
+    u8 c = (unit == 1) ? bytes[0] : (text.encoding == E_UTF16LE) ? bytes[0] : bytes[1];
+    u8 high = (unit == 1) ? 0 : (text.encoding == E_UTF16LE) ? bytes[1] : bytes[0];
+    return (high != 0) || (c >= 0x80) || (c == '_') || ((c >= '0') && (c <= '9')) || ((textLower(c) >= 'a') && (textLower(c) <= 'z'));
+}
+
+static void textSearchIn(TextFile &text, const TextSearch &search, const u8* data, u32 base, u32 size, u32 maxStart, std::vector<u32> &hits) {
+    // hits starting in data[0, maxStart), data holds [base, base + size)
+    const u8* term = search.term.data();
+    const u32 termSize = search.term.size();
+    const u32 unit = textUnitSize(text);
+    if(!termSize || (size < termSize)) return;
+    if(maxStart > size - termSize + 1) maxStart = size - termSize + 1;
+    // case insensitive: look for both cases of the first char, then compare the rest
+    u32 anchor = (term[0] == 0) ? 1 : 0;
+    u8 anchors[2] = { term[anchor], (u8) (term[anchor] - (('a' <= term[anchor]) && (term[anchor] <= 'z') ? 'a' - 'A' : 0)) };
+    for (u32 p = 0; (p < maxStart) && (hits.size() < TEXT_SEARCH_MAX_HITS); ) {
+        u32 found = (search.ignoreCase) ? memFindAnyOf(data + p + anchor, maxStart - p, anchors, (anchors[0] == anchors[1]) ? 1 : 2) :
+            memFind(data + p, maxStart - p + termSize - 1, term, termSize);
+        if(found == (u32) -1) break;
+        const u8* match = data + p + found;
+        u32 pos = base + p + found;
+        p += found + 1;
+        if(search.ignoreCase) {
+            u32 i = 0;
+            for (; (i < termSize) && (textLower(match[i]) == term[i]); i++);
+            if(i < termSize) continue;
+        }
+        if((unit == 2) && ((pos - text.start) & 1)) continue;
+        // no char before the text start counts as a non-word char
+        if(search.wholeWord && (((pos >= text.start + unit) && textIsWordChar(text, data, base, size, pos - unit)) ||
+            textIsWordChar(text, data, base, size, pos + termSize))) continue;
+        hits.push_back(pos);
+    }
+}
+
+void textSearchStart(TextFile &text, TextSearch &search, const std::string term, bool ignoreCase, bool wholeWord) {
+    search.term.clear();
+    for (u32 i = 0; i < term.size(); i++) {
+        u8 c = (ignoreCase) ? textLower(term[i]) : term[i];
+        if(text.encoding == E_UTF16BE) search.term.push_back(0);
+        search.term.push_back(c);
+        if(text.encoding == E_UTF16LE) search.term.push_back(0);
+    }
+    search.nChars = term.size();
+    search.ignoreCase = ignoreCase;
+    search.wholeWord = wholeWord;
+    search.hits.clear();
+    search.searchedOffset = text.start;
+}
+
+bool textSearchStep(TextFile &text, TextSearch &search, u32 maxBytes) {
+    const u32 termSize = search.term.size();
+    for (u32 done = 0; (done < maxBytes) && !textSearchDone(text, search); ) {
+        // the index buffer is shared with textIndexStep(), neither keeps data between calls
+        u32 base = search.searchedOffset;
+        u32 size = (text.size - base < TEXT_INDEX_BUFSIZ) ? text.size - base : TEXT_INDEX_BUFSIZ;
+        PROF_START(readStart);
+        PROF_ADD(P_SEEKS, 1);
+        PROF_ADD(P_BYTES_READ, size);
+        if((fseek(text.fp, base, SEEK_SET) != 0) || (fread(text.indexBuffer, 1, size, text.fp) != size))
+            return false;
+        PROF_STOP(readStart, P_READ_TIME);
+        textClampEnd(text, base, text.indexBuffer, size);
+        if(text.size < base + size) size = text.size - base;
+        while(!search.hits.empty() && (search.hits.back() + termSize > text.size)) search.hits.pop_back();
+        textSearchIn(text, search, text.indexBuffer, base, size, size, search.hits);
+        // matches may cross the end of the buffer (or the end of a growing file), continue with the first unchecked start
+        if(size >= termSize) search.searchedOffset = base + size - termSize + textUnitSize(text);
+        done += size;
+    }
+    return true;
+}
+
+bool textSearchDone(const TextFile &text, const TextSearch &search) {
+    return search.term.empty() || (search.hits.size() >= TEXT_SEARCH_MAX_HITS) || (search.searchedOffset + search.term.size() > text.size);
+}
+
+void textSearchRange(TextFile &text, const TextSearch &search, u32 offset, u32 end, std::vector<u32> &hits) {
+    // hits overlapping [offset, end), not added to the hit list
+    const u32 termSize = search.term.size();
+    if(!termSize || (offset >= end)) return;
+    u32 from = (offset >= text.start + termSize) ? offset - termSize + textUnitSize(text) : text.start;
+    u32 to = (end + termSize - 1 < text.size) ? end + termSize - 1 : text.size;
+    // in pieces of TEXT_RANGE_BUFSIZ, overlapping by termSize - 1 so no hit gets split
+    for (u32 base = from; (base < to) && (base < end); ) {
+        u32 size = (to - base < TEXT_RANGE_BUFSIZ) ? to - base : TEXT_RANGE_BUFSIZ;
+        u32 got = textRead(text, base, text.rangeBuffer, size);
+        if(got < termSize) break;
+        textSearchIn(text, search, text.rangeBuffer, base, got, end - base, hits);
+        if((got < size) || (base + got >= to)) break;
+        base += got - termSize + 1;
+    }
+}
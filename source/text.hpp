@@ -0,0 +1,103 @@
+#ifndef __CTRX_TEXT_HPP__
+#define __CTRX_TEXT_HPP__
+
+#include "fmt.hpp"
+
+#include <citrus/types.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#define TEXT_BLOCK_SIZE (16 * 1024)
+#define TEXT_CACHE_BLOCKS 16
+#define TEXT_INDEX_BUFSIZ (32 * 1024)
+#define TEXT_CHECKPOINT_LINES 512
+#define TEXT_CHECKPOINT_BYTES (64 * 1024)
+#define TEXT_DETECT_SIZE (4 * 1024)
+#define TEXT_RANGE_BUFSIZ (4 * 1024)
+#define TEXT_SEARCH_MAX_HITS 0x10000
+#define TEXT_LINE_CHUNK (4 * 1024)
+#define TEXT_COLUMN_STEP 1024
+#define TEXT_COLUMN_LINES 32
+#define TEXT_NO_WRAP ((u32) -1)
+
+typedef enum {
+    E_RAW, // one byte per char, shown as is (CP437)
+    E_UTF8,
+    E_UTF16LE,
+    E_UTF16BE
+} TextEncoding;
+
+typedef struct {
+    u32 offset;
+    u32 line; // line breaks before offset
+} TextCheckpoint;
+
+typedef struct {
+    u32 offset;
+    u32 size;
+    u32 lastUse;
+} TextBlock;
+
+// char offsets of one long line, one every TEXT_COLUMN_STEP chars
+typedef struct {
+    u32 lineStart;
+    std::vector<u32> offsets;
+    u32 lastUse;
+} TextColumns;
+
+// text file access through a small block cache plus a sparse line index
+// the index is built in steps (textIndexStep() returns false on read errors only),
+// checkpoints are never more than TEXT_CHECKPOINT_LINES lines or TEXT_CHECKPOINT_BYTES apart
+// offsets are byte offsets, widths and columns are counted in chars (code points)
+// with TEXT_NO_WRAP lines are never wrapped, otherwise lines longer than TEXT_LINE_CHUNK are also broken at chunk boundaries
+typedef struct {
+    FILE* fp;
+    TextEncoding encoding;
+    u32 start; // first char after the BOM
+    u32 size; // end of text, may shrink when a NUL char is found
+    u32 fileSize;
+    u8* cache;
+    TextBlock blocks[TEXT_CACHE_BLOCKS];
+    u32 useCounter;
+    u8* indexBuffer;
+    u8* rangeBuffer; // textSearchRange() reads the lines on screen in here
+    std::vector<TextCheckpoint> checkpoints;
+    u32 indexedOffset;
+    u32 indexedLines;
+    TextColumns columns[TEXT_COLUMN_LINES];
+} TextFile;
+
+// search for an ASCII term, hits are byte offsets sorted ascending
+// the hit list is complete up to searchedOffset and is capped at TEXT_SEARCH_MAX_HITS
+typedef struct {
+    std::vector<u8> term; // encoded like the text, lower case if ignoreCase
+    u32 nChars;
+    bool ignoreCase;
+    bool wholeWord;
+    std::vector<u32> hits;
+    u32 searchedOffset;
+} TextSearch;
+
+bool textOpen(TextFile &text, const std::string path);
+bool textRefresh(TextFile &text);
+void textClose(TextFile &text);
+u32 textRead(TextFile &text, u32 offset, u8* data, u32 size);
+bool textIndexStep(TextFile &text, u32 maxBytes);
+bool textIndexDone(const TextFile &text);
+u32 textLineStart(TextFile &text, u32 offset);
+u32 textLineNext(TextFile &text, u32 offset, u32 width);
+u32 textLineAlign(TextFile &text, u32 offset, u32 width);
+u32 textLineOffset(TextFile &text, u32 line);
+u32 textLineNumber(TextFile &text, u32 offset);
+u32 textColumnOffset(TextFile &text, u32 lineStart, u32 end, u32 column);
+u32 textGetGlyphs(TextFile &text, u32 offset, u32 end, FmtBuffer &glyphs, u32 maxGlyphs);
+char textGlyph(u32 codepoint);
+u32 textCharCount(TextFile &text, u32 offset, u32 end);
+void textSearchStart(TextFile &text, TextSearch &search, const std::string term, bool ignoreCase, bool wholeWord);
+bool textSearchStep(TextFile &text, TextSearch &search, u32 maxBytes);
+bool textSearchDone(const TextFile &text, const TextSearch &search);
+void textSearchRange(TextFile &text, const TextSearch &search, u32 offset, u32 end, std::vector<u32> &hits);
+
+#endif
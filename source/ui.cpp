@@ -1,5 +1,13 @@
 #include "ui.hpp"
+#include "batch.hpp"
+#include "entropy.hpp"
+#include "fmt.hpp"
 #include "fs.hpp"
+#include "magic.hpp"
+#include "mem.hpp"
+#include "prof.hpp"
+#include "text.hpp"
+#include "usage.hpp"
 
 #include <3ds.h>
 
@@ -9,6 +17,7 @@
 #include <citrus/hid.hpp>
 
 #include <sys/errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <algorithm>
@@ -26,46 +35,145 @@ struct uiAlphabetize {
     }
 };
 
-u32 selectorTexture;
-u32 selectorVbo;
+u32 batchTexture;
+u32 batchVbo;
+DrawBatch batch;
+std::vector<BatchString> batchStrings;
+
+// content hash of each screen's two framebuffers (0 = unknown), a screen is only redrawn if its back buffer is outdated
+u64 screenHashes[2][2];
+// state hash each framebuffer was drawn from (0 = unknown), see uiScreenCurrent()
+u64 screenStates[2][2];
+u64 screenPending[2];
+u32 backBuffer = 0;
+gpu::Screen currentScreen = gpu::SCREEN_TOP;
+gpu::Screen renderedScreen = gpu::SCREEN_TOP;
+u64 renderedHash = 0;
 
 void uiInit() {
-    gpu::createTexture(&selectorTexture);
-    gpu::setTextureInfo(selectorTexture, 64, 64, gpu::PIXEL_RGBA8, gpu::textureMinFilter(gpu::FILTER_NEAREST) | gpu::textureMagFilter(gpu::FILTER_NEAREST));
+    gpu::createTexture(&batchTexture);
+    gpu::setTextureInfo(batchTexture, 64, 64, gpu::PIXEL_RGBA8, gpu::textureMinFilter(gpu::FILTER_NEAREST) | gpu::textureMagFilter(gpu::FILTER_NEAREST));
 
     void* textureData;
-    gpu::getTextureData(selectorTexture, &textureData);
+    gpu::getTextureData(batchTexture, &textureData);
     memset(textureData, 0xFF, 64 * 64 * 4);
 
-    gpu::createVbo(&selectorVbo);
-    gpu::setVboAttributes(selectorVbo, gpu::vboAttribute(0, 3, gpu::ATTR_FLOAT) | gpu::vboAttribute(1, 2, gpu::ATTR_FLOAT) | gpu::vboAttribute(2, 4, gpu::ATTR_FLOAT), 3);
-
-    const float vboData[] = {
-            0.0f, 0.0f, -0.1f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-            320.0f, 0.0f, -0.1f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-            320.0f, 12.0f, -0.1f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-            320.0f, 12.0f, -0.1f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-            0.0f, 12.0f, -0.1f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-            0.0f, 0.0f, -0.1f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f,
-    };
-
-    gpu::setVboData(selectorVbo, vboData, 6 * 9, gpu::PRIM_TRIANGLES);
+    gpu::createVbo(&batchVbo);
+    gpu::setVboAttributes(batchVbo, gpu::vboAttribute(0, 3, gpu::ATTR_FLOAT) | gpu::vboAttribute(1, 2, gpu::ATTR_FLOAT) | gpu::vboAttribute(2, 4, gpu::ATTR_FLOAT), 3);
 }
 
 void uiCleanup() {
-    if(selectorTexture != 0) {
-        gpu::freeTexture(selectorTexture);
-        selectorTexture = 0;
+    if(batchTexture != 0) {
+        gpu::freeTexture(batchTexture);
+        batchTexture = 0;
     }
 
-    if(selectorVbo != 0) {
-        gpu::freeVbo(selectorVbo);
-        selectorVbo = 0;
+    if(batchVbo != 0) {
+        gpu::freeVbo(batchVbo);
+        batchVbo = 0;
     }
 }
 
 void uiDrawRectangle(int x, int y, u32 width, u32 height, u8 red, u8 green, u8 blue, u8 alpha) {
-    gput::drawString(std::string(1, 0xDB), x, y, width, height, red, green, blue, alpha);
+    batchRectangle(batch, x, y, width, height, red, green, blue, alpha);
+}
+
+void uiDrawString(const char* str, float x, float y, float charWidth, float charHeight, u8 red, u8 green, u8 blue, u8 alpha) {
+    batchString(batch, str, strlen(str), x, y, charWidth, charHeight, red, green, blue, alpha);
+}
+
+void uiDrawString(const std::string &str, float x, float y, float charWidth, float charHeight, u8 red, u8 green, u8 blue, u8 alpha) {
+    batchString(batch, str.data(), str.size(), x, y, charWidth, charHeight, red, green, blue, alpha);
+}
+
+void uiStartScreen(gpu::Screen screen) {
+    const u32 width = (screen == gpu::SCREEN_TOP) ? gpu::TOP_WIDTH : gpu::BOTTOM_WIDTH;
+    const u32 height = (screen == gpu::SCREEN_TOP) ? gpu::TOP_HEIGHT : gpu::BOTTOM_HEIGHT;
+    gpu::setViewport(screen, 0, 0, width, height);
+    gput::setOrtho(0, width, 0, height, -1, 1);
+
+    currentScreen = screen;
+    batchClear(batch);
+}
+
+void uiFlushBuffer() {
+    const u32 screen = (currentScreen == gpu::SCREEN_TOP) ? 0 : 1;
+    u64* bufferHash = &screenHashes[screen][backBuffer];
+    screenStates[screen][backBuffer] = screenPending[screen];
+    screenPending[screen] = 0;
+    if(*bufferHash == batch.hash) return;
+
+    PROF_START(renderStart);
+    if((renderedHash != batch.hash) || (renderedScreen != currentScreen)) {
+        gpu::clear();
+
+        // all rectangles in one draw on a plain white texture, then as few strings as possible
+        if(!batch.quads.empty()) {
+            gpu::setVboData(batchVbo, &batch.quads[0], batch.quads.size() / 9, gpu::PRIM_TRIANGLES);
+            gpu::bindTexture(gpu::TEXUNIT0, batchTexture);
+            gpu::drawVbo(batchVbo);
+        }
+
+        u32 nStrings = batchLayout(batch, batchStrings);
+        for(std::vector<BatchString>::iterator it = batchStrings.begin(); it != batchStrings.begin() + nStrings; it++) {
+            gput::drawString(it->str, it->x, it->y, it->charWidth, it->charHeight, it->color >> 24, it->color >> 16, it->color >> 8, it->color);
+        }
+
+        gpu::flushCommands();
+        renderedScreen = currentScreen;
+        renderedHash = batch.hash;
+    }
+
+    gpu::flushBuffer();
+    *bufferHash = batch.hash;
+    PROF_STOP(renderStart, P_RENDER_TIME);
+}
+
+void uiSwapBuffers(bool vblank) {
+    gpu::swapBuffers(vblank);
+    backBuffer ^= 1;
+    PROF_FRAME();
+}
+
+// screens drawn from a few known variables pass a hash of them, building the screen is skipped if the back buffer
+// was drawn from the same state, the next uiFlushBuffer() on that screen records the state for its buffer
+bool uiScreenCurrent(gpu::Screen screen, u64 state) {
+    const u32 index = (screen == gpu::SCREEN_TOP) ? 0 : 1;
+    if((state != 0) && (screenStates[index][backBuffer] == state)) return true;
+    screenPending[index] = state;
+    return false;
+}
+
+u64 uiHashState(u64 hash, u64 value) {
+    for(u32 i = 0; i < 8; i++, value >>= 8) {
+        hash = (hash ^ (value & 0xFF)) * 0x100000001B3ULL; // FNV-1a
+    }
+
+    return hash;
+}
+
+u64 uiHashState(u64 hash, const std::string &str) {
+    for(std::string::const_iterator it = str.begin(); it != str.end(); it++) {
+        hash = (hash ^ (u8) *it) * 0x100000001B3ULL;
+    }
+
+    return (hash ^ 0xFF) * 0x100000001B3ULL; // end marker, "ab" + "c" is not "a" + "bc"
+}
+
+// same as gput::getStringWidth() / getStringHeight(), without copying the string
+static u32 uiStringWidth(const char* str, u32 size, u32 charWidth) {
+    u32 width = 0;
+    u32 lineWidth = 0;
+    for(u32 i = 0; i < size; i++) {
+        if(str[i] == '\n') lineWidth = 0;
+        else if((lineWidth += charWidth) > width) width = lineWidth;
+    }
+
+    return width;
+}
+
+static u32 uiStringHeight(const char* str, u32 size, u32 charHeight) {
+    return (std::count(str, str + size, '\n') + 1) * charHeight;
 }
 
 void uiDrawPositionBar(u32 pos, u32 nShown, u32 total, bool use_bottom) {
@@ -108,18 +216,12 @@ std::string uiTruncateString(const std::string str, int nsize, int pos) {
 }
 
 std::string uiFormatBytes(u64 bytes) {
-    const char* units[] = {" byte", "kB", "MB", "GB"};
-    std::stringstream byteStr;
-    
-    if(bytes < 1024) byteStr << bytes << units[0];
-    else {
-        int scale = 1;
-        u64 bytes100 = (bytes * 100) >> 10;
-        for(; (bytes100 >= 1024*100) && (scale < 3); scale++, bytes100 >>= 10);
-        byteStr << (bytes100 / 100) << "." << ((bytes100 % 100) / 10) << (bytes100 % 10) << units[scale];
-    }
+    char str[32];
+    FmtBuffer buf;
+    fmtStart(buf, str, sizeof(str));
+    fmtBytes(buf, bytes);
     
-    return byteStr.str();
+    return std::string(str, buf.size);
 }
 
 bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement> elements, std::function<bool(std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty)> onLoop, std::function<void(SelectableElement* select)> onUpdateCursor, std::function<void(std::set<SelectableElement*>* marked)> onUpdateMarked, std::function<bool(SelectableElement* selected)> onSelect, bool useTopScreen, bool alphabetize) {
@@ -140,6 +242,7 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
     u64 lastScrollTime = 0;
     
     bool lastMarkedStatus = false;
+    u32 listVersion = 0; // changed marks or elements
 
     bool elementsDirty = false;
     bool resetCursorIfDirty = true;
@@ -169,6 +272,7 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
             lastMarkedStatus = inserted.second;
             selectionScroll = 0;
             selectionScrollEndTime = core::time() - 3000;
+            listVersion++;
             if(onUpdateMarked != NULL) onUpdateMarked(&markedElements);
         }
 
@@ -236,6 +340,7 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
                         std::pair <std::set<SelectableElement*>::iterator,bool> inserted = markedElements.insert(selected);
                         if(!lastMarkedStatus) markedElements.erase(inserted.first);
                     }                    
+                    listVersion++;
                     if(onUpdateMarked != NULL) onUpdateMarked(&markedElements);
                 }
 
@@ -248,59 +353,66 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
             lastScrollTime = 0;
         }
 
-        gpu::setViewport(gpu::SCREEN_BOTTOM, 0, 0, gpu::BOTTOM_WIDTH, gpu::BOTTOM_HEIGHT);
-        gput::setOrtho(0, gpu::BOTTOM_WIDTH, 0, gpu::BOTTOM_HEIGHT, -1, 1);
-        gpu::clear();
-
-        uiDrawPositionBar(scroll, 20, elements.size());
+        u32 screenWidth = gpu::BOTTOM_WIDTH;
+        u32 screenHeight = gpu::BOTTOM_HEIGHT;
         
-        u32 screenWidth;
-        u32 screenHeight;
-        gpu::getViewportWidth(&screenWidth);
-        gpu::getViewportHeight(&screenHeight);
-        for(std::vector<SelectableElement>::iterator it = elements.begin() + scroll; it != elements.begin() + scroll + 20 && it != elements.end(); it++) {
-            std::string name = (*it).name;
-            if (markedElements.find(&(*it)) != markedElements.end()) name.insert(0, 1, 0x10);
-            int index = it - elements.begin();
-            u8 cl = 0xFF;
-            int offset = 0;
-            float itemHeight = gput::getStringHeight(name, 8) + 4;
-            if(index == cursor) {
-                cl = 0x00;
-                uiDrawRectangle(0, (screenHeight - 1) - ((index - scroll + 1) * itemHeight), screenWidth, itemHeight);
-                u32 width = (u32) gput::getStringWidth(name, 8);
-                if(width > screenWidth) {
-                    if(selectionScrollEndTime == 0) {
-                        if(selectionScroll + screenWidth >= width) {
-                            selectionScrollEndTime = core::time();
-                        } else {
-                            selectionScroll++;
-                        }
-                    } else if(core::time() - selectionScrollEndTime >= 4000) {
-                        selectionScroll = 0;
-                        selectionScrollEndTime = 0;
+        // a selected name that does not fit is scrolled, then shown from the start again after a pause
+        if((cursor >= 0) && (cursor < (int) elements.size())) {
+            bool marked = (markedElements.find(&elements.at((u32) cursor)) != markedElements.end());
+            u32 width = (elements.at((u32) cursor).name.size() + ((marked) ? 1 : 0)) * 8;
+            if(width > screenWidth) {
+                if(selectionScrollEndTime == 0) {
+                    if(selectionScroll + screenWidth >= width) {
+                        selectionScrollEndTime = core::time();
+                    } else {
+                        selectionScroll++;
                     }
+                } else if(core::time() - selectionScrollEndTime >= 4000) {
+                    selectionScroll = 0;
+                    selectionScrollEndTime = 0;
                 }
-                offset = -selectionScroll;
             }
-            gput::drawString(name, offset, (screenHeight - 1) - ((index - scroll + 1) * itemHeight) + 2, 8, 8, cl, cl, cl);
         }
-
-        gpu::flushCommands();
-        gpu::flushBuffer();
+        
+        // the list is only built again when something it shows has changed
+        u64 listState = UI_STATE_INIT;
+        listState = uiHashState(listState, scroll);
+        listState = uiHashState(listState, cursor);
+        listState = uiHashState(listState, selectionScroll);
+        listState = uiHashState(listState, elements.size());
+        listState = uiHashState(listState, listVersion);
+        if(!uiScreenCurrent(gpu::SCREEN_BOTTOM, listState)) {
+            uiStartScreen(gpu::SCREEN_BOTTOM);
+            
+            uiDrawPositionBar(scroll, 20, elements.size());
+            
+            for(std::vector<SelectableElement>::iterator it = elements.begin() + scroll; it != elements.begin() + scroll + 20 && it != elements.end(); it++) {
+                const std::string &name = (*it).name;
+                bool marked = (markedElements.find(&(*it)) != markedElements.end());
+                int index = it - elements.begin();
+                u8 cl = 0xFF;
+                int offset = 0;
+                const u32 itemHeight = 8 + 4;
+                if(index == cursor) {
+                    cl = 0x00;
+                    uiDrawRectangle(0, (screenHeight - 1) - ((index - scroll + 1) * itemHeight), screenWidth, itemHeight);
+                    offset = -selectionScroll;
+                }
+                if(marked) uiDrawString("\x10", offset, (screenHeight - 1) - ((index - scroll + 1) * itemHeight) + 2, 8, 8, cl, cl, cl);
+                uiDrawString(name, offset + ((marked) ? 8 : 0), (screenHeight - 1) - ((index - scroll + 1) * itemHeight) + 2, 8, 8, cl, cl, cl);
+            }
+            
+            uiFlushBuffer();
+        }
         
         if(useTopScreen) {
-            gpu::setViewport(gpu::SCREEN_TOP, 0, 0, gpu::TOP_WIDTH, gpu::TOP_HEIGHT);
-            gput::setOrtho(0, gpu::TOP_WIDTH, 0, gpu::TOP_HEIGHT, -1, 1);
-            gpu::clear();
+            uiStartScreen(gpu::SCREEN_TOP);
 
             gpu::getViewportHeight(&screenHeight);
-            if((*selected).details.size() != 0) {
-                std::stringstream details;
-                for(std::vector<std::string>::iterator it = (*selected).details.begin(); it != (*selected).details.end(); it++) {
-                    details << *it << "\n";
-                }
-                gput::drawString(details.str(), 0, screenHeight - 1 - gput::getStringHeight(details.str(), 8), 8, 8);
+            u32 vpos = screenHeight - 1;
+            for(std::vector<std::string>::iterator it = (*selected).details.begin(); it != (*selected).details.end(); it++) {
+                vpos -= uiStringHeight(it->data(), it->size(), 8);
+                uiDrawString(*it, 0, vpos, 8, 8);
             }
         }
 
@@ -331,14 +443,14 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
             
             if (onUpdateCursor != NULL) onUpdateCursor((selected = &elements.at((u32) cursor)));
             markedElements.clear();
+            listVersion++;
         }
         
         if(useTopScreen) {
-            gpu::flushCommands();
-            gpu::flushBuffer();
+            uiFlushBuffer();
         }
 
-        gpu::swapBuffers(true);
+        uiSwapBuffers(true);
         
         if(result) {
             break;
@@ -348,6 +460,31 @@ bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement>
     return false;
 }
 
+int uiMenu(const std::string message, const std::vector<std::string> options) {
+    std::vector<SelectableElement> elements;
+    std::vector<std::string> details = { message, "", "Press A to select, B to cancel." };
+    for(u32 i = 0; i < options.size(); i++) {
+        std::stringstream id;
+        id << i;
+        elements.push_back({id.str(), options.at(i), details});
+    }
+
+    int result = -1;
+    uiSelectMultiple("", elements,
+        [&](std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty) {
+            return hid::pressed(hid::BUTTON_B);
+        },
+        NULL, NULL,
+        [&](SelectableElement* selected) {
+            result = atoi((*selected).id.c_str());
+            return true;
+        },
+        true, false);
+
+    hid::poll();
+    return result;
+}
+
 void uiGetDirContentsSorted(std::vector<SelectableElement> &elements, const std::string directory, bool isRoot) {
     elements.clear();
     if (!isRoot) elements.push_back({"..", ".."});
@@ -358,7 +495,9 @@ void uiGetDirContentsSorted(std::vector<SelectableElement> &elements, const std:
         const std::string path = (*it).path;
         std::vector<std::string> info = {};
         if((*it).isDirectory) {
+            UsageInfo usage;
             info.push_back("folder");
+            if(usageGet(path, usage)) info.push_back(uiFormatBytes(usage.size)); // only after a storage analysis
         } else {
             const std::string ext = uiTruncateString(fsGetExtension(name), 8, 3);
             info.push_back((ext.size() > 0) ? (ext + " file") : "file");
@@ -368,6 +507,14 @@ void uiGetDirContentsSorted(std::vector<SelectableElement> &elements, const std:
     }
 }
 
+// the extension based type of a file is replaced by its content based one once it is selected,
+// listing a folder reads no file, each file is only read when the cursor first reaches it
+static void uiDetectFileType(SelectableElement &element) {
+    std::string type;
+    if((element.details.size() < 2) || (element.details.front().compare("folder") == 0)) return;
+    if(magicDetect(element.id, type) && !type.empty()) element.details.front() = type;
+}
+
 bool uiFileBrowser(const std::string rootDirectory, const std::string startPath, std::function<bool(bool &updateList, bool &resetCursorOnUpdate)> onLoop, std::function<void(SelectableElement* entry)> onUpdateEntry, std::function<void(std::string* currDir)> onUpdateDir, std::function<void(std::set<SelectableElement*>* marked)> onUpdateMarked, std::function<bool(std::string selectedPath, bool &updateList)> onSelect, bool useTopScreen) {
     std::stack<std::string> directoryStack;
     std::string currDirectory = rootDirectory;
@@ -416,6 +563,7 @@ bool uiFileBrowser(const std::string rootDirectory, const std::string startPath,
             return false;
         },
         [&](SelectableElement* entry) {
+            uiDetectFileType(*entry);
             selected = entry;
             onUpdateEntry(entry);
         },
@@ -457,7 +605,7 @@ bool uiFileBrowser(const std::string rootDirectory, const std::string startPath,
     return result;
 }
 
-bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode)> onLoop, std::function<bool(u32 offset)> onUpdate, std::function<bool(u32 selectedOffset, u32 selectedLength, hid::Button selectButton, bool &updateData)> onSelect) {
+bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode, bool &updateData)> onLoop, std::function<bool(u32 offset)> onUpdate, std::function<bool(u32 selectedOffset, u32 selectedLength, hid::Button selectButton, bool &updateData)> onSelect) {
     const u32 cpad = 2;
     
     const u32 rows = gpu::BOTTOM_HEIGHT / (8 + (2*cpad));
@@ -491,23 +639,25 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
         
         if(data != NULL) localData = data;
         
-        gpu::setViewport(gpu::SCREEN_BOTTOM, 0, 0, gpu::BOTTOM_WIDTH, gpu::BOTTOM_HEIGHT);
-        gput::setOrtho(0, gpu::BOTTOM_WIDTH, 0, gpu::BOTTOM_HEIGHT, -1, 1);
-        gpu::clear();
+        uiStartScreen(gpu::SCREEN_BOTTOM);
         
         uiDrawPositionBar(currOffset, nShown, fileSize);
         
         for(u32 pos = 0; pos < nShown; ) {
             u32 vDrawPos = gpu::BOTTOM_HEIGHT - (((u32) (pos / cols) + 1) * (8 + (2*cpad))) + cpad;
             
-            std::stringstream ssIndex;
-            ssIndex << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << (currOffset + pos);
-            gput::drawString(ssIndex.str(), 0, vDrawPos, 8, 8, gr, gr, gr);
+            char strIndex[9];
+            FmtBuffer bufIndex;
+            fmtStart(bufIndex, strIndex, sizeof(strIndex));
+            fmtHex(bufIndex, currOffset + pos, 8);
+            uiDrawString(strIndex, 0, vDrawPos, 8, 8, gr, gr, gr);
             
             if(currOffset + pos < fileSize) {
-                std::stringstream ssAscii;
-                std::stringstream ssHex;
-                ssHex << std::hex << std::uppercase << std::setfill('0');
+                char strAscii[cols + 1];
+                char strHex[3];
+                FmtBuffer bufAscii;
+                FmtBuffer bufHex;
+                fmtStart(bufAscii, strAscii, sizeof(strAscii));
                 do {
                     if(currOffset + pos < fileSize) {
                         u32 hDrawPos = 64 + (32 - (cols * cpad)) + ((pos % cols) * 2 * (8 + cpad)) + cpad;
@@ -517,21 +667,20 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
                             uiDrawRectangle(gpu::BOTTOM_WIDTH - ((cols-(pos%cols))*8) - 1, vDrawPos - 1,
                                 2 + 8, 2 + 1 + 8, mr, mr, mr);
                         }
-                        ssHex << std::setw(2) << (u32) symbol;
-                        gput::drawString(ssHex.str(), hDrawPos, vDrawPos, 8, 8);
-                        ssHex.str("");
-                        ssAscii << (((symbol != 0x00) && (symbol != 0x0A) && (symbol != 0x0D)) ? (char) symbol : (char) ' ');
+                        fmtStart(bufHex, strHex, sizeof(strHex));
+                        fmtHex(bufHex, symbol, 2);
+                        uiDrawString(strHex, hDrawPos, vDrawPos, 8, 8);
+                        fmtChar(bufAscii, ((symbol != 0x00) && (symbol != 0x0A) && (symbol != 0x0D)) ? (char) symbol : (char) ' ');
                     }
                     pos++;
                 } while(pos % cols);
-                gput::drawString(ssAscii.str(), gpu::BOTTOM_WIDTH - (cols*8), vDrawPos, 8, 8, gr, gr, gr);
+                uiDrawString(strAscii, gpu::BOTTOM_WIDTH - (cols*8), vDrawPos, 8, 8, gr, gr, gr);
             } else pos += cols;
         }
         
-        gpu::flushCommands();
         for(int b = 0; b < 2; b++) { // fill both buffers
-            gpu::flushBuffer();
-            gpu::swapBuffers(true);
+            uiFlushBuffer();
+            uiSwapBuffers(true);
         }
         
         return false;
@@ -588,6 +737,10 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
                     selectOffset = markedOffset;
                     markedLength = 1;
                     selectButton = hid::BUTTON_R;
+                } else if(hid::pressed(hid::BUTTON_L)) {
+                    selectOffset = markedOffset;
+                    markedLength = 1;
+                    selectButton = hid::BUTTON_L;
                 } else if(hid::released(selectButton)) {
                     if(onSelect && onSelect(markedOffset, markedLength, selectButton, forceRefresh))
                         return true;
@@ -648,6 +801,9 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
                 if(markedOffset >= fileSize) markedOffset = fileSize - 1;
             }
             
+            if(onLoop && onLoop(offset, markedOffset, markedLength, selectMode, forceRefresh))
+                return true;
+            
             if(forceRefresh) {
                 fileSize = fsGetFileSize(path);
                 maxOffset = (fileSize <= nShown) ? 0 :
@@ -655,9 +811,6 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
                 if(offset > maxOffset) offset = maxOffset;
             }
             
-            if(onLoop && onLoop(offset, markedOffset, markedLength, selectMode))
-                return true;
-            
             if((markedOffset != markedOffsetPrev) || (markedLength != markedLengthPrev)) {
                 if(markedOffset + markedLength > fileSize) {
                     if(markedOffset < fileSize)
@@ -683,7 +836,7 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
                 currOffset = offset;
             }
             
-            gpu::swapBuffers(true);
+            uiSwapBuffers(true);
             
             return false;
         },
@@ -696,180 +849,726 @@ bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offs
     return result;
 }
 
-bool uiTextViewer(const std::string path, std::function<bool(void)> onLoop, std::function<bool(u32 offset, u32 plus)> onUpdate) {
+bool uiCompareViewer(const std::string path0, const std::string path1, u32 start, std::function<bool(u32 &offset, bool &forceRefresh)> onLoop, std::function<bool(u32 offset)> onUpdate) {
+    const u32 cpad = 2;
+
+    const u32 rows = gpu::BOTTOM_HEIGHT / (8 + (2*cpad));
+    const u32 cols = 4;
+    const u32 nShown = rows * cols;
+
+    const u32 fastMult = 16;
+
+    const u8 gr = 0x9F;
+    const u8 dr = 0x7F; // differences are marked red
+
+    bool result = false;
+
+    u32 fileSize0 = fsGetFileSize(path0);
+    u32 fileSize1 = fsGetFileSize(path1);
+    u32 fileSize = (fileSize0 > fileSize1) ? fileSize0 : fileSize1;
+    u64 lastScrollTime = 0;
+
+    u32 offset = start - (start % cols);
+    u32 offsetPrev = (u32) -1;
+    u32 maxOffset = (fileSize <= nShown) ? 0 :
+        ((fileSize % cols) ? fileSize + (cols - (fileSize % cols)) - nShown : fileSize - nShown);
+
+    std::vector<u8> data0(nShown);
+    std::vector<u8> data1(nShown);
+    FILE* fp0 = fopen(path0.c_str(), "rb");
+    FILE* fp1 = fopen(path1.c_str(), "rb");
+    if((fp0 == NULL) || (fp1 == NULL)) {
+        if(fp0 != NULL) fclose(fp0);
+        if(fp1 != NULL) fclose(fp1);
+        return false;
+    }
+
+    auto redrawCompareView = [&]() {
+        uiStartScreen(gpu::SCREEN_BOTTOM);
+
+        uiDrawPositionBar(offset, nShown, fileSize);
+
+        for(u32 pos = 0; pos < nShown; pos += cols) {
+            u32 vDrawPos = gpu::BOTTOM_HEIGHT - (((u32) (pos / cols) + 1) * (8 + (2*cpad))) + cpad;
+            if(offset + pos >= fileSize) break;
+
+            char strIndex[9];
+            FmtBuffer bufIndex;
+            fmtStart(bufIndex, strIndex, sizeof(strIndex));
+            fmtHex(bufIndex, offset + pos, 8);
+            uiDrawString(strIndex, 0, vDrawPos, 8, 8, gr, gr, gr);
+
+            char strAscii0[cols + 1];
+            char strAscii1[cols + 1];
+            char strHex[3];
+            FmtBuffer ascii0;
+            FmtBuffer ascii1;
+            FmtBuffer hex;
+            fmtStart(ascii0, strAscii0, sizeof(strAscii0));
+            fmtStart(ascii1, strAscii1, sizeof(strAscii1));
+            for(u32 c = 0; c < cols; c++) {
+                u32 p = pos + c;
+                bool in0 = (offset + p < fileSize0);
+                bool in1 = (offset + p < fileSize1);
+                if(!in0 && !in1) break;
+                u32 hDrawPos0 = 72 + (c * (8 + 8 + 2*cpad));
+                u32 hDrawPos1 = hDrawPos0 + 96;
+                if(!in0 || !in1 || (data0[p] != data1[p])) {
+                    uiDrawRectangle(hDrawPos0 - 1, vDrawPos - 1, 2 + (2*8), 2 + 1 + 8, dr, 0x00, 0x00);
+                    uiDrawRectangle(hDrawPos1 - 1, vDrawPos - 1, 2 + (2*8), 2 + 1 + 8, dr, 0x00, 0x00);
+                }
+                fmtStart(hex, strHex, sizeof(strHex));
+                if(in0) fmtHex(hex, data0[p], 2);
+                else fmtString(hex, "--");
+                uiDrawString(strHex, hDrawPos0, vDrawPos, 8, 8);
+                fmtStart(hex, strHex, sizeof(strHex));
+                if(in1) fmtHex(hex, data1[p], 2);
+                else fmtString(hex, "--");
+                uiDrawString(strHex, hDrawPos1, vDrawPos, 8, 8);
+                fmtChar(ascii0, (in0 && (data0[p] != 0x00) && (data0[p] != 0x0A) && (data0[p] != 0x0D)) ? (char) data0[p] : ' ');
+                fmtChar(ascii1, (in1 && (data1[p] != 0x00) && (data1[p] != 0x0A) && (data1[p] != 0x0D)) ? (char) data1[p] : ' ');
+            }
+            uiDrawString(strAscii0, gpu::BOTTOM_WIDTH - (2*cols*8), vDrawPos, 8, 8, gr, gr, gr);
+            uiDrawString(strAscii1, gpu::BOTTOM_WIDTH - (cols*8), vDrawPos, 8, 8, gr, gr, gr);
+        }
+
+        for(int b = 0; b < 2; b++) { // fill both buffers
+            uiFlushBuffer();
+            uiSwapBuffers(true);
+        }
+    };
+
+    while(core::running()) {
+        hid::poll();
+
+        if(hid::pressed(hid::BUTTON_B)) {
+            result = true;
+            break;
+        }
+        if(hid::held(hid::BUTTON_DOWN) || hid::held(hid::BUTTON_RIGHT)) {
+            if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
+                offset += (hid::held(hid::BUTTON_L)) ?
+                    (hid::held(hid::BUTTON_RIGHT) ? fastMult * fastMult * nShown : fastMult * nShown) :
+                    (hid::held(hid::BUTTON_RIGHT) ? nShown : cols);
+                if(offset > maxOffset) offset = maxOffset;
+                lastScrollTime = core::time();
+            }
+        } else if(hid::held(hid::BUTTON_UP) || hid::held(hid::BUTTON_LEFT)) {
+            if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
+                u32 sub = (hid::held(hid::BUTTON_L)) ?
+                    (hid::held(hid::BUTTON_LEFT) ? fastMult * fastMult * nShown : fastMult * nShown) :
+                    (hid::held(hid::BUTTON_LEFT) ? nShown : cols);
+                offset = (offset > sub) ? offset - sub : 0;
+                lastScrollTime = core::time();
+            }
+        } else if(lastScrollTime > 0) {
+            lastScrollTime = 0;
+        }
+
+        bool forceRefresh = false;
+        if(onLoop && onLoop(offset, forceRefresh)) {
+            result = true;
+            break;
+        }
+
+        if(offset > maxOffset) offset = maxOffset;
+        else offset -= offset % cols;
+
+        if((offset != offsetPrev) || forceRefresh) {
+            fseek(fp0, offset, SEEK_SET);
+            fseek(fp1, offset, SEEK_SET);
+            fread(data0.data(), 1, nShown, fp0);
+            fread(data1.data(), 1, nShown, fp1);
+            offsetPrev = offset;
+            if(onUpdate && onUpdate(offset)) {
+                result = true;
+                break;
+            }
+            redrawCompareView();
+        }
+
+        uiSwapBuffers(true);
+    }
+
+    fclose(fp0);
+    fclose(fp1);
+
+    return result;
+}
+
+static void uiEntropyColor(u8 entropy, u8 &red, u8 &green, u8 &blue) {
+    // dark blue (padding, sparse data) over green (code, text) and yellow to red (compressed, encrypted)
+    if(entropy < 64) {
+        red = green = 0x20 - (entropy / 2);
+        blue = 0x20 + (entropy * 3);
+    } else if(entropy < 128) {
+        red = 0x00;
+        green = (entropy - 64) * 4;
+        blue = 0xFF - ((entropy - 64) * 4);
+    } else if(entropy < 192) {
+        red = (entropy - 128) * 4;
+        green = 0xFF;
+        blue = 0x00;
+    } else {
+        red = 0xFF;
+        green = 0xFF - ((entropy - 192) * 4);
+        blue = 0x00;
+    }
+}
+
+void uiDrawEntropyStrip(const EntropyMap &map, u32 block, int x, int y, u32 width, u32 height) {
+    u32 nBlocks = map.entropy.size();
+    if(nBlocks == 0) return;
+    u32 columns = (nBlocks < width) ? nBlocks : width;
+    u32 colWidth = width / columns;
+    
+    // a column shows the highest entropy of its blocks, short encrypted parts stay visible
+    for(u32 c = 0; c < columns; c++) {
+        u32 first = ((u64) c * nBlocks) / columns;
+        u32 last = ((u64) (c + 1) * nBlocks) / columns;
+        u8 entropy = 0;
+        for(u32 b = first; b < last; b++) if(map.entropy[b] > entropy) entropy = map.entropy[b];
+        u8 red, green, blue;
+        uiEntropyColor(entropy, red, green, blue);
+        uiDrawRectangle(x + (c * colWidth), y, colWidth, height, red, green, blue);
+    }
+    
+    u32 marker = ((u64) block * columns * colWidth) / nBlocks;
+    uiDrawRectangle(x + marker, y - 4, (colWidth > 2) ? colWidth : 2, 3);
+}
+
+bool uiEntropyViewer(const EntropyMap &map, u32 start, std::function<bool(u32 &block, bool &forceRefresh)> onLoop, std::function<bool(u32 block)> onUpdate) {
+    const u32 rows = 14;
+    const u32 cols = 32;
+    const u32 nShown = rows * cols;
+    const u32 rowHeight = 10;
+    const u32 gridLeft = 62; // first cell, right of the offsets
+    const u32 histHeight = 72;
+    
+    const u32 fastMult = 16;
+    
+    const u8 gr = 0x9F;
+    
+    bool result = false;
+    
+    u32 nBlocks = map.entropy.size();
+    if(nBlocks == 0) {
+        errno = ENODATA;
+        return false;
+    }
+    u64 lastScrollTime = 0;
+    
+    u32 block = (start < nBlocks) ? start : nBlocks - 1;
+    u32 blockPrev = (u32) -1;
+    u32 firstRow = 0;
+    u32 histogram[256];
+    
+    auto redrawEntropyView = [&]() {
+        uiStartScreen(gpu::SCREEN_BOTTOM);
+        
+        uiDrawPositionBar(firstRow * cols, nShown, nBlocks);
+        
+        // block map, one cell per block
+        for(u32 r = 0; r < rows; r++) {
+            u32 rowBlock = (firstRow + r) * cols;
+            if(rowBlock >= nBlocks) break;
+            u32 vDrawPos = gpu::BOTTOM_HEIGHT - ((r + 1) * rowHeight) + 1;
+            
+            char strIndex[9];
+            FmtBuffer bufIndex;
+            fmtStart(bufIndex, strIndex, sizeof(strIndex));
+            fmtHex(bufIndex, map.offset + (rowBlock * map.blockSize), 8);
+            uiDrawString(strIndex, 0, vDrawPos, 8, 8, gr, gr, gr);
+            
+            for(u32 c = 0; (c < cols) && (rowBlock + c < nBlocks); c++) {
+                u32 hDrawPos = gridLeft + (c * 8);
+                u8 red, green, blue;
+                uiEntropyColor(map.entropy[rowBlock + c], red, green, blue);
+                if(rowBlock + c == block) uiDrawRectangle(hDrawPos - 1, vDrawPos - 1, 9, 10);
+                uiDrawRectangle(hDrawPos, vDrawPos, 7, 8, red, green, blue);
+            }
+        }
+        
+        // byte histogram of the selected block
+        u32 maxCount = 1;
+        for(u32 b = 0; b < 256; b++) if(histogram[b] > maxCount) maxCount = histogram[b];
+        for(u32 b = 0; b < 256; b++) {
+            if(histogram[b] == 0) continue;
+            u32 barHeight = ((u64) histogram[b] * histHeight) / maxCount;
+            uiDrawRectangle(32 + b, 12, 1, (barHeight) ? barHeight : 1, gr, gr, gr);
+        }
+        uiDrawString("00", 32, 2, 8, 8, gr, gr, gr);
+        uiDrawString("80", 32 + 128 - 8, 2, 8, 8, gr, gr, gr);
+        uiDrawString("FF", 32 + 256 - 16, 2, 8, 8, gr, gr, gr);
+        
+        for(int b = 0; b < 2; b++) { // fill both buffers
+            uiFlushBuffer();
+            uiSwapBuffers(true);
+        }
+    };
+    
+    while(core::running()) {
+        hid::poll();
+        
+        if(hid::pressed(hid::BUTTON_B)) {
+            result = true;
+            break;
+        }
+        if(hid::held(hid::BUTTON_DOWN) || hid::held(hid::BUTTON_RIGHT)) {
+            if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
+                u32 add = (hid::held(hid::BUTTON_L)) ?
+                    (hid::held(hid::BUTTON_RIGHT) ? fastMult * nShown : nShown) :
+                    (hid::held(hid::BUTTON_RIGHT) ? 1 : cols);
+                block = (block + add < nBlocks) ? block + add : nBlocks - 1;
+                lastScrollTime = core::time();
+            }
+        } else if(hid::held(hid::BUTTON_UP) || hid::held(hid::BUTTON_LEFT)) {
+            if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
+                u32 sub = (hid::held(hid::BUTTON_L)) ?
+                    (hid::held(hid::BUTTON_LEFT) ? fastMult * nShown : nShown) :
+                    (hid::held(hid::BUTTON_LEFT) ? 1 : cols);
+                block = (block > sub) ? block - sub : 0;
+                lastScrollTime = core::time();
+            }
+        } else if(lastScrollTime > 0) {
+            lastScrollTime = 0;
+        }
+        
+        // tapping a cell selects its block (touch coordinates start at the top left)
+        if(hid::pressed(hid::BUTTON_TOUCH)) {
+            hid::Touch touch = hid::touch();
+            u32 x = touch.x;
+            u32 r = touch.y / rowHeight;
+            if((x >= gridLeft) && (x < gridLeft + (cols * 8)) && (r < rows)) {
+                u32 tapped = ((firstRow + r) * cols) + ((x - gridLeft) / 8);
+                if(tapped < nBlocks) block = tapped;
+            }
+        }
+        
+        bool forceRefresh = false;
+        if(onLoop && onLoop(block, forceRefresh)) {
+            result = true;
+            break;
+        }
+        
+        if(block >= nBlocks) block = nBlocks - 1;
+        
+        if((block != blockPrev) || forceRefresh) {
+            u32 row = block / cols;
+            if(row < firstRow) firstRow = row;
+            else if(row >= firstRow + rows) firstRow = row - rows + 1;
+            // only the selected block is read again, the map itself holds no histograms
+            u32 blockOffset = block * map.blockSize;
+            u32 blockSize = (map.size - blockOffset < map.blockSize) ? map.size - blockOffset : map.blockSize;
+            if(!entropyHistogram(map.path, map.offset + blockOffset, blockSize, histogram))
+                memset(histogram, 0, sizeof(histogram));
+            blockPrev = block;
+            if(onUpdate && onUpdate(block)) {
+                result = true;
+                break;
+            }
+            redrawEntropyView();
+        }
+        
+        uiSwapBuffers(true);
+    }
+    
+    return result;
+}
+
+bool uiTextViewer(const std::string path, std::function<bool(void)> onLoop, std::function<bool(u32 offset, u32 plus, u32 line, u32 nLines, bool indexing, u32 hit, u32 nHits, bool searching, bool following)> onUpdate) {
+    const std::string alphabet = " ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789(){}[]<>/\\|*:;=+-_.'\"`^,~!@#$%&?";
     const u32 nLinesDisp = gpu::BOTTOM_HEIGHT / 8;
     const u32 nCharsDisp = gpu::BOTTOM_WIDTH / 8;
-    const u32 lineLenMax = 1 * 1024; // careful, this is a sensitive value
-    const u32 bufsizeMax = 16 * nLinesDisp * lineLenMax; // see above
-    const u32 safeSize = 2 * lineLenMax * nLinesDisp;
+    const u64 indexTime = 8; // time (ms) per frame spent on building the line index
+    const u64 searchTime = 4; // time (ms) per frame spent on searching
+    const u64 followDelay = 500; // time (ms) between file size checks in follow mode
+    const u64 tapDelay = 240;
+    const u8 hr = 0x4F;
+    const u8 cr = 0x8F;
     
-    u64 lastScrollTime = 0;
+    static std::string searchStr;
+    static bool ignoreCase = false;
+    static bool wholeWord = false;
     
-    u32 fileSize = fsDataSearch(path, std::vector<u8>(1, '\0'), 0, true);
-    if(fileSize == (u32) -1) fileSize = fsGetFileSize(path);
-    u32 bufsize = (fileSize < bufsizeMax) ? fileSize : bufsizeMax;
+    u64 lastScrollTime = 0;
+    u64 inputAHoldTime = 0;
+    u64 inputXHoldTime = 0;
+    u64 inputYHoldTime = 0;
     
-    std::vector<u32> bufferMap;
-    char* localData = NULL;
+    TextFile text;
+    if(!textOpen(text, path)) return false;
+    u32 textSizePrev = text.size;
+    bool indexFailed = false;
     
-    u32 offsetBuff = (u32) -1;
-    u32 offsetDisp = 0;
+    std::vector<u32> lineStarts(nLinesDisp + 1);
+    u32 offsetDisp = text.start; // start of the first line on screen
     u32 offsetDispPrev = (u32) -1;
+    u32 offsetLines = (u32) -1; // lineStarts are valid for this offset
     u32 charIndex = 0;
     u32 charIndexPrev = (u32) -1;
-    u32 lineIndex = 0;
-    u32 lineIndexMax = 0;
-    u32 lineLenCurr = lineLenMax;
-    
-    // MAP LINE OFFSETS IN BUFFER
-    auto buildBufferMap = [&](void) {
-        bufferMap.clear();
-        // build line offset list
-        u32 end = (offsetBuff + bufsize > fileSize) ? fileSize - offsetBuff : bufsize;
-        for (u32 start = 0; start < end;) {
-            u32 lf;
-            for (lf = start; (lf < end) && localData[lf] != '\n'; lf++);
-            while (lf - start > lineLenCurr) {
-                u32 space = (u32) -1;
-                for (u32 p = start + 1; (p < end) && p < start + lineLenCurr; p++)
-                    if(localData[p] == ' ') space = p;
-                if(space == (u32) -1) {
-                    // no appropriate space character found -> forced word wrap
-                    u32 forced = (start + lineLenCurr < end) ? start + lineLenCurr : end;
-                    start = forced;
-                } else start = space;
-                bufferMap.push_back(start);
+    u32 lineDisp = (u32) -1; // line number of offsetDisp, if known
+    u64 lastUpdateTime = 0;
+    bool indexingPrev = false;
+    u32 lineLenCurr = TEXT_NO_WRAP;
+    std::vector<u32> dispStarts(nLinesDisp); // offsets of the first char shown per line
+    u32 charIndexCols = (u32) -1; // dispStarts are valid for this charIndex
+    bool moreRight = false;
+    bool following = false;
+    bool followingPrev = false;
+    u64 lastFollowTime = 0;
+    
+    TextSearch search;
+    textSearchStart(text, search, "", false, false);
+    bool searchFailed = false;
+    std::vector<u32> lineHits; // hits on screen are found right away
+    u32 hitCurr = (u32) -1; // index of the last hit jumped to
+    u32 hitCurrPrev = (u32) -1;
+    u32 nHitsPrev = (u32) -1;
+    
+    // only the lines on screen are mapped, starting at offsetDisp
+    auto mapLines = [&](void) {
+        if(offsetLines == offsetDisp) return;
+        lineStarts.at(0) = offsetDisp;
+        for (u32 l = 0; l < nLinesDisp; l++)
+            lineStarts.at(l + 1) = textLineNext(text, lineStarts.at(l), lineLenCurr);
+        offsetLines = offsetDisp;
+        charIndexCols = (u32) -1;
+    };
+    
+    // long lines are never read further than the part on screen
+    auto mapColumns = [&](void) {
+        mapLines();
+        if(charIndexCols == charIndex) return;
+        for (u32 l = 0; l < nLinesDisp; l++)
+            dispStarts.at(l) = textColumnOffset(text, lineStarts.at(l), lineStarts.at(l + 1), charIndex);
+        charIndexCols = charIndex;
+    };
+    
+    // don't leave empty lines at the bottom of the screen if there is more text above
+    auto clampDisp = [&](void) {
+        mapLines();
+        u32 shown = 0;
+        for (; (shown < nLinesDisp) && (lineStarts.at(shown) < text.size); shown++);
+        for (; (shown < nLinesDisp) && (offsetDisp > text.start); shown++)
+            offsetDisp = textLineAlign(text, offsetDisp - 1, lineLenCurr);
+        mapLines();
+    };
+    
+    auto drawText = [&](bool bothBuffers) {
+        const u32 unit = ((text.encoding == E_UTF16LE) || (text.encoding == E_UTF16BE)) ? 2 : 1;
+        mapColumns();
+        
+        uiStartScreen(gpu::SCREEN_BOTTOM);
+        
+        char dispData[((nCharsDisp + 1) * nLinesDisp) + 1];
+        FmtBuffer dispString;
+        fmtStart(dispString, dispData, sizeof(dispData));
+        u32 lineLenDisp = 0; // longest line on screen (estimated from its size)
+        moreRight = false;
+        for (u32 l = 0; l < nLinesDisp; l++) {
+            u32 lineEnd = lineStarts.at(l + 1);
+            u32 dispStart = dispStarts.at(l);
+            u32 dispEnd = textGetGlyphs(text, dispStart, lineEnd, dispString, nCharsDisp);
+            if (l < nLinesDisp - 1) fmtChar(dispString, '\n');
+            if((lineEnd - lineStarts.at(l)) / unit > lineLenDisp) lineLenDisp = (lineEnd - lineStarts.at(l)) / unit;
+            if(!moreRight && (dispEnd < lineEnd)) {
+                char restData[3];
+                FmtBuffer rest;
+                fmtStart(rest, restData, sizeof(restData));
+                textGetGlyphs(text, dispEnd, lineEnd, rest, 2);
+                moreRight = (rest.size > 0);
+            }
+            // highlight hits, hits may continue on the next line when wrapping
+            lineHits.clear();
+            textSearchRange(text, search, dispStart, dispEnd, lineHits);
+            for (std::vector<u32>::iterator it = lineHits.begin(); it != lineHits.end(); it++) {
+                u32 c0 = (*it > dispStart) ? textCharCount(text, dispStart, *it) : 0;
+                u32 c1 = textCharCount(text, dispStart, (*it + search.term.size() < dispEnd) ? *it + search.term.size() : dispEnd);
+                u8 r = ((hitCurr != (u32) -1) && (search.hits.at(hitCurr) == *it)) ? cr : hr;
+                if(c0 < c1) uiDrawRectangle(c0 * 8, (nLinesDisp - 1 - l) * 8, (c1 - c0) * 8, 8, r, r, r);
             }
-            if(lf < end) {
-                start = lf + 1;
-                bufferMap.push_back(start);
-            } else break;
         }
-        bufferMap.push_back(end);
-        lineIndexMax = (bufferMap.size() > nLinesDisp) ? bufferMap.size() - nLinesDisp : 0;
         
-        // normalize lineIndex
-        for (lineIndex = lineIndexMax; (lineIndex > 0) &&
-            (offsetDisp - offsetBuff < bufferMap.at(lineIndex - 1)); lineIndex--);
+        uiDrawString(dispString.data, 0, 0, 8, 8);
+        uiDrawPositionBar(offsetDisp, lineStarts.at(nLinesDisp) - offsetDisp, text.size, false);
+        uiDrawPositionBar(charIndex, nCharsDisp, (moreRight && (lineLenDisp < charIndex + 2 * nCharsDisp)) ? charIndex + 2 * nCharsDisp : lineLenDisp, true);
+        
+        uiFlushBuffer();
+        uiSwapBuffers(true);
+        if(bothBuffers) { // fill both buffers
+            uiFlushBuffer();
+            uiSwapBuffers(true);
+        }
     };
     
-    bool result = fsDataProvider(path, 0, bufsize,
-        [&](u32 &offset, bool &forceRefresh) { // onLoop
-            if(offsetBuff != offset) {
-                offsetBuff = offset;
-                buildBufferMap();
-            }
-            
-            hid::poll();   
-            
-            // ONLOOP FUNCTION
-            if(onLoop && onLoop()) return true;
-            
-            // PROCESS INPUT
-            if(hid::pressed(hid::BUTTON_B)) {
-                return true;
-            } else if(hid::pressed(hid::BUTTON_X)) {
-                lineLenCurr = (lineLenCurr == lineLenMax) ? nCharsDisp : lineLenMax;
-                charIndex = 0;
-                buildBufferMap();
+    auto jumpTo = [&](bool toPercent) {
+        if(toPercent) {
+            u32 percent = (text.size) ? (u32) (((u64) offsetDisp * 100) / text.size) : 0;
+            percent = uiNumberInput(gpu::SCREEN_TOP, percent, "Go to percentage (0 - 100):\n", false);
+            if(percent == (u32) -1) return;
+            if(percent > 100) percent = 100;
+            offsetDisp = textLineAlign(text, (u32) (((u64) text.size * percent) / 100), lineLenCurr);
+        } else {
+            u32 line = textLineNumber(text, offsetDisp);
+            std::stringstream message;
+            message << "Go to line (1 - " << (text.indexedLines + 1) << ((textIndexDone(text)) ? "" : "+") << "):\n";
+            line = uiNumberInput(gpu::SCREEN_TOP, (line == (u32) -1) ? 1 : line + 1, message.str(), false);
+            if((line == (u32) -1) || (line == 0)) return;
+            // lines that are not indexed yet are indexed right now
+            while(!indexFailed && !textIndexDone(text) && (line - 1 > text.indexedLines)) {
+                if(!fsShowProgress("Indexing", path, text.indexedOffset, text.size)) break;
+                indexFailed = !textIndexStep(text, 1024 * 1024);
             }
-            if(hid::held(hid::BUTTON_LEFT) || hid::held(hid::BUTTON_RIGHT) ||
-               hid::held(hid::BUTTON_UP) || hid::held(hid::BUTTON_DOWN) ||
-               hid::held(hid::BUTTON_L) || hid::held(hid::BUTTON_R)) {
-                if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
-                    if(hid::held(hid::BUTTON_DOWN) && (lineIndex < lineIndexMax)) {
-                        lineIndex++;
-                    } else if(hid::held(hid::BUTTON_UP) && (lineIndex > 0)) {
-                        lineIndex--;
-                    } else if(hid::held(hid::BUTTON_R)) {
-                        lineIndex = (lineIndex + nLinesDisp < lineIndexMax) ?
-                            lineIndex + nLinesDisp : lineIndexMax;
-                    } else if(hid::held(hid::BUTTON_L)) {
-                        lineIndex = (lineIndex > nLinesDisp) ?
-                            lineIndex - nLinesDisp : 0;
-                    } else if(hid::held(hid::BUTTON_RIGHT) && (charIndex + nCharsDisp < lineLenCurr)) {
-                        charIndex++;
-                    } else if(hid::held(hid::BUTTON_LEFT) && (charIndex)) {
-                        charIndex--;
-                    }
-                    lastScrollTime = core::time();
+            u32 offset = textLineOffset(text, (line - 1 > text.indexedLines) ? text.indexedLines : line - 1);
+            if(offset != (u32) -1) offsetDisp = textLineAlign(text, offset, lineLenCurr);
+        }
+        clampDisp();
+    };
+    
+    // next / previous hit from the current one if it is on screen, from the screen otherwise
+    auto jumpToHit = [&](bool previous) {
+        mapLines();
+        u32 from = offsetDisp;
+        if((hitCurr != (u32) -1) && (search.hits.at(hitCurr) >= lineStarts.at(0)) && (search.hits.at(hitCurr) < lineStarts.at(nLinesDisp)))
+            from = search.hits.at(hitCurr) + ((previous) ? 0 : 1);
+        // hits that are not found yet are searched right now
+        u32 hit = (u32) -1;
+        while(true) {
+            std::vector<u32>::iterator it = std::lower_bound(search.hits.begin(), search.hits.end(), from);
+            if(previous && (it != search.hits.begin()) && ((it != search.hits.end()) || (search.searchedOffset >= from))) hit = it - search.hits.begin() - 1;
+            else if(!previous && (it != search.hits.end())) hit = it - search.hits.begin();
+            if((hit != (u32) -1) || searchFailed || textSearchDone(text, search)) break;
+            if(!fsShowProgress("Searching", path, search.searchedOffset, text.size)) return;
+            searchFailed = !textSearchStep(text, search, 1024 * 1024);
+        }
+        if(hit == (u32) -1) {
+            uiErrorPrompt(gpu::SCREEN_TOP, "Searching", "Not found: " + searchStr, false, false);
+            return;
+        }
+        hitCurr = hit;
+        u32 offset = search.hits.at(hit);
+        if((offset < lineStarts.at(0)) || (offset >= lineStarts.at(nLinesDisp))) {
+            offsetDisp = textLineAlign(text, offset, lineLenCurr);
+            clampDisp();
+        }
+        // scroll sideways if the hit is not on screen
+        u32 column = textCharCount(text, textLineAlign(text, offset, lineLenCurr), offset);
+        if((column < charIndex) || (column + search.nChars > charIndex + nCharsDisp)) {
+            charIndex = (column > nCharsDisp / 2) ? column - nCharsDisp / 2 : 0;
+            if(charIndex + nCharsDisp > lineLenCurr) charIndex = (lineLenCurr > nCharsDisp) ? lineLenCurr - nCharsDisp : 0;
+        }
+    };
+    
+    // search as you type, hits on screen are shown right away, the rest of the file is searched in the background
+    auto newSearch = [&](bool selectMode) {
+        if(selectMode) {
+            int mode = uiMenu("Search mode", { "match case", "ignore case", "match case, whole words", "ignore case, whole words" });
+            if(mode < 0) return;
+            ignoreCase = (mode % 2);
+            wholeWord = (mode >= 2);
+        }
+        std::string confirmMsg = (std::string) "Search " + ((ignoreCase) ? "(ignore case" : "(match case") + ((wholeWord) ? ", whole words):" : "):") + "\n";
+        std::string termCurr;
+        bool started = false;
+        auto startSearch = [&](const std::string term) {
+            textSearchStart(text, search, term, ignoreCase, wholeWord);
+            searchFailed = false;
+            hitCurr = (u32) -1;
+            termCurr = term;
+            started = true;
+        };
+        std::string result = uiStringInput(gpu::SCREEN_TOP, searchStr, alphabet, confirmMsg, 1, true,
+            [&](const std::string input) {
+                std::string term = input.substr(0, input.find_last_not_of(" ") + 1);
+                if(!started || (term != termCurr)) {
+                    startSearch(term);
+                    drawText(true);
                 }
-            } else if(lastScrollTime > 0) {
-                lastScrollTime = 0;
+                for (u64 start = core::time(); !searchFailed && !textSearchDone(text, search) && (core::time() - start < searchTime); )
+                    searchFailed = !textSearchStep(text, search, TEXT_INDEX_BUFSIZ);
+            });
+        if(result != termCurr) startSearch(result);
+        if(!result.empty()) {
+            searchStr = result;
+            jumpToHit(false);
+        }
+        if(hid::held(hid::BUTTON_A)) inputAHoldTime = (u64) -1; // A confirmed the input
+    };
+    
+    while(core::running()) {
+        // BUILD LINE INDEX / SEARCH (BACKGROUND)
+        for (u64 start = core::time(); !indexFailed && !textIndexDone(text) && (core::time() - start < indexTime); )
+            indexFailed = !textIndexStep(text, TEXT_INDEX_BUFSIZ);
+        for (u64 start = core::time(); !searchFailed && !textSearchDone(text, search) && (core::time() - start < searchTime); )
+            searchFailed = !textSearchStep(text, search, TEXT_INDEX_BUFSIZ);
+        
+        hid::poll();
+        
+        // ONLOOP FUNCTION
+        if(onLoop && onLoop()) break;
+        
+        // FOLLOW MODE (FILE GROWS / GETS TRUNCATED)
+        if(following && (core::time() - lastFollowTime >= followDelay)) {
+            bool atEnd = (lineStarts.at(nLinesDisp) >= text.size);
+            if(textRefresh(text) && atEnd && (text.size > textSizePrev)) {
+                offsetDisp = textLineAlign(text, text.size, lineLenCurr);
+                offsetLines = (u32) -1;
+                clampDisp();
             }
-            
-            // BUILD STRING TO DISPLAY ON SCREEN
-            std::string dispString;
-            u32 dispStart = (lineIndex) ? bufferMap.at(lineIndex - 1) : 0;
-            u32 lineStart = dispStart;
-            offsetDisp = offsetBuff + dispStart;
-            for (u32 l = 0; l < nLinesDisp; l++) {
-                if(lineIndex + l < bufferMap.size()) {
-                    u32 lineEnd = bufferMap.at(lineIndex + l);
-                    std::string lineString(localData + lineStart, lineEnd - lineStart);
-                    for (u32 badchar = lineString.find_first_of("\n\r");
-                         badchar != std::string::npos;
-                         badchar = lineString.find_first_of("\n\r", badchar))
-                        lineString.erase(badchar, 1);
-                    if(lineString.size() > charIndex)
-                        dispString += lineString.substr(charIndex, nCharsDisp);
-                    lineStart = lineEnd;
+            lastFollowTime = core::time();
+        }
+        
+        // TEXT END MOVED (NUL BYTE FOUND / FILE CHANGED)
+        if(text.size != textSizePrev) {
+            if(text.size < textSizePrev) {
+                if(offsetDisp >= text.size) offsetDisp = textLineAlign(text, offsetDisp, lineLenCurr);
+                if(!search.term.empty()) textSearchStart(text, search, searchStr, ignoreCase, wholeWord);
+                searchFailed = false;
+                hitCurr = (u32) -1;
+                lineDisp = (u32) -1;
+            }
+            textSizePrev = text.size;
+            offsetLines = (u32) -1;
+            clampDisp();
+        }
+        
+        // PROCESS INPUT
+        mapLines();
+        if(hid::pressed(hid::BUTTON_B)) {
+            break;
+        } else if(hid::pressed(hid::BUTTON_SELECT)) {
+            newSearch(true);
+        }
+        if(hid::held(hid::BUTTON_X) && (inputXHoldTime != (u64) -1)) {
+            if(inputXHoldTime == 0) inputXHoldTime = core::time();
+            else if(core::time() - inputXHoldTime >= tapDelay) {
+                following = !following;
+                if(following) {
+                    textRefresh(text);
+                    offsetDisp = textLineAlign(text, text.size, lineLenCurr);
+                    clampDisp();
+                    lastFollowTime = core::time();
                 }
-                if (l < nLinesDisp - 1) dispString += "\n";
+                inputXHoldTime = (u64) -1;
             }
-            u32 dispEnd = lineStart;
-            
-            // BUFFER CHECK (RELOAD IF RUNNING OUT)
-            if(fileSize > bufsize) { // no need if the whole file fits into the buffer
-                if((dispStart < safeSize) || (bufsize - dispStart < safeSize))
-                    offset = (offsetDisp > (bufsize / 2)) ? offsetDisp - (bufsize / 2) : 0;
+        }
+        if(hid::released(hid::BUTTON_X) && (inputXHoldTime != 0)) {
+            if(inputXHoldTime != (u64) -1) {
+                lineLenCurr = (lineLenCurr == TEXT_NO_WRAP) ? nCharsDisp : TEXT_NO_WRAP;
+                charIndex = 0;
+                offsetDisp = textLineAlign(text, offsetDisp, lineLenCurr);
+                offsetLines = (u32) -1;
+                clampDisp();
             }
-            
-            // ONUPDATE FUNCTION
-            if((offsetDisp != offsetDispPrev) || (charIndex != charIndexPrev)) {
-                if((onUpdate != NULL) && onUpdate(offsetDisp, charIndex))
-                    return true;
-                offsetDispPrev = offsetDisp;
-                charIndexPrev = charIndex;
+            inputXHoldTime = 0;
+        }
+        if(hid::held(hid::BUTTON_A) && (inputAHoldTime != (u64) -1)) {
+            if(inputAHoldTime == 0) inputAHoldTime = core::time();
+            else if(core::time() - inputAHoldTime >= tapDelay) {
+                if(search.term.empty()) newSearch(false);
+                else jumpToHit(true);
+                inputAHoldTime = (u64) -1;
             }
-            
-            // ON SCREEN DISPLAY
-            gpu::setViewport(gpu::SCREEN_BOTTOM, 0, 0, gpu::BOTTOM_WIDTH, gpu::BOTTOM_HEIGHT);
-            gput::setOrtho(0, gpu::BOTTOM_WIDTH, 0, gpu::BOTTOM_HEIGHT, -1, 1);
-            gpu::clear();
-            
-            gput::drawString(dispString, 0, 0, 8, 8);
-            uiDrawPositionBar(offsetDisp, dispEnd - dispStart, fileSize, false);
-            uiDrawPositionBar(charIndex, nCharsDisp, lineLenCurr, true);
-            
-            gpu::flushCommands();
-            gpu::flushBuffer();
-            gpu::swapBuffers(true);
-            
-            return false;
-        },
-        [&](u8* data) { // onUpdate
-            localData = (char*) data;
-            return false;
-        });
+        }
+        if(hid::released(hid::BUTTON_A) && (inputAHoldTime != 0)) {
+            bool tap = (inputAHoldTime != (u64) -1);
+            inputAHoldTime = 0;
+            if(tap && search.term.empty()) newSearch(false);
+            else if(tap) jumpToHit(false);
+        }
+        if(hid::held(hid::BUTTON_Y) && (inputYHoldTime != (u64) -1)) {
+            if(inputYHoldTime == 0) inputYHoldTime = core::time();
+            else if(core::time() - inputYHoldTime >= tapDelay) {
+                jumpTo(true);
+                inputYHoldTime = (u64) -1;
+            }
+        }
+        if(hid::released(hid::BUTTON_Y) && (inputYHoldTime != 0)) {
+            if(inputYHoldTime != (u64) -1) jumpTo(false);
+            inputYHoldTime = 0;
+        }
+        if(hid::held(hid::BUTTON_LEFT) || hid::held(hid::BUTTON_RIGHT) ||
+           hid::held(hid::BUTTON_UP) || hid::held(hid::BUTTON_DOWN) ||
+           hid::held(hid::BUTTON_L) || hid::held(hid::BUTTON_R)) {
+            if(lastScrollTime == 0 || core::time() - lastScrollTime >= 120) {
+                if(hid::held(hid::BUTTON_DOWN) && (lineStarts.at(nLinesDisp) < text.size)) {
+                    offsetDisp = lineStarts.at(1);
+                } else if(hid::held(hid::BUTTON_UP) && (offsetDisp > text.start)) {
+                    offsetDisp = textLineAlign(text, offsetDisp - 1, lineLenCurr);
+                } else if(hid::held(hid::BUTTON_RIGHT) || hid::held(hid::BUTTON_LEFT)) {
+                    // L - page left / right, R - begin / end of the first line
+                    if(hid::held(hid::BUTTON_RIGHT) && moreRight) {
+                        if(hid::held(hid::BUTTON_R)) {
+                            u32 column = textCharCount(text, lineStarts.at(0), lineStarts.at(1));
+                            if(column > charIndex + nCharsDisp) charIndex = column - nCharsDisp;
+                        } else charIndex += (hid::held(hid::BUTTON_L)) ? nCharsDisp : 1;
+                    } else if(hid::held(hid::BUTTON_LEFT) && (charIndex)) {
+                        if(hid::held(hid::BUTTON_R)) charIndex = 0;
+                        else charIndex -= (hid::held(hid::BUTTON_L) && (charIndex > nCharsDisp)) ? nCharsDisp : (hid::held(hid::BUTTON_L)) ? charIndex : 1;
+                    }
+                } else if(hid::held(hid::BUTTON_R)) {
+                    u32 bottom = lineStarts.at(nLinesDisp);
+                    for (u32 l = 0; (l < nLinesDisp) && (bottom < text.size); l++) {
+                        offsetDisp = textLineNext(text, offsetDisp, lineLenCurr);
+                        bottom = textLineNext(text, bottom, lineLenCurr);
+                    }
+                } else if(hid::held(hid::BUTTON_L)) {
+                    for (u32 l = 0; (l < nLinesDisp) && (offsetDisp > text.start); l++)
+                        offsetDisp = textLineAlign(text, offsetDisp - 1, lineLenCurr);
+                }
+                lastScrollTime = core::time();
+            }
+        } else if(lastScrollTime > 0) {
+            lastScrollTime = 0;
+        }
+        mapLines();
+        
+        // ONUPDATE FUNCTION (LINE / HIT COUNT IS REFRESHED 4x PER SECOND WHILE INDEXING / SEARCHING)
+        bool indexing = !indexFailed && !textIndexDone(text);
+        bool searching = !searchFailed && !textSearchDone(text, search);
+        u32 nHits = (search.term.empty()) ? (u32) -1 : search.hits.size();
+        if((offsetDisp != offsetDispPrev) || (charIndex != charIndexPrev) || (indexing != indexingPrev) ||
+            (hitCurr != hitCurrPrev) || ((nHits != nHitsPrev) && !searching) || (following != followingPrev) ||
+            ((indexing || searching) && (core::time() - lastUpdateTime >= 250))) {
+            if((offsetDisp != offsetDispPrev) || (lineDisp == (u32) -1))
+                lineDisp = textLineNumber(text, offsetDisp);
+            if((onUpdate != NULL) && onUpdate(offsetDisp, charIndex, lineDisp, text.indexedLines + 1, indexing, hitCurr, nHits, searching, following))
+                break;
+            offsetDispPrev = offsetDisp;
+            charIndexPrev = charIndex;
+            indexingPrev = indexing;
+            hitCurrPrev = hitCurr;
+            nHitsPrev = nHits;
+            followingPrev = following;
+            lastUpdateTime = core::time();
+        }
+        
+        // ON SCREEN DISPLAY
+        drawText(false);
+    }
     
-    return result;
+    textClose(text);
+    
+    return true;
 }
 
 void uiDisplayMessage(gpu::Screen screen, const std::string message) {
-    gpu::setViewport(screen, 0, 0, screen == gpu::SCREEN_TOP ? gpu::TOP_WIDTH : gpu::BOTTOM_WIDTH, screen == gpu::SCREEN_TOP ? gpu::TOP_HEIGHT : gpu::BOTTOM_HEIGHT);
-    gput::setOrtho(0, screen == gpu::SCREEN_TOP ? gpu::TOP_WIDTH : gpu::BOTTOM_WIDTH, 0, screen == gpu::SCREEN_TOP ? gpu::TOP_HEIGHT : gpu::BOTTOM_HEIGHT, -1, 1);
+    uiDisplayMessage(screen, message.c_str());
+}
+
+void uiDisplayMessage(gpu::Screen screen, const char* message) {
+    uiStartScreen(screen);
     
     u32 screenWidth;
     u32 screenHeight;
     gpu::getViewportWidth(&screenWidth);
     gpu::getViewportHeight(&screenHeight);
 
-    gpu::clear();
-    gput::drawString(message, (screenWidth - gput::getStringWidth(message, 8)) / 2, (screenHeight - gput::getStringHeight(message, 8)) / 2, 8, 8);
-    gpu::flushCommands();
-    gpu::flushBuffer();
-    gpu::swapBuffers(true);
+    u32 size = strlen(message);
+    uiDrawString(message, ((float) screenWidth - uiStringWidth(message, size, 8)) / 2, ((float) screenHeight - uiStringHeight(message, size, 8)) / 2, 8, 8);
+    uiFlushBuffer();
+    uiSwapBuffers(true);
 
     gpu::setViewport(gpu::SCREEN_TOP, 0, 0, gpu::TOP_WIDTH, gpu::TOP_HEIGHT);
     gput::setOrtho(0, gpu::TOP_WIDTH, 0, gpu::TOP_HEIGHT, -1, 1);
@@ -976,7 +1675,7 @@ std::string uiKeyboardInput(std::string preset, const std::string alphabet) {
     return resultStr;
 }
 
-std::string uiStringInput(gpu::Screen screen, std::string preset, const std::string alphabet, const std::string message, u32 resize, bool allow_keyboard) {
+std::string uiStringInput(gpu::Screen screen, std::string preset, const std::string alphabet, const std::string message, u32 resize, bool allow_keyboard, std::function<void(const std::string input)> onLoop) {
     const int dispSize = 30;
     const u64 tapDelay = 360;
     const u64 scrollDelay = 120;
@@ -997,25 +1696,28 @@ std::string uiStringInput(gpu::Screen screen, std::string preset, const std::str
     if(hid::held(hid::BUTTON_Y)) inputYHoldTime = (u64) -1;
     
     while(core::running()) {
-        std::stringstream stream;
-        stream << message << "\n";
-        stream << ((scroll > 0) ? "<" : "|");
-        stream << resultStr.substr(scroll, dispSize);
-        stream << ((resultStr.size() - scroll > dispSize) ? ">" : "|") << "\n";
-        for(int i = scroll; i <= cursor_s; i++) stream << " ";
-        stream << "^" << "\n" << "\n";
-        stream << "L - [h] (" << (char) 0x18 << (char) 0x19 << ") fast scroll" << "\n";
+        char str[1024];
+        FmtBuffer buf;
+        fmtStart(buf, str, sizeof(str));
+        fmtString(buf, message);
+        fmtString(buf, "\n");
+        fmtString(buf, (scroll > 0) ? "<" : "|");
+        fmtString(buf, resultStr.data() + scroll, std::min((int) resultStr.size() - scroll, dispSize));
+        fmtString(buf, (resultStr.size() - scroll > dispSize) ? ">\n" : "|\n");
+        if(cursor_s >= scroll) fmtChar(buf, ' ', cursor_s + 1 - scroll);
+        fmtString(buf, "^\n\n");
+        fmtString(buf, "L - [h] (\x18\x19) fast scroll\n");
         if (allow_keyboard) {
-            stream << "R - use touchscreen keyboard" << "\n";
+            fmtString(buf, "R - use touchscreen keyboard\n");
         }
         if(resize) {
-            stream << "X - [t] remove char / [h] clear" << "\n";
-            stream << "Y - [t] insert char / [h] reset" << "\n";
+            fmtString(buf, "X - [t] remove char / [h] clear\n");
+            fmtString(buf, "Y - [t] insert char / [h] reset\n");
         } else {
-            stream << "X - [h] clear" << "\n";
-            stream << "Y - [h] reset" << "\n";
+            fmtString(buf, "X - [h] clear\n");
+            fmtString(buf, "Y - [h] reset\n");
         }
-        stream << "\n" << "Press A to confirm, B to cancel." << "\n";
+        fmtString(buf, "\nPress A to confirm, B to cancel.\n");
     
         hid::poll();
         
@@ -1126,8 +1828,10 @@ std::string uiStringInput(gpu::Screen screen, std::string preset, const std::str
         } else if (lastScrollTime > 0) {
             lastScrollTime = 0;
         }
+        
+        if(onLoop != NULL) onLoop(resultStr);
 
-        uiDisplayMessage(screen, stream.str());
+        uiDisplayMessage(screen, str);
     }
     
     if(result) {
@@ -1181,35 +1885,30 @@ std::vector<u8> uiDataInput(gpu::Screen screen, std::vector<u8> preset, const st
 }
 
 void uiDisplayProgress(gpu::Screen screen, const std::string operation, const std::string details, bool quickSwap, u32 progress) {
-    std::stringstream stream;
-    stream << operation << ": [";
-    u32 progressBars = progress / 4;
-    for(u32 i = 0; i < 25; i++) {
-        if(i < progressBars) {
-            stream << '|';
-        } else {
-            stream << ' ';
-        }
-    }
-
-    stream << "] " << std::setfill(' ') << std::setw(3) << progress << "%" << "\n";
-    stream << details << "\n";
-
-    std::string str = stream.str();
-
-    gpu::setViewport(screen, 0, 0, screen == gpu::SCREEN_TOP ? gpu::TOP_WIDTH : gpu::BOTTOM_WIDTH, screen == gpu::SCREEN_TOP ? gpu::TOP_HEIGHT : gpu::BOTTOM_HEIGHT);
-    gput::setOrtho(0, screen == gpu::SCREEN_TOP ? gpu::TOP_WIDTH : gpu::BOTTOM_WIDTH, 0, screen == gpu::SCREEN_TOP ? gpu::TOP_HEIGHT : gpu::BOTTOM_HEIGHT, -1, 1);
+    char str[512];
+    FmtBuffer buf;
+    fmtStart(buf, str, sizeof(str));
+    fmtString(buf, operation);
+    fmtString(buf, ": [");
+    u32 progressBars = (progress < 100) ? progress / 4 : 25;
+    fmtChar(buf, '|', progressBars);
+    fmtChar(buf, ' ', 25 - progressBars);
+    fmtString(buf, "] ");
+    fmtDec(buf, progress, 3);
+    fmtString(buf, "%\n");
+    fmtString(buf, details);
+    fmtString(buf, "\n");
+
+    uiStartScreen(screen);
     
     u32 screenWidth;
     u32 screenHeight;
     gpu::getViewportWidth(&screenWidth);
     gpu::getViewportHeight(&screenHeight);
 
-    gpu::clear();
-    gput::drawString(str, (screenWidth - gput::getStringWidth(str, 8)) / 2, (screenHeight - gput::getStringHeight(str, 8)) / 2, 8, 8);
-    gpu::flushCommands();
-    gpu::flushBuffer();
-    gpu::swapBuffers(!quickSwap);
+    uiDrawString(str, ((float) screenWidth - uiStringWidth(str, buf.size, 8)) / 2, ((float) screenHeight - uiStringHeight(str, buf.size, 8)) / 2, 8, 8);
+    uiFlushBuffer();
+    uiSwapBuffers(!quickSwap);
 
     gpu::setViewport(gpu::SCREEN_TOP, 0, 0, gpu::TOP_WIDTH, gpu::TOP_HEIGHT);
     gput::setOrtho(0, gpu::TOP_WIDTH, 0, gpu::TOP_HEIGHT, -1, 1);
@@ -1,6 +1,8 @@
 #ifndef __CTRX_UI_HPP__
 #define __CTRX_UI_HPP__
 
+#include "entropy.hpp"
+
 #include <citrus/gpu.hpp>
 #include <citrus/hid.hpp>
 #include <citrus/types.hpp>
@@ -10,6 +12,8 @@
 #include <string>
 #include <vector>
 
+#define UI_STATE_INIT 0xCBF29CE484222325ULL // start value for uiHashState()
+
 typedef struct {
     std::string id;
     std::string name;
@@ -20,16 +24,30 @@ void uiInit();
 void uiCleanup();
 
 void uiDrawRectangle(int x, int y, u32 width, u32 height, u8 red = 0xFF, u8 green = 0xFF, u8 blue = 0xFF, u8 alpha = 0xFF);
+void uiDrawString(const char* str, float x, float y, float charWidth, float charHeight, u8 red = 0xFF, u8 green = 0xFF, u8 blue = 0xFF, u8 alpha = 0xFF);
+void uiDrawString(const std::string &str, float x, float y, float charWidth, float charHeight, u8 red = 0xFF, u8 green = 0xFF, u8 blue = 0xFF, u8 alpha = 0xFF);
+void uiStartScreen(ctr::gpu::Screen screen);
+void uiFlushBuffer();
+void uiSwapBuffers(bool vblank);
+bool uiScreenCurrent(ctr::gpu::Screen screen, u64 state);
+u64 uiHashState(u64 hash, u64 value);
+u64 uiHashState(u64 hash, const std::string &str);
 void uiDrawPositionBar(u32 pos, u32 nshown, u32 total, bool use_bottom = false);
 std::string uiTruncateString(const std::string str, int nsize, int pos);
 std::string uiFormatBytes(u64 bytes);
+bool uiSelectMultiple(const std::string startId, std::vector<SelectableElement> elements, std::function<bool(std::vector<SelectableElement> &currElements, bool &elementsDirty, bool &resetCursorIfDirty)> onLoop, std::function<void(SelectableElement* select)> onUpdateCursor, std::function<void(std::set<SelectableElement*>* marked)> onUpdateMarked, std::function<bool(SelectableElement* selected)> onSelect, bool useTopScreen, bool alphabetize);
+int uiMenu(const std::string message, const std::vector<std::string> options);
 bool uiFileBrowser(const std::string rootDirectory, const std::string startPath, std::function<bool(bool &updateList, bool &resetCursorOnUpdate)> onLoop, std::function<void(SelectableElement* entry)> onUpdateEntry, std::function<void(std::string* currDir)> onUpdateDir, std::function<void(std::set<SelectableElement*>* marked)> onUpdateMarked, std::function<bool(std::string selectedPath, bool &updateList)> onSelect, bool useTopScreen = false);
-bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode)> onLoop, std::function<bool(u32 offset)> onUpdate, std::function<bool(u32 selectedOffset, u32 selectedLength, ctr::hid::Button selectButton, bool &updateData)> onSelect);
-bool uiTextViewer(const std::string path, std::function<bool(void)> onLoop, std::function<bool(u32 offset, u32 plus)> onUpdate);
+bool uiHexViewer(const std::string path, u32 start, std::function<bool(u32 &offset, u32 &markedOffset, u32 &markedLength, bool selectMode, bool &updateData)> onLoop, std::function<bool(u32 offset)> onUpdate, std::function<bool(u32 selectedOffset, u32 selectedLength, ctr::hid::Button selectButton, bool &updateData)> onSelect);
+bool uiCompareViewer(const std::string path0, const std::string path1, u32 start, std::function<bool(u32 &offset, bool &forceRefresh)> onLoop, std::function<bool(u32 offset)> onUpdate);
+void uiDrawEntropyStrip(const EntropyMap &map, u32 block, int x, int y, u32 width, u32 height);
+bool uiEntropyViewer(const EntropyMap &map, u32 start, std::function<bool(u32 &block, bool &forceRefresh)> onLoop, std::function<bool(u32 block)> onUpdate);
+bool uiTextViewer(const std::string path, std::function<bool(void)> onLoop, std::function<bool(u32 offset, u32 plus, u32 line, u32 nLines, bool indexing, u32 hit, u32 nHits, bool searching, bool following)> onUpdate);
 void uiDisplayMessage(ctr::gpu::Screen screen, const std::string message);
+void uiDisplayMessage(ctr::gpu::Screen screen, const char* message);
 bool uiPrompt(ctr::gpu::Screen screen, const std::string message, bool question);
 bool uiErrorPrompt(ctr::gpu::Screen screen, const std::string operationStr, const std::string detailStr, bool checkErrno, bool question);
-std::string uiStringInput(ctr::gpu::Screen screen, std::string preset, const std::string alphabet, const std::string message, u32 resize = 1, bool allow_keyboard = false);
+std::string uiStringInput(ctr::gpu::Screen screen, std::string preset, const std::string alphabet, const std::string message, u32 resize = 1, bool allow_keyboard = false, std::function<void(const std::string input)> onLoop = NULL);
 u32 uiNumberInput(ctr::gpu::Screen screen, u32 preset, const std::string message, bool hex = false);
 std::vector<u8> uiDataInput(ctr::gpu::Screen screen, std::vector<u8> preset, const std::string message, bool allowResize = true);
 void uiDisplayProgress(ctr::gpu::Screen screen, const std::string operation, const std::string details, bool quickSwap, u32 progress);
@@ -0,0 +1,175 @@
+#include "usage.hpp"
+#include "fs.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+
+static std::map<std::string, UsageInfo> usageDirs;
+static std::vector<FileSizeInfo> usageTop; // sorted, largest first
+
+static bool usageLarger(const FileSizeInfo &a, const FileSizeInfo &b) {
+    return a.size > b.size;
+}
+
+static bool usageIsBelow(const std::string &key, const std::string &dirKey) {
+    if(key.compare(0, dirKey.size(), dirKey) != 0) return false;
+    return (key.size() == dirKey.size()) || (dirKey[dirKey.size() - 1] == '/') || (key[dirKey.size()] == '/');
+}
+
+static void usageTopInsert(const FileSizeInfo &file) {
+    std::vector<FileSizeInfo>::iterator it = std::upper_bound(usageTop.begin(), usageTop.end(), file, usageLarger);
+    if(it - usageTop.begin() >= USAGE_TOP_FILES) return;
+    usageTop.insert(it, file);
+    if(usageTop.size() > USAGE_TOP_FILES) usageTop.pop_back();
+}
+
+// walks directory into dirs (itself included), the largest files are kept in a min heap bounded to USAGE_TOP_FILES
+static bool usageWalk(const std::string key, std::map<std::string, UsageInfo> &dirs, std::vector<FileSizeInfo> &top, bool showProgress) {
+    std::priority_queue<FileSizeInfo, std::vector<FileSizeInfo>, std::function<bool(const FileSizeInfo&, const FileSizeInfo&)>> heap(usageLarger);
+    std::vector<std::string> order(1, key); // breadth first, parents before children
+    std::string lastParent = "";
+    UsageInfo* lastInfo = NULL;
+    dirs[key] = { 0, 0, 0 };
+    if(!fsWalk(key, [&](const std::string &path, u64 size, bool isDirectory) {
+            // entries arrive folder by folder, so the parent lookup is mostly cached
+            std::string parent = fsGetParentDir(path);
+            if((lastInfo == NULL) || (parent != lastParent)) {
+                lastParent = parent;
+                lastInfo = &dirs[parent];
+            }
+            if(isDirectory) {
+                dirs[path] = { 0, 0, 0 };
+                order.push_back(path);
+                (*lastInfo).dirs++;
+                return true;
+            }
+            (*lastInfo).size += size;
+            (*lastInfo).files++;
+            heap.push({path, size});
+            if(heap.size() > USAGE_TOP_FILES) heap.pop();
+            return true;
+        }, showProgress)) return false;
+
+    // sizes so far are per folder, children add up into their parents
+    for (std::vector<std::string>::reverse_iterator it = order.rbegin(); it != order.rend(); it++) {
+        if(*it == key) continue;
+        const UsageInfo &child = dirs[*it];
+        UsageInfo &parent = dirs[fsGetParentDir(*it)];
+        parent.size += child.size;
+        parent.files += child.files;
+        parent.dirs += child.dirs;
+    }
+
+    top.resize(heap.size());
+    for (u32 i = heap.size(); i > 0; i--) {
+        top[i - 1] = heap.top();
+        heap.pop();
+    }
+
+    return true;
+}
+
+// adds info to every cached folder above key
+static void usagePropagate(const std::string &key, const UsageInfo &info, bool add) {
+    for (std::string parent = fsGetParentDir(key); !parent.empty(); parent = fsGetParentDir(parent)) {
+        std::map<std::string, UsageInfo>::iterator it = usageDirs.find(parent);
+        if(it == usageDirs.end()) break;
+        UsageInfo &dir = (*it).second;
+        dir.size = add ? dir.size + info.size : ((dir.size > info.size) ? dir.size - info.size : 0);
+        dir.files = add ? dir.files + info.files : ((dir.files > info.files) ? dir.files - info.files : 0);
+        dir.dirs = add ? dir.dirs + info.dirs : ((dir.dirs > info.dirs) ? dir.dirs - info.dirs : 0);
+    }
+}
+
+bool usageScan(const std::string directory, bool showProgress) {
+    const std::string key = fsNormalizePath(directory);
+    if(usageDirs.find(key) != usageDirs.end()) return true;
+
+    std::map<std::string, UsageInfo> dirs;
+    std::vector<FileSizeInfo> top;
+    if(!usageWalk(key, dirs, top, showProgress)) return false;
+    usageDirs.swap(dirs);
+    usageTop.swap(top);
+
+    return true;
+}
+
+void usageClear() {
+    usageDirs.clear();
+    usageTop.clear();
+}
+
+bool usageGet(const std::string directory, UsageInfo &info) {
+    std::map<std::string, UsageInfo>::iterator it = usageDirs.find(fsNormalizePath(directory));
+    if(it == usageDirs.end()) return false;
+    info = (*it).second;
+    return true;
+}
+
+void usageChildren(const std::string directory, std::vector<FileSizeInfo> &dirs) {
+    const std::string key = fsNormalizePath(directory);
+    const std::string prefix = (key[key.size() - 1] == '/') ? key : key + "/";
+    dirs.clear();
+    for (std::map<std::string, UsageInfo>::iterator it = usageDirs.lower_bound(prefix);
+        (it != usageDirs.end()) && ((*it).first.compare(0, prefix.size(), prefix) == 0); it++) {
+        if((*it).first.find('/', prefix.size()) == std::string::npos) dirs.push_back({(*it).first, (*it).second.size});
+    }
+    std::stable_sort(dirs.begin(), dirs.end(), usageLarger);
+}
+
+void usageTopFiles(const std::string directory, std::vector<FileSizeInfo> &files) {
+    // the largest files below a subfolder are a prefix of its own top list, there may just be fewer of them
+    const std::string key = fsNormalizePath(directory);
+    files.clear();
+    for (std::vector<FileSizeInfo>::iterator it = usageTop.begin(); it != usageTop.end(); it++) {
+        if(usageIsBelow((*it).path, key)) files.push_back(*it);
+    }
+}
+
+void usageRemove(const std::string path) {
+    const std::string key = fsNormalizePath(path);
+    if(usageDirs.find(fsGetParentDir(key)) == usageDirs.end()) return;
+
+    UsageInfo info = { 0, 0, 0 };
+    std::map<std::string, UsageInfo>::iterator it = usageDirs.find(key);
+    if(it != usageDirs.end()) {
+        info = (*it).second;
+        info.dirs++;
+        usageDirs.erase(it);
+        const std::string prefix = key + "/";
+        for (it = usageDirs.lower_bound(prefix); (it != usageDirs.end()) && ((*it).first.compare(0, prefix.size(), prefix) == 0);)
+            usageDirs.erase(it++);
+    } else if(!fsIsDirectory(key) && fsExists(key)) { // a folder would have been cached with its parent
+        info.size = fsGetFileSize(key);
+        info.files = 1;
+    } else return;
+    usagePropagate(key, info, false);
+
+    for (std::vector<FileSizeInfo>::iterator top = usageTop.begin(); top != usageTop.end();) {
+        if(usageIsBelow((*top).path, key)) top = usageTop.erase(top);
+        else top++;
+    }
+}
+
+void usageAdd(const std::string path) {
+    const std::string key = fsNormalizePath(path);
+    if((usageDirs.find(fsGetParentDir(key)) == usageDirs.end()) || (usageDirs.find(key) != usageDirs.end())) return;
+
+    UsageInfo info = { 0, 0, 0 };
+    if(fsIsDirectory(key)) {
+        std::map<std::string, UsageInfo> dirs;
+        std::vector<FileSizeInfo> top;
+        if(!usageWalk(key, dirs, top, false)) return;
+        info = dirs[key];
+        info.dirs++;
+        usageDirs.insert(dirs.begin(), dirs.end());
+        for (std::vector<FileSizeInfo>::iterator it = top.begin(); it != top.end(); it++) usageTopInsert(*it);
+    } else if(fsExists(key)) {
+        info.size = fsGetFileSize(key);
+        info.files = 1;
+        usageTopInsert({key, info.size});
+    } else return;
+    usagePropagate(key, info, true);
+}
@@ -0,0 +1,32 @@
+#ifndef __CTRX_USAGE_HPP__
+#define __CTRX_USAGE_HPP__
+
+#include "fs.hpp"
+
+#include <citrus/types.hpp>
+
+#include <string>
+#include <vector>
+
+#define USAGE_TOP_FILES 16 // largest files kept per scan
+
+typedef struct {
+    u64 size; // recursive
+    u32 files; // recursive
+    u32 dirs; // recursive, not counting the folder itself
+} UsageInfo;
+
+// recursive folder sizes from a single walk, kept in memory for the last scanned tree
+// folders below a scanned one are answered from that scan, usageRemove() / usageAdd() keep it in line with
+// changes made from within CTRX: call usageRemove() before a path changes and usageAdd() once it exists again
+// functions return false and set errno on failure or cancel, the previous scan is kept in that case
+
+bool usageScan(const std::string directory, bool showProgress = false);
+void usageClear();
+bool usageGet(const std::string directory, UsageInfo &info);
+void usageChildren(const std::string directory, std::vector<FileSizeInfo> &dirs); // largest first
+void usageTopFiles(const std::string directory, std::vector<FileSizeInfo> &files); // largest first, files of the scan below directory
+void usageRemove(const std::string path);
+void usageAdd(const std::string path);
+
+#endif
@@ -0,0 +1,342 @@
+#include "verify.hpp"
+#include "fmt.hpp"
+#include "fs.hpp"
+
+#include <sys/errno.h>
+#include <sys/stat.h>
+#include <string.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <map>
+
+typedef struct {
+    u64 size;
+    u64 mtime;
+    HashResult hash;
+} VerifyCacheEntry;
+
+static std::map<std::string, VerifyCacheEntry> verifyCache;
+static bool verifyCacheLoaded = false;
+static bool verifyCacheDirty = false;
+
+static int verifyHexDigit(char c) {
+    if((c >= '0') && (c <= '9')) return c - '0';
+    if((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+    if((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+    return -1;
+}
+
+// exactly size * 2 hex digits, anything may follow
+static bool verifyParseHex(const char* str, u8* out, u32 size) {
+    for (u32 i = 0; i < size; i++) {
+        int hi = verifyHexDigit(str[i * 2]);
+        int lo = (hi >= 0) ? verifyHexDigit(str[(i * 2) + 1]) : -1;
+        if(lo < 0) return false;
+        out[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+static u32 verifyDigestSize(u32 type) {
+    switch(type) {
+        case HASH_CRC32: return 4;
+        case HASH_MD5: return 16;
+        case HASH_SHA1: return 20;
+        case HASH_SHA256: return 32;
+        default: return 0;
+    }
+}
+
+static const u8* verifyDigest(const HashResult &result, u32 type, u8* crcBytes) {
+    switch(type) {
+        case HASH_CRC32:
+            for (u32 i = 0; i < 4; i++)
+                crcBytes[i] = (u8) (result.crc32 >> ((3 - i) * 8)); // as written in manifests
+            return crcBytes;
+        case HASH_MD5: return result.md5;
+        case HASH_SHA1: return result.sha1;
+        case HASH_SHA256: return result.sha256;
+        default: return NULL;
+    }
+}
+
+static void verifyCacheLoad() {
+    if(verifyCacheLoaded) return;
+    verifyCacheLoaded = true;
+
+    // one file per line: size mtime types crc32 md5 sha1 sha256 path
+    FILE* fp = fopen(VERIFY_CACHE_PATH, "r");
+    if(fp == NULL) return;
+    char line[VERIFY_LINE_MAX + 256];
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        VerifyCacheEntry entry;
+        char* str = line;
+        entry.size = strtoull(str, &str, 10);
+        entry.mtime = strtoull(str, &str, 10);
+        entry.hash.types = strtoul(str, &str, 16);
+        if((*str++ != ' ') || (strlen(str) < 8 + 1 + 32 + 1 + 40 + 1 + 64 + 2)) continue;
+        u8 crc[4];
+        if(!verifyParseHex(str, crc, 4) || (str[8] != ' ')) continue;
+        entry.hash.crc32 = (crc[0] << 24) | (crc[1] << 16) | (crc[2] << 8) | crc[3];
+        str += 8 + 1;
+        if(!verifyParseHex(str, entry.hash.md5, 16) || (str[32] != ' ')) continue;
+        str += 32 + 1;
+        if(!verifyParseHex(str, entry.hash.sha1, 20) || (str[40] != ' ')) continue;
+        str += 40 + 1;
+        if(!verifyParseHex(str, entry.hash.sha256, 32) || (str[64] != ' ')) continue;
+        str += 64 + 1;
+        str[strcspn(str, "\r\n")] = '\0';
+        if(*str != '\0') verifyCache[str] = entry;
+    }
+    fclose(fp);
+}
+
+bool verifyCacheSave() {
+    if(!verifyCacheDirty) return true;
+
+    fsCreateDir(VERIFY_CACHE_DIR);
+    FILE* fp = fopen(VERIFY_CACHE_PATH, "w");
+    if(fp == NULL) return false;
+    bool ret = true;
+    char line[VERIFY_LINE_MAX + 256];
+    FmtBuffer buf;
+    for (std::map<std::string, VerifyCacheEntry>::iterator it = verifyCache.begin(); ret && (it != verifyCache.end()); it++) {
+        const HashResult &hash = it->second.hash;
+        fmtStart(buf, line, sizeof(line));
+        fmtDec(buf, it->second.size);
+        fmtChar(buf, ' ');
+        fmtDec(buf, it->second.mtime);
+        fmtChar(buf, ' ');
+        fmtHex(buf, hash.types, 1);
+        fmtChar(buf, ' ');
+        fmtHex(buf, hash.crc32, 8);
+        fmtChar(buf, ' ');
+        hashFormat(buf, hash.md5, 16);
+        fmtChar(buf, ' ');
+        hashFormat(buf, hash.sha1, 20);
+        fmtChar(buf, ' ');
+        hashFormat(buf, hash.sha256, 32);
+        fmtChar(buf, ' ');
+        fmtString(buf, it->first);
+        fmtChar(buf, '\n');
+        ret = (fwrite(buf.data, 1, buf.size, fp) == buf.size);
+    }
+    ret = (fclose(fp) == 0) && ret;
+    if(ret) verifyCacheDirty = false;
+
+    return ret;
+}
+
+static bool verifyCacheFind(const std::string path, u64 size, u64 mtime, u32 types, HashResult &result) {
+    std::map<std::string, VerifyCacheEntry>::iterator it = verifyCache.find(path);
+    // without a timestamp a rewritten file of the same size can't be told apart, it is always read again
+    if((mtime == 0) || (it == verifyCache.end()) || (it->second.size != size) || (it->second.mtime != mtime) || (types & ~it->second.hash.types))
+        return false;
+    result = it->second.hash;
+    return true;
+}
+
+static void verifyCacheStore(const std::string path, u64 size, u64 mtime, const HashResult &result) {
+    // digests of other types stay valid as long as the file is unchanged
+    VerifyCacheEntry &entry = verifyCache[path];
+    if((entry.size != size) || (entry.mtime != mtime)) memset(&entry.hash, 0, sizeof(entry.hash));
+    entry.size = size;
+    entry.mtime = mtime;
+    if(result.types & HASH_CRC32) entry.hash.crc32 = result.crc32;
+    if(result.types & HASH_MD5) memcpy(entry.hash.md5, result.md5, sizeof(result.md5));
+    if(result.types & HASH_SHA1) memcpy(entry.hash.sha1, result.sha1, sizeof(result.sha1));
+    if(result.types & HASH_SHA256) memcpy(entry.hash.sha256, result.sha256, sizeof(result.sha256));
+    entry.hash.types |= result.types;
+    verifyCacheDirty = true;
+}
+
+static bool verifyHashFile(const std::string path, u32 size, u64 mtime, u32 types, HashResult &result, std::function<bool(u32 pos)> onProgress) {
+    HashContext ctx;
+    hashInit(ctx, types);
+    if(!fsDataStream(path, 0, size, "Hashing", [&](const u8* data, u32 l_size) {
+            hashUpdate(ctx, data, l_size);
+            if(onProgress(ctx.size)) return true;
+            errno = ECANCELED;
+            return false;
+        }, false)) return false;
+    hashFinal(ctx, result);
+    verifyCacheStore(path, size, mtime, result);
+    return true;
+}
+
+bool verifyIsManifest(const std::string path) {
+    return fsHasExtensions(path, { "sfv", "md5", "sha1", "sha256" });
+}
+
+bool verifyLoadManifest(const std::string path, std::vector<ManifestEntry> &entries) {
+    u32 type = fsHasExtension(path, "sfv") ? HASH_CRC32 : fsHasExtension(path, "md5") ? HASH_MD5 :
+        fsHasExtension(path, "sha1") ? HASH_SHA1 : fsHasExtension(path, "sha256") ? HASH_SHA256 : 0;
+    u32 digestSize = verifyDigestSize(type);
+    entries.clear();
+    if(type == 0) {
+        errno = ENOTSUP;
+        return false;
+    }
+    FILE* fp = fopen(path.c_str(), "r");
+    if(fp == NULL) return false;
+
+    std::string::size_type slashPos = path.rfind('/');
+    std::string dir = (slashPos != std::string::npos) ? path.substr(0, slashPos) : "";
+    char line[VERIFY_LINE_MAX];
+    while(fgets(line, sizeof(line), fp) != NULL) {
+        u32 len = strlen(line);
+        while((len > 0) && strchr("\r\n\t ", line[len - 1])) line[--len] = '\0';
+        char* str = line;
+        if(memcmp(str, "\xEF\xBB\xBF", 3) == 0) str += 3; // UTF-8 BOM
+        while((*str == ' ') || (*str == '\t')) str++;
+        if((*str == '\0') || (*str == ';') || (*str == '#')) continue;
+
+        ManifestEntry entry;
+        entry.type = type;
+        entry.status = V_UNCHECKED;
+        const char* name;
+        u32 nameLen;
+        const char* digest;
+        char* open = strstr(str, " (");
+        char* close = (open != NULL) ? strstr(open, ") = ") : NULL;
+        if(type == HASH_CRC32) { // name CRC32
+            char* space = strrchr(str, ' ');
+            if(space == NULL) continue;
+            name = str;
+            nameLen = space - str;
+            digest = space + 1;
+            while((nameLen > 0) && ((name[nameLen - 1] == ' ') || (name[nameLen - 1] == '\t'))) nameLen--;
+        } else if((close != NULL) && (strcspn(str, " ") == (size_t) (open - str))) { // TYPE (name) = digest
+            for (char* next = close; (next = strstr(next + 1, ") = ")) != NULL; close = next);
+            name = open + 2;
+            nameLen = close - name;
+            digest = close + 4;
+        } else { // digest [*]name
+            if((strlen(str) <= digestSize * 2) || (str[digestSize * 2] != ' ')) continue;
+            digest = str;
+            name = str + (digestSize * 2) + 1;
+            if((*name == ' ') || (*name == '*')) name++;
+            nameLen = strlen(name);
+        }
+        if((strlen(digest) < digestSize * 2) || !verifyParseHex(digest, entry.digest, digestSize) ||
+            ((digest[digestSize * 2] != '\0') && (digest[digestSize * 2] != ' '))) continue;
+
+        entry.name = std::string(name, nameLen);
+        std::replace(entry.name.begin(), entry.name.end(), '\\', '/');
+        while((entry.name.compare(0, 2, "./") == 0) || (entry.name.compare(0, 1, "/") == 0))
+            entry.name.erase(0, (entry.name[0] == '/') ? 1 : 2);
+        if(entry.name.empty()) continue;
+        entry.path = dir + "/" + entry.name;
+        entries.push_back(entry);
+    }
+    fclose(fp);
+
+    if(entries.empty()) {
+        errno = EBADMSG;
+        return false;
+    }
+
+    return true;
+}
+
+bool verifyFileHash(const std::string path, u32 types, HashResult &result, bool* cached, std::function<bool(u32 pos)> onProgress) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) return false;
+    if(S_ISDIR(st.st_mode)) {
+        errno = EISDIR;
+        return false;
+    }
+
+    verifyCacheLoad();
+    u64 mtime = fsGetModifiedTime(path);
+    bool found = verifyCacheFind(path, st.st_size, mtime, types, result);
+    if(cached != NULL) *cached = found;
+
+    return found || verifyHashFile(path, st.st_size, mtime, types, result, [&](u32 pos) {
+        return !onProgress || onProgress(pos);
+    });
+}
+
+bool verifyManifest(const std::string path, std::vector<ManifestEntry> &entries, VerifySummary &summary, bool showProgress) {
+    memset(&summary, 0, sizeof(summary));
+    if(!verifyLoadManifest(path, entries)) return false;
+    verifyCacheLoad();
+
+    auto check = [&](ManifestEntry &entry, const HashResult &result) {
+        u8 crcBytes[4];
+        const u8* digest = verifyDigest(result, entry.type, crcBytes);
+        entry.status = (memcmp(digest, entry.digest, verifyDigestSize(entry.type)) == 0) ? V_PASS : V_FAIL;
+    };
+
+    // files are visited folder by folder in name order, that way the SD card sees as few directory lookups as possible
+    std::vector<u32> order(entries.size());
+    for (u32 i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+        const std::string &pathA = entries[a].path;
+        const std::string &pathB = entries[b].path;
+        std::string::size_type slashA = pathA.rfind('/');
+        std::string::size_type slashB = pathB.rfind('/');
+        int dirCmp = pathA.compare(0, slashA, pathB, 0, slashB);
+        return (dirCmp != 0) ? (dirCmp < 0) : (pathA.compare(slashA, std::string::npos, pathB, slashB, std::string::npos) < 0);
+    });
+
+    // cached and missing files first, only the rest counts for progress
+    std::vector<u32> pending;
+    std::vector<u64> mtimes(entries.size(), 0);
+    std::vector<u32> sizes(entries.size(), 0);
+    u64 total = 0;
+    for (std::vector<u32>::iterator it = order.begin(); it != order.end(); it++) {
+        ManifestEntry &entry = entries[*it];
+        struct stat st;
+        HashResult result;
+        if((stat(entry.path.c_str(), &st) != 0) || S_ISDIR(st.st_mode)) {
+            entry.status = V_MISSING;
+            continue;
+        }
+        mtimes[*it] = fsGetModifiedTime(entry.path);
+        if(verifyCacheFind(entry.path, st.st_size, mtimes[*it], entry.type, result)) {
+            check(entry, result);
+            summary.cached++;
+        } else {
+            sizes[*it] = st.st_size;
+            total += st.st_size;
+            pending.push_back(*it);
+        }
+    }
+
+    bool ret = true;
+    u64 done = 0;
+    for (std::vector<u32>::iterator it = pending.begin(); it != pending.end(); it++) {
+        ManifestEntry &entry = entries[*it];
+        HashResult result;
+        if(showProgress && !fsShowProgress("Verifying", entry.name, done, total + 1)) {
+            errno = ECANCELED;
+            ret = false;
+            break;
+        }
+        if(verifyHashFile(entry.path, sizes[*it], mtimes[*it], entry.type, result, [&](u32 pos) {
+                return !showProgress || fsShowProgress("Verifying", entry.name, done + pos, total + 1);
+            })) {
+            check(entry, result);
+        } else if(errno == ECANCELED) {
+            ret = false;
+            break;
+        } else entry.status = V_ERROR;
+        done += sizes[*it];
+    }
+
+    int err = errno; // a failed cache write doesn't matter to the caller
+    verifyCacheSave();
+    errno = err;
+    for (std::vector<ManifestEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+        if((*it).status == V_PASS) summary.pass++;
+        else if((*it).status == V_FAIL) summary.fail++;
+        else if((*it).status == V_MISSING) summary.missing++;
+        else if((*it).status == V_ERROR) summary.error++;
+    }
+
+    return ret;
+}
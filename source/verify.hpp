@@ -0,0 +1,50 @@
+#ifndef __CTRX_VERIFY_HPP__
+#define __CTRX_VERIFY_HPP__
+
+#include "hash.hpp"
+
+#include <citrus/types.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#define VERIFY_CACHE_DIR "sdmc:/ctrx"
+#define VERIFY_CACHE_PATH VERIFY_CACHE_DIR "/hashcache.txt"
+#define VERIFY_LINE_MAX 1024
+
+typedef enum {
+    V_UNCHECKED,
+    V_PASS,
+    V_FAIL,
+    V_MISSING,
+    V_ERROR
+} VerifyStatus;
+
+typedef struct {
+    std::string name; // as listed in the manifest
+    std::string path; // resolved against the manifest folder
+    u32 type; // one of HASH_*
+    u8 digest[32];
+    VerifyStatus status;
+} ManifestEntry;
+
+typedef struct {
+    u32 pass;
+    u32 fail;
+    u32 missing;
+    u32 error;
+    u32 cached; // files that were not read again
+} VerifySummary;
+
+// manifests are .sfv ("name CRC32"), .md5 / .sha1 / .sha256 ("digest [*]name" or "TYPE (name) = digest")
+// whole file hashes are cached in VERIFY_CACHE_PATH, keyed by path, size and modification time
+// functions return false and set errno on failure, EBADMSG for manifests without a single valid line
+
+bool verifyIsManifest(const std::string path);
+bool verifyLoadManifest(const std::string path, std::vector<ManifestEntry> &entries);
+bool verifyFileHash(const std::string path, u32 types, HashResult &result, bool* cached = NULL, std::function<bool(u32 pos)> onProgress = NULL);
+bool verifyManifest(const std::string path, std::vector<ManifestEntry> &entries, VerifySummary &summary, bool showProgress = false);
+bool verifyCacheSave();
+
+#endif
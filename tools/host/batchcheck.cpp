@@ -0,0 +1,237 @@
+#include "batch.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <utility>
+
+// checks that the strings from batchLayout() put every glyph where the original draws would have put it
+// a recording backend stands in for gput::drawString() and keeps the glyph shown in every cell of the screen
+
+typedef struct {
+    char c;
+    u32 color;
+    float charWidth;
+    float charHeight;
+} RecordedGlyph;
+
+typedef struct {
+    std::map<std::pair<s32, s32>, RecordedGlyph> glyphs; // by position in 1/16 pixel
+    u32 drawCalls;
+} Recorder;
+
+typedef struct {
+    std::string str;
+    float x;
+    float y;
+    float charWidth;
+    float charHeight;
+    u32 color;
+} SceneString;
+
+static u32 rngState = 0x6C078965;
+static u32 failures = 0;
+
+static u32 rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// same layout as gput::drawString(): the first line on top, the last line at y, spaces are blank in the font
+static void recordString(Recorder &rec, const std::string &str, float x, float y, float charWidth, float charHeight, u32 color) {
+    u32 nLines = 1;
+    for (u32 i = 0; i < str.size(); i++) if(str[i] == '\n') nLines++;
+    float cx = x;
+    float cy = y + ((nLines - 1) * charHeight);
+    for (u32 i = 0; i < str.size(); i++) {
+        if(str[i] == '\n') {
+            cx = x;
+            cy -= charHeight;
+            continue;
+        }
+        if(str[i] != ' ') {
+            RecordedGlyph glyph = { str[i], color, charWidth, charHeight };
+            rec.glyphs[std::make_pair((s32) (cx * 16), (s32) (cy * 16))] = glyph;
+        }
+        cx += charWidth;
+    }
+    rec.drawCalls++;
+}
+
+static void recordDirect(Recorder &rec, const std::vector<SceneString> &scene) {
+    for (std::vector<SceneString>::const_iterator it = scene.begin(); it != scene.end(); it++)
+        recordString(rec, it->str, it->x, it->y, it->charWidth, it->charHeight, it->color);
+}
+
+static void recordBatched(Recorder &rec, const std::vector<SceneString> &scene, DrawBatch &batch) {
+    std::vector<BatchString> strings;
+    batchClear(batch);
+    for (std::vector<SceneString>::const_iterator it = scene.begin(); it != scene.end(); it++)
+        batchString(batch, it->str.data(), it->str.size(), it->x, it->y, it->charWidth, it->charHeight,
+                    it->color >> 24, it->color >> 16, it->color >> 8, it->color);
+    u32 nStrings = batchLayout(batch, strings);
+    for (std::vector<BatchString>::iterator it = strings.begin(); it != strings.begin() + nStrings; it++)
+        recordString(rec, it->str, it->x, it->y, it->charWidth, it->charHeight, it->color);
+}
+
+static void checkScene(const char* name, const std::vector<SceneString> &scene, u32 maxDrawCalls) {
+    Recorder direct = { std::map<std::pair<s32, s32>, RecordedGlyph>(), 0 };
+    Recorder batched = { std::map<std::pair<s32, s32>, RecordedGlyph>(), 0 };
+    DrawBatch batch;
+    recordDirect(direct, scene);
+    recordBatched(batched, scene, batch);
+
+    bool same = (direct.glyphs.size() == batched.glyphs.size());
+    std::map<std::pair<s32, s32>, RecordedGlyph>::iterator d = direct.glyphs.begin();
+    std::map<std::pair<s32, s32>, RecordedGlyph>::iterator b = batched.glyphs.begin();
+    for (; same && (d != direct.glyphs.end()); d++, b++) {
+        same = (d->first == b->first) && (d->second.c == b->second.c) && (d->second.color == b->second.color) &&
+            (d->second.charWidth == b->second.charWidth) && (d->second.charHeight == b->second.charHeight);
+        if(!same) printf("FAIL %s: glyph '%c' at (%.2f, %.2f) drawn as '%c' at (%.2f, %.2f)\n", name, d->second.c,
+                         d->first.first / 16.0f, d->first.second / 16.0f, b->second.c, b->first.first / 16.0f, b->first.second / 16.0f);
+    }
+    if(!same) {
+        printf("FAIL %s: %u glyphs drawn directly, %u batched\n", name, (u32) direct.glyphs.size(), (u32) batched.glyphs.size());
+        failures++;
+    }
+
+    if(batched.drawCalls > maxDrawCalls) {
+        printf("FAIL %s: %u draw calls, expected at most %u\n", name, batched.drawCalls, maxDrawCalls);
+        failures++;
+    }
+
+    printf("  %-20s %4u draw calls -> %u\n", name, direct.drawCalls, batched.drawCalls);
+}
+
+// offsets, byte cells and an ASCII column as the hex viewer draws them, a marked range in another color
+static void sceneHexViewer(std::vector<SceneString> &scene) {
+    const char hex[] = "0123456789ABCDEF";
+    for (u32 row = 0; row < 30; row++) {
+        float y = 240 - 8 - (row * 8);
+        char offset[9];
+        for (u32 i = 0; i < 8; i++) offset[i] = hex[((row * 16) >> (28 - (i * 4))) & 0xF];
+        SceneString str = { std::string(offset, 8), 0, y, 8, 8, 0xFFFFFFFF };
+        scene.push_back(str);
+        for (u32 col = 0; col < 8; col++) {
+            u8 value = rng();
+            bool marked = (row >= 10) && (row < 14);
+            SceneString cell = { std::string(1, hex[value >> 4]) + hex[value & 0xF], 72 + (col * 24.0f), y, 8, 8,
+                                 (marked) ? 0x00FF00FFu : 0xFFFFFFFFu };
+            scene.push_back(cell);
+            SceneString ascii = { std::string(1, (value >= 0x21 && value < 0x7F) ? (char) value : '.'), 264 + (col * 8.0f), y, 8, 8, 0xA0A0A0FF };
+            scene.push_back(ascii);
+        }
+    }
+}
+
+// multi-line strings in several sizes and colors, off-grid positions, rows apart so only equal styles overlap
+static void sceneRandom(std::vector<SceneString> &scene) {
+    const u32 colors[] = { 0xFFFFFFFF, 0xFF0000FF, 0x00FF00FF };
+    const float sizes[] = { 8, 12, 5.5f };
+    float y = 0;
+    for (u32 i = 0; i < 60; i++) {
+        SceneString str;
+        u32 nLines = 1 + (rng() % 3);
+        for (u32 l = 0; l < nLines; l++) {
+            if(l > 0) str.str += '\n';
+            u32 length = rng() % 12;
+            for (u32 c = 0; c < length; c++) str.str += (rng() % 4) ? (char) ('a' + (rng() % 26)) : ' ';
+        }
+        u32 style = rng() % 3;
+        str.charWidth = sizes[style];
+        str.charHeight = sizes[style];
+        str.color = colors[style];
+        str.x = (rng() % 40) * 0.75f;
+        str.y = y;
+        y += (nLines + 1) * 12;
+        scene.push_back(str);
+    }
+}
+
+// the same cells drawn twice in one style, the later glyph wins like it does on screen
+static void sceneOverdraw(std::vector<SceneString> &scene) {
+    SceneString first = { "aaaaaaaa\nbbbbbbbb", 16, 16, 8, 8, 0xFFFFFFFF };
+    SceneString second = { "  XX\n    YY", 16, 16, 8, 8, 0xFFFFFFFF };
+    SceneString third = { "Z", 24, 24, 8, 8, 0xFFFFFFFF };
+    scene.push_back(first);
+    scene.push_back(second);
+    scene.push_back(third);
+}
+
+static void checkRectangles() {
+    DrawBatch batch;
+    batchClear(batch);
+    batchRectangle(batch, 10, 20, 30, 40, 0xFF, 0x80, 0x00, 0xFF);
+    batchRectangle(batch, 0, 0, 0, 8, 0xFF, 0xFF, 0xFF, 0xFF); // empty, dropped
+    batchRectangle(batch, 0, 0, 8, 8, 0xFF, 0xFF, 0xFF, 0x00); // invisible, dropped
+    if(batch.quads.size() != BATCH_QUAD_FLOATS) {
+        printf("FAIL rectangles: %u floats, expected %u\n", (u32) batch.quads.size(), BATCH_QUAD_FLOATS);
+        failures++;
+        return;
+    }
+
+    float minX = 1e9f, minY = 1e9f, maxX = -1e9f, maxY = -1e9f;
+    for (u32 v = 0; v < 6; v++) {
+        const float* vertex = &batch.quads[v * 9];
+        if(vertex[0] < minX) minX = vertex[0];
+        if(vertex[0] > maxX) maxX = vertex[0];
+        if(vertex[1] < minY) minY = vertex[1];
+        if(vertex[1] > maxY) maxY = vertex[1];
+        if((vertex[5] != 1.0f) || (vertex[8] != 1.0f)) {
+            printf("FAIL rectangles: wrong vertex color\n");
+            failures++;
+        }
+    }
+    if((minX != 10) || (minY != 20) || (maxX != 40) || (maxY != 60)) {
+        printf("FAIL rectangles: bounds (%g, %g) - (%g, %g), expected (10, 20) - (40, 60)\n", minX, minY, maxX, maxY);
+        failures++;
+    }
+}
+
+// redraws are skipped by comparing hashes, so the same content has to give the same hash and any change another one
+static void checkHash() {
+    DrawBatch batch0;
+    DrawBatch batch1;
+    batchClear(batch0);
+    batchClear(batch1);
+    batchString(batch0, "hello", 5, 8, 8, 8, 8, 0xFF, 0xFF, 0xFF, 0xFF);
+    batchString(batch1, "hello", 5, 8, 8, 8, 8, 0xFF, 0xFF, 0xFF, 0xFF);
+    if(batch0.hash != batch1.hash) {
+        printf("FAIL hash: same content, different hash\n");
+        failures++;
+    }
+
+    batchClear(batch1);
+    batchString(batch1, "hellp", 5, 8, 8, 8, 8, 0xFF, 0xFF, 0xFF, 0xFF);
+    u64 changedChar = batch1.hash;
+    batchClear(batch1);
+    batchString(batch1, "hello", 5, 8, 16, 8, 8, 0xFF, 0xFF, 0xFF, 0xFF);
+    u64 changedPosition = batch1.hash;
+    batchClear(batch1);
+    batchString(batch1, "hello", 5, 8, 8, 8, 8, 0xFF, 0xFF, 0xFE, 0xFF);
+    u64 changedColor = batch1.hash;
+    if((changedChar == batch0.hash) || (changedPosition == batch0.hash) || (changedColor == batch0.hash)) {
+        printf("FAIL hash: changed content, same hash\n");
+        failures++;
+    }
+}
+
+int main() {
+    std::vector<SceneString> scene;
+    sceneHexViewer(scene);
+    checkScene("hex viewer", scene, 3);
+    scene.clear();
+    sceneRandom(scene);
+    checkScene("random strings", scene, 3 * 40);
+    scene.clear();
+    sceneOverdraw(scene);
+    checkScene("overdraw", scene, 1);
+    checkRectangles();
+    checkHash();
+
+    printf("batchcheck: %s (%u failures)\n", (failures == 0) ? "OK" : "FAILED", failures);
+    return (failures == 0) ? 0 : 1;
+}
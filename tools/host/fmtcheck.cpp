@@ -0,0 +1,161 @@
+#include "fmt.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+// checks the fmt.cpp formatters against std::stringstream and counts heap allocations while they run
+// per-frame UI text goes through fmt, so formatting must never allocate
+
+static u32 allocations = 0;
+static u32 failures = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* ptr = malloc((size > 0) ? size : 1);
+    if(ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+static u32 rngState = 0x2545F491;
+
+static u32 rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+static void check(const char* name, const char* got, const std::string &expected) {
+    if(expected.compare(got) == 0) return;
+    if(failures++ < 20) printf("FAIL %s: got \"%s\", expected \"%s\"\n", name, got, expected.c_str());
+}
+
+// same as uiFormatBytes() before it went through fmtBytes()
+static std::string refBytes(u64 bytes) {
+    const char* units[] = {" byte", "kB", "MB", "GB"};
+    std::stringstream ss;
+    if(bytes < 1024) ss << bytes << units[0];
+    else {
+        int scale = 1;
+        u64 bytes100 = (bytes * 100) >> 10;
+        for(; (bytes100 >= 1024*100) && (scale < 3); scale++, bytes100 >>= 10);
+        ss << (bytes100 / 100) << "." << std::setfill('0') << std::setw(2) << (bytes100 % 100) << units[scale];
+    }
+    return ss.str();
+}
+
+// a typical detail line, "@0000ABCD (43981)", as the viewers show it
+static void formatOffset(FmtBuffer &buf, u32 offset) {
+    fmtChar(buf, '@');
+    fmtHex(buf, offset, 8);
+    fmtString(buf, " (");
+    fmtDec(buf, offset);
+    fmtChar(buf, ')');
+}
+
+static void checkOutput() {
+    char str[64];
+    FmtBuffer buf;
+    for (u32 i = 0; i < 100000; i++) {
+        u32 value = rng() >> (rng() % 32);
+        u64 value64 = ((u64) rng() << 32 | rng()) >> (rng() % 64);
+        u32 digits = 1 + (rng() % 8);
+        u32 width = rng() % 24;
+
+        std::stringstream ss;
+        ss << std::hex << std::uppercase << std::setfill('0') << std::setw(8) << value;
+        fmtStart(buf, str, sizeof(str));
+        fmtHex(buf, value, digits);
+        check("fmtHex", str, ss.str().substr(8 - digits));
+
+        ss.str("");
+        ss << std::dec << std::setfill(' ') << std::setw(width) << value64;
+        fmtStart(buf, str, sizeof(str));
+        fmtDec(buf, value64, width);
+        check("fmtDec", str, ss.str());
+
+        fmtStart(buf, str, sizeof(str));
+        fmtBytes(buf, value64);
+        check("fmtBytes", str, refBytes(value64));
+
+        ss.str("");
+        ss << "@" << std::setfill('0') << std::uppercase << std::hex << std::setw(8) << value << " (" << std::dec << value << ")";
+        fmtStart(buf, str, sizeof(str));
+        formatOffset(buf, value);
+        check("offset", str, ss.str());
+    }
+
+    // cut off, but always terminated
+    char small[8];
+    fmtStart(buf, small, sizeof(small));
+    fmtString(buf, "0123456789");
+    fmtDec(buf, 42);
+    check("cut off", small, "0123456");
+    fmtStart(buf, str, sizeof(str));
+    fmtTruncate(buf, "a_rather_long_file_name.bin", 16, -8);
+    check("fmtTruncate", str, "a_rath...ame.bin");
+}
+
+// the formatting done for one frame of the hex viewer and the details, into stack buffers and reused strings
+static void checkAllocations() {
+    std::string detail(64, ' '); // room for any detail, as the viewers reserve it up front
+    u8 data[16 * 30];
+    for (u32 i = 0; i < sizeof(data); i++) data[i] = rng();
+
+    allocations = 0;
+    for (u32 frame = 0; frame < 1000; frame++) {
+        char line[80];
+        FmtBuffer buf;
+        for (u32 row = 0; row < 30; row++) {
+            fmtStart(buf, line, sizeof(line));
+            fmtHex(buf, (frame * 16 * 30) + (row * 16), 8);
+            fmtChar(buf, ' ');
+            for (u32 col = 0; col < 16; col++) fmtHex(buf, data[(row * 16) + col], 2);
+            fmtChar(buf, ' ');
+            fmtString(buf, (const char*) data + (row * 16), 16);
+        }
+
+        fmtStart(buf, line, sizeof(line));
+        formatOffset(buf, frame * 0x1234567);
+        detail.assign(buf.data, buf.size);
+        fmtStart(buf, line, sizeof(line));
+        fmtString(buf, "free: ");
+        fmtBytes(buf, (u64) frame << 24);
+        fmtChar(buf, ' ');
+        fmtTruncate(buf, detail, 12, -4);
+        detail.assign(buf.data, buf.size);
+    }
+
+    if(allocations != 0) {
+        failures++;
+        printf("FAIL %u heap allocations in 1000 frames, expected none\n", allocations);
+    }
+
+    // make sure the counter sees allocations at all
+    std::string probe;
+    probe.reserve(256);
+    if(allocations == 0) {
+        failures++;
+        printf("FAIL allocation counter is not hooked up\n");
+    }
+}
+
+int main() {
+    checkOutput();
+    checkAllocations();
+    printf("fmtcheck: %s (%u failures)\n", (failures == 0) ? "OK" : "FAILED", failures);
+    return (failures == 0) ? 0 : 1;
+}
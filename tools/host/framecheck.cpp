@@ -0,0 +1,173 @@
+#include "batch.hpp"
+#include "fmt.hpp"
+#include "text.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <new>
+
+// draws text viewer frames the way drawText() in ui.cpp does (glyphs, search hits, one batch per screen)
+// and counts heap allocations, once the first pass over the text is done no frame may allocate
+// also checks textSearchRange() against a plain search, with hits across its read buffer boundaries
+
+#define TEST_FILE "framecheck.txt"
+#define LINES_DISP 30
+#define CHARS_DISP 40
+
+static u32 allocations = 0;
+static u32 failures = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* ptr = malloc((size > 0) ? size : 1);
+    if(ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+// fs.cpp needs the platform, text.cpp only needs this
+u32 fsGetFileSize(const std::string path) {
+    struct stat st;
+    return (stat(path.c_str(), &st) == 0) ? (u32) st.st_size : 0;
+}
+
+static u32 rngState = 0x9E3779B9;
+
+static u32 rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// words of all lengths, some of them the search term, lines short and long
+static std::string makeText() {
+    const char* words[] = { "the", "The", "then", "other", "a", "lorem", "ipsum", "x_the", "THE" };
+    std::string str;
+    for (u32 l = 0; l < 2000; l++) {
+        u32 nWords = (l % 97 == 0) ? 1500 : rng() % 16;
+        for (u32 w = 0; w < nWords; w++) {
+            if(w > 0) str += ' ';
+            str += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        }
+        str += '\n';
+    }
+    return str;
+}
+
+static void drawFrame(TextFile &text, TextSearch &search, u32 offsetDisp, DrawBatch &batch, std::vector<BatchString> &strings,
+                      std::vector<u32> &lineStarts, std::vector<u32> &lineHits) {
+    lineStarts.clear();
+    lineStarts.push_back(offsetDisp);
+    for (u32 l = 0; l < LINES_DISP; l++) lineStarts.push_back(textLineNext(text, lineStarts.back(), CHARS_DISP));
+
+    batchClear(batch);
+    char dispData[((CHARS_DISP + 1) * LINES_DISP) + 1];
+    FmtBuffer dispString;
+    fmtStart(dispString, dispData, sizeof(dispData));
+    for (u32 l = 0; l < LINES_DISP; l++) {
+        u32 dispStart = lineStarts.at(l);
+        u32 dispEnd = textGetGlyphs(text, dispStart, lineStarts.at(l + 1), dispString, CHARS_DISP);
+        if(l < LINES_DISP - 1) fmtChar(dispString, '\n');
+        lineHits.clear();
+        textSearchRange(text, search, dispStart, dispEnd, lineHits);
+        for (std::vector<u32>::iterator it = lineHits.begin(); it != lineHits.end(); it++) {
+            u32 c0 = (*it > dispStart) ? textCharCount(text, dispStart, *it) : 0;
+            u32 c1 = textCharCount(text, dispStart, (*it + search.term.size() < dispEnd) ? *it + search.term.size() : dispEnd);
+            if(c0 < c1) batchRectangle(batch, c0 * 8, (LINES_DISP - 1 - l) * 8, (c1 - c0) * 8, 8, 0x80, 0x80, 0x80, 0xFF);
+        }
+    }
+    batchString(batch, dispString.data, dispString.size, 0, 0, 8, 8, 0xFF, 0xFF, 0xFF, 0xFF);
+    batchLayout(batch, strings);
+}
+
+static void checkFrames(TextFile &text, TextSearch &search) {
+    DrawBatch batch;
+    std::vector<BatchString> strings;
+    std::vector<u32> lineStarts;
+    std::vector<u32> lineHits;
+    u32 frames = 0;
+    u32 steady = 0;
+    for (u32 pass = 0; pass < 2; pass++) {
+        u32 before = allocations;
+        frames = 0;
+        for (u32 offset = text.start; offset < text.size; offset = textLineNext(text, offset, CHARS_DISP), frames++)
+            drawFrame(text, search, offset, batch, strings, lineStarts, lineHits);
+        steady = allocations - before;
+    }
+    if(steady != 0) {
+        printf("FAIL frames: %u allocations in %u steady frames\n", steady, frames);
+        failures++;
+    }
+    printf("  %u frames, %u allocations after the first pass\n", frames, steady);
+}
+
+static void checkRange(TextFile &text, TextSearch &search, const std::string &str) {
+    std::vector<u32> hits;
+    std::vector<u32> ref;
+    const std::string term = "the";
+    for (u32 i = 0; i + term.size() <= str.size(); i++) {
+        if(strncasecmp(str.c_str() + i, term.c_str(), term.size()) != 0) continue;
+        bool before = (i > 0) && (((str[i - 1] | 0x20) >= 'a' && (str[i - 1] | 0x20) <= 'z') || (str[i - 1] == '_'));
+        bool after = (i + term.size() < str.size()) && (((str[i + term.size()] | 0x20) >= 'a' && (str[i + term.size()] | 0x20) <= 'z') || (str[i + term.size()] == '_'));
+        if(!before && !after) ref.push_back(i);
+    }
+
+    // whole file in one call, then in random pieces, hits overlapping a piece are found in it
+    textSearchRange(text, search, text.start, text.size, hits);
+    if(hits != ref) {
+        printf("FAIL range: %u hits in the whole text, expected %u\n", (u32) hits.size(), (u32) ref.size());
+        failures++;
+    }
+    for (u32 i = 0; i < 200; i++) {
+        u32 offset = rng() % text.size;
+        u32 end = offset + 1 + (rng() % (3 * TEXT_RANGE_BUFSIZ));
+        if(end > text.size) end = text.size;
+        hits.clear();
+        textSearchRange(text, search, offset, end, hits);
+        std::vector<u32> expected;
+        for (std::vector<u32>::iterator it = ref.begin(); it != ref.end(); it++)
+            if((*it + term.size() > offset) && (*it < end)) expected.push_back(*it);
+        if(hits != expected) {
+            if(failures++ < 20) printf("FAIL range: [%u, %u) %u hits, expected %u\n", offset, end, (u32) hits.size(), (u32) expected.size());
+        }
+    }
+}
+
+int main() {
+    std::string str = makeText();
+    FILE* fp = fopen(TEST_FILE, "wb");
+    if((fp == NULL) || (fwrite(str.data(), 1, str.size(), fp) != str.size())) {
+        printf("can't write " TEST_FILE "\n");
+        return 1;
+    }
+    fclose(fp);
+
+    TextFile text;
+    TextSearch search;
+    if(!textOpen(text, TEST_FILE)) {
+        printf("can't open " TEST_FILE "\n");
+        return 1;
+    }
+    while(!textIndexDone(text)) textIndexStep(text, TEXT_INDEX_BUFSIZ);
+    textSearchStart(text, search, "the", true, true);
+    while(!textSearchDone(text, search)) textSearchStep(text, search, TEXT_INDEX_BUFSIZ);
+
+    checkRange(text, search, str);
+    checkFrames(text, search);
+    textClose(text);
+    remove(TEST_FILE);
+
+    printf("framecheck: %s (%u failures)\n", (failures == 0) ? "OK" : "FAILED", failures);
+    return (failures == 0) ? 0 : 1;
+}
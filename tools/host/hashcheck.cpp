@@ -0,0 +1,160 @@
+#include "hash.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// checks the CRC32 / MD5 / SHA-1 / SHA-256 kernels against known digests (as given by zlib / hashlib)
+// every vector is hashed in one go and in random chunks, also with each algorithm on its own
+// 'hashcheck bench' also times each algorithm and all of them in one pass on a large buffer
+
+typedef struct {
+    const char* name;
+    const char* data; // NULL for the generated pattern
+    u32 size;
+    u32 repeat;
+    const char* crc32;
+    const char* md5;
+    const char* sha1;
+    const char* sha256;
+} HashVector;
+
+static const HashVector vectors[] = {
+    { "empty", "", 0, 1, "00000000", "D41D8CD98F00B204E9800998ECF8427E", "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709",
+      "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855" },
+    { "abc", "abc", 3, 1, "352441C2", "900150983CD24FB0D6963F7D28E17F72", "A9993E364706816ABA3E25717850C26C9CD0D89D",
+      "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD" },
+    { "quick brown fox", "The quick brown fox jumps over the lazy dog", 43, 1, "414FA339", "9E107D9D372BB6826BD81D3542A419D6",
+      "2FD4E1C67A2D28FCED849EE1BB76E7391B93EB12", "D7A8FBB307D7809469CA9ABCB0082E4F8D5651E46D3CDB762D02D0BF37C9E592" },
+    { "448 bit", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, 1, "171A3F5F", "8215EF0796A20BCAAAE116D3876C664A",
+      "84983E441C3BD26EBAAE4AA1F95129E5E54670F1", "248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1" },
+    { "million a", "a", 1, 1000000, "DC25BFBC", "7707D6AE4E027C70EEA2A935C2296F21", "34AA973CD4C4DAA4F61EEB2BDBAD27316534016F",
+      "CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0" },
+    // (i * 7 + 3) & 0xFF, sizes around the padding boundaries
+    { "pattern 55", NULL, 55, 1, "30C94412", "52C0E574E1198DE5FE3F8F11440DCB1B", "DDF57317EF34BFEE3B6DF83D359098930EB278BC",
+      "E7313D333C272E639F790978283F9EB392E843D0F29B7016828BB1DAA4AAC70B" },
+    { "pattern 56", NULL, 56, 1, "CB5E10B8", "46C9907FC908EE68B1E7B8E71286A518", "A0D492BB0FC889D0ECA3BC137066AB6F4F74F369",
+      "4324D65F3C103567F5589C710BC08F8523F929A9272E3AF36FC968E52ABC6C27" },
+    { "pattern 63", NULL, 63, 1, "B7350C2A", "A62F6D59E837867693F042F5B8F5A236", "C55856749BEF509BDFE6BFEBFC7BF4E793E82132",
+      "81C80242132F230C3BD41B3E63BBCFF16107339549214A99614FF26664625055" },
+    { "pattern 64", NULL, 64, 1, "CBD9ECF0", "7160B8FB5E9E4023D549C3971FBAEEAD", "BEDE92BE29C3874E1B54DDC77988D606FC857A8E",
+      "39E3D7B6B5D075D37D053AD89B24B41BEF4F3C29760C84447CAB3F3BE1882241" },
+    { "pattern 65", NULL, 65, 1, "6D195777", "70BD662E7AEFBDA85A0F7244167B7897", "B05A80522B053D6DC7E0A517D0E70212C7DAD11F",
+      "AACCA6FF74FDBB296D165A45CECFA04E5127BC008770FBBDD48006F2D2FAE95E" },
+    { "pattern 119", NULL, 119, 1, "FD968703", "E84905D4214F4D1CA56C2CDCC152B143", "504E27376A6E0F0DBA8295B85CB25DC4DFA17D23",
+      "9CE7368E4DAF32341631B492E80359DC9F594B48453CD0DD5BF0B19279CC177E" },
+    { "pattern 120", NULL, 120, 1, "3A47AD39", "E3EB5A6C8669EA01A8C185B8ABC8A5DC", "82134B02FB3F702491BE9BED581EEAB59334ACB2",
+      "7836B787757E95E58B3CA5AEC90B1B004E8DEBA1E50E9675AF9CABF1A13A04B5" },
+    { "pattern 127", NULL, 127, 1, "EFB66DAA", "ACCE2474D6CC8302120D09C818D17EF7", "34D5E582029E9B9B85B2FEBE31DA3DB7CDABAAEA",
+      "A8D23E75D936F303D248888D9B165EE543F4CBAFCAD3C9DD2A79BD84FAA11D07" },
+    { "pattern 128", NULL, 128, 1, "BD5D2E01", "10B2DA1A82F16D99A81A7203FE9F02CB", "A09133E6730FFE899EFB70204CB5646CD5DC24EE",
+      "D2742F1F4AC6BB7CA2B239EE18402BA8B3F9F8E652D2A72973C2B9BA11C08CF6" },
+    { "pattern 129", NULL, 129, 1, "D10950AF", "03FEFBBCEBE2959CF2270241AAFE0250", "808AEA332CE367541D37ADAE7F94E59C5C1A934E",
+      "307F8FC2C1622B92762E818D39A185D4D667AD49A4B07CEAE1F4AFA008A93EC4" },
+    { "pattern 1000", NULL, 1000, 1, "17BC2A46", "10046F077F2082AC19676B8079F1CB1A", "4231A8A50A10FA9758DB8EC71FDEF855B751048A",
+      "1E9BC38CBF860B9EC31918B065F9B52476C549A782E0E7990BED8CE3868D2371" },
+};
+
+static u32 rngState = 0x9E3779B9;
+static u32 failures = 0;
+
+static u32 rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// chunk 0 hashes everything in one call, otherwise chunks are random sizes up to chunk
+static void hashBuffer(HashResult &result, const u8* data, u32 size, u32 types, u32 chunk) {
+    HashContext ctx;
+    hashInit(ctx, types);
+    for (u32 pos = 0; pos < size;) {
+        u32 step = (chunk == 0) ? size - pos : 1 + (rng() % chunk);
+        if(step > size - pos) step = size - pos;
+        hashUpdate(ctx, data + pos, step);
+        pos += step;
+    }
+    hashFinal(ctx, result);
+}
+
+static void checkDigest(const char* vector, const char* algorithm, u32 chunk, const u8* digest, u32 size, const char* expected) {
+    char data[80];
+    FmtBuffer buf;
+    fmtStart(buf, data, sizeof(data));
+    hashFormat(buf, digest, size);
+    if(strcmp(buf.data, expected) == 0) return;
+    if(failures++ < 20) printf("FAIL %s, %s, chunks of up to %u: got %s, expected %s\n", vector, algorithm, chunk, buf.data, expected);
+}
+
+#define BENCH_SIZE (16 * 1024 * 1024)
+#define BENCH_CHUNK (512 * 1024) // as fsDataStream() hands it over
+
+static double benchNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static volatile u32 benchSink;
+
+static void bench() {
+    const struct {
+        const char* name;
+        u32 types;
+    } benches[] = { { "CRC32", HASH_CRC32 }, { "MD5", HASH_MD5 }, { "SHA-1", HASH_SHA1 }, { "SHA-256", HASH_SHA256 }, { "all", HASH_ALL } };
+    u8* data = (u8*) malloc(BENCH_SIZE);
+    if(!data) {
+        printf("out of memory\n");
+        exit(1);
+    }
+    for (u32 i = 0; i < BENCH_SIZE; i++) data[i] = (u8) rng();
+    const u32 rounds = 4;
+
+    for (u32 b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+        double start = benchNow();
+        for (u32 r = 0; r < rounds; r++) {
+            HashContext ctx;
+            HashResult result;
+            hashInit(ctx, benches[b].types);
+            for (u32 pos = 0; pos < BENCH_SIZE; pos += BENCH_CHUNK) hashUpdate(ctx, data + pos, BENCH_CHUNK);
+            hashFinal(ctx, result);
+            benchSink = benchSink + result.crc32 + result.md5[0] + result.sha1[0] + result.sha256[0];
+        }
+        double secs = benchNow() - start;
+        printf("%-16s %8.1f MiB/s\n", benches[b].name, (rounds * (double) BENCH_SIZE) / (secs * 1024 * 1024));
+    }
+
+    free(data);
+}
+
+int main(int argc, char** argv) {
+    const u32 chunks[] = { 0, 1, 7, 64, 100, 4096 };
+    const u32 types[] = { HASH_ALL, HASH_CRC32, HASH_MD5, HASH_SHA1, HASH_SHA256 };
+
+    for (u32 v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        const HashVector &vector = vectors[v];
+        u32 size = vector.size * vector.repeat;
+        u8* data = (u8*) malloc(size + 1);
+        for (u32 i = 0; i < size; i++) data[i] = (vector.data) ? (u8) vector.data[i % vector.size] : (u8) ((i * 7) + 3);
+
+        for (u32 c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            for (u32 t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+                HashResult result;
+                hashBuffer(result, data, size, types[t], chunks[c]);
+                u8 crc32[4] = { (u8) (result.crc32 >> 24), (u8) (result.crc32 >> 16), (u8) (result.crc32 >> 8), (u8) result.crc32 };
+                if(types[t] & HASH_CRC32) checkDigest(vector.name, "CRC32", chunks[c], crc32, 4, vector.crc32);
+                if(types[t] & HASH_MD5) checkDigest(vector.name, "MD5", chunks[c], result.md5, 16, vector.md5);
+                if(types[t] & HASH_SHA1) checkDigest(vector.name, "SHA-1", chunks[c], result.sha1, 20, vector.sha1);
+                if(types[t] & HASH_SHA256) checkDigest(vector.name, "SHA-256", chunks[c], result.sha256, 32, vector.sha256);
+            }
+        }
+
+        free(data);
+    }
+
+    printf("hashcheck: %s (%u failures)\n", (failures == 0) ? "OK" : "FAILED", failures);
+    if((argc > 1) && (strcmp(argv[1], "bench") == 0)) bench();
+    return (failures == 0) ? 0 : 1;
+}
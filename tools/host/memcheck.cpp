@@ -0,0 +1,298 @@
+#include "mem.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// checks the mem.cpp byte kernels against plain byte loops, for all sizes up to MAX_SIZE and all alignments
+// 'memcheck bench' also times them on a large buffer
+// the kernels are written for the ARM11, which has no vector unit: on a desktop CPU the compiler turns the simple
+// byte loops (count, add, invert, swap) into SSE / NEON code, which beats the word loops there
+// build with -fno-tree-vectorize to compare them the way the console sees them
+
+#define MAX_SIZE 300
+#define PAD 16
+#define BENCH_SIZE (16 * 1024 * 1024)
+
+static u32 rngState = 0x12345678;
+static u32 failures = 0;
+
+static u32 rng() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+// small alphabets give plenty of matches, the full range covers the high bit
+static void fillRandom(u8* data, u32 size, u32 alphabet) {
+    for (u32 i = 0; i < size; i++) data[i] = (alphabet < 256) ? 'a' + (rng() % alphabet) : (u8) rng();
+}
+
+static void check(bool ok, const char* name, u32 size, u32 align, u32 got, u32 expected) {
+    if(ok) return;
+    if(failures++ < 20) printf("FAIL %s: size %u, align %u, got %u, expected %u\n", name, size, align, got, expected);
+}
+
+static u32 refFindByte(const u8* data, u32 size, u8 value) {
+    for (u32 i = 0; i < size; i++) if(data[i] == value) return i;
+    return (u32) -1;
+}
+
+static u32 refFindLastByte(const u8* data, u32 size, u8 value) {
+    for (u32 i = size; i > 0; i--) if(data[i - 1] == value) return i - 1;
+    return (u32) -1;
+}
+
+static u32 refFindAnyOf(const u8* data, u32 size, const u8* values, u32 nValues) {
+    for (u32 i = 0; i < size; i++)
+        for (u32 v = 0; v < nValues; v++) if(data[i] == values[v]) return i;
+    return (u32) -1;
+}
+
+static u32 refFind(const u8* data, u32 size, const u8* term, u32 termSize) {
+    if((termSize == 0) || (termSize > size)) return (u32) -1;
+    for (u32 i = 0; i + termSize <= size; i++) if(memcmp(data + i, term, termSize) == 0) return i;
+    return (u32) -1;
+}
+
+static u32 refMismatch(const u8* data0, const u8* data1, u32 size) {
+    for (u32 i = 0; i < size; i++) if(data0[i] != data1[i]) return i;
+    return (u32) -1;
+}
+
+static u32 refCountByte(const u8* data, u32 size, u8 value) {
+    u32 count = 0;
+    for (u32 i = 0; i < size; i++) if(data[i] == value) count++;
+    return count;
+}
+
+static bool refIsAll(const u8* data, u32 size, u8 value) {
+    for (u32 i = 0; i < size; i++) if(data[i] != value) return false;
+    return true;
+}
+
+static void refFillPattern(u8* data, u32 size, const u8* pattern, u32 patternSize) {
+    for (u32 i = 0, p = 0; i < size; i++, p = (p + 1 < patternSize) ? p + 1 : 0) data[i] = pattern[p];
+}
+
+static void refXorPattern(u8* data, u32 size, const u8* pattern, u32 patternSize) {
+    for (u32 i = 0, p = 0; i < size; i++, p = (p + 1 < patternSize) ? p + 1 : 0) data[i] ^= pattern[p];
+}
+
+static void refAddByte(u8* data, u32 size, u8 value) {
+    for (u32 i = 0; i < size; i++) data[i] += value;
+}
+
+static void refInvert(u8* data, u32 size) {
+    for (u32 i = 0; i < size; i++) data[i] = ~data[i];
+}
+
+static void refSwap(u8* data, u32 size, u32 unit) {
+    for (u32 i = 0; i + unit <= size; i += unit)
+        for (u32 j = 0; j < unit / 2; j++) {
+            u8 tmp = data[i + j];
+            data[i + j] = data[i + unit - 1 - j];
+            data[i + unit - 1 - j] = tmp;
+        }
+}
+
+static u32 refCrc32(u32 crc, const u8* data, u32 size) {
+    crc = ~crc;
+    for (u32 i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (u32 b = 0; b < 8; b++) crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+static void checkSearch(const u8* data, u32 size, u32 align) {
+    u8 value = data[(size > 0) ? rng() % size : 0];
+    u8 absent = 'z' + 1; // absent unless the full byte range is used
+    check(memFindByte(data, size, value) == refFindByte(data, size, value), "memFindByte", size, align,
+          memFindByte(data, size, value), refFindByte(data, size, value));
+    check(memFindByte(data, size, absent) == refFindByte(data, size, absent), "memFindByte (absent)", size, align,
+          memFindByte(data, size, absent), refFindByte(data, size, absent));
+    check(memFindLastByte(data, size, value) == refFindLastByte(data, size, value), "memFindLastByte", size, align,
+          memFindLastByte(data, size, value), refFindLastByte(data, size, value));
+    check(memCountByte(data, size, value) == refCountByte(data, size, value), "memCountByte", size, align,
+          memCountByte(data, size, value), refCountByte(data, size, value));
+
+    for (u32 nValues = 0; nValues <= 6; nValues++) {
+        u8 values[6];
+        for (u32 v = 0; v < nValues; v++) values[v] = 'a' + 8 + (rng() % 24); // mostly rare values
+        check(memFindAnyOf(data, size, values, nValues) == refFindAnyOf(data, size, values, nValues), "memFindAnyOf", size, align,
+              memFindAnyOf(data, size, values, nValues), refFindAnyOf(data, size, values, nValues));
+    }
+
+    for (u32 termSize = 0; termSize <= 5; termSize++) {
+        u8 term[5];
+        if((size >= termSize) && (rng() & 1)) memcpy(term, data + (rng() % (size - termSize + 1)), termSize);
+        else fillRandom(term, termSize, 4);
+        check(memFind(data, size, term, termSize) == refFind(data, size, term, termSize), "memFind", size, align,
+              memFind(data, size, term, termSize), refFind(data, size, term, termSize));
+    }
+
+    bool allSame = (refCountByte(data, size, 'a') == size);
+    check(memIsAll(data, size, 'a') == allSame, "memIsAll", size, align, memIsAll(data, size, 'a'), allSame);
+
+    u32 crc = rng();
+    check(memCrc32(crc, data, size) == refCrc32(crc, data, size), "memCrc32", size, align,
+          memCrc32(crc, data, size), refCrc32(crc, data, size));
+}
+
+static void checkMismatch(u8* data0, u8* data1, u32 size, u32 align) {
+    memcpy(data1, data0, size);
+    check(memMismatch(data0, data1, size) == (u32) -1, "memMismatch (equal)", size, align, memMismatch(data0, data1, size), (u32) -1);
+    if(size == 0) return;
+    data1[rng() % size] ^= 1 << (rng() % 8);
+    check(memMismatch(data0, data1, size) == refMismatch(data0, data1, size), "memMismatch", size, align,
+          memMismatch(data0, data1, size), refMismatch(data0, data1, size));
+}
+
+static void checkTransforms(const u8* data, u32 size, u32 align) {
+    u8 ref[MAX_SIZE + PAD];
+    u8 out[MAX_SIZE + PAD];
+    u8* dst = out + align;
+    u8 pattern[7];
+    fillRandom(pattern, sizeof(pattern), 256);
+
+    for (u32 patternSize = 1; patternSize <= sizeof(pattern); patternSize++) {
+        u32 phase = rng() % 16;
+        for (u32 i = 0; i < size; i++) ref[i] = pattern[(phase + i) % patternSize];
+        memFillPattern(dst, size, pattern, patternSize, phase);
+        check(memcmp(dst, ref, size) == 0, "memFillPattern", size, align, refMismatch(dst, ref, size), (u32) -1);
+
+        for (u32 i = 0; i < size; i++) ref[i] = data[i] ^ pattern[(phase + i) % patternSize];
+        memcpy(dst, data, size);
+        memXorPattern(dst, size, pattern, patternSize, phase);
+        check(memcmp(dst, ref, size) == 0, "memXorPattern", size, align, refMismatch(dst, ref, size), (u32) -1);
+    }
+
+    for (u32 i = 0; i < size; i++) ref[i] = data[i] + pattern[0];
+    memcpy(dst, data, size);
+    memAddByte(dst, size, pattern[0]);
+    check(memcmp(dst, ref, size) == 0, "memAddByte", size, align, refMismatch(dst, ref, size), (u32) -1);
+
+    for (u32 i = 0; i < size; i++) ref[i] = ~data[i];
+    memcpy(dst, data, size);
+    memInvert(dst, size);
+    check(memcmp(dst, ref, size) == 0, "memInvert", size, align, refMismatch(dst, ref, size), (u32) -1);
+
+    for (u32 unit = 2; unit <= 8; unit *= 2) {
+        u32 swapSize = size - (size % unit);
+        for (u32 i = 0; i < swapSize; i++) ref[i] = data[(i - (i % unit)) + (unit - 1 - (i % unit))];
+        memcpy(dst, data, swapSize);
+        memSwap(dst, swapSize, unit);
+        check(memcmp(dst, ref, swapSize) == 0, "memSwap", swapSize, align, refMismatch(dst, ref, swapSize), (u32) -1);
+    }
+
+    u32 hist[256];
+    u32 refHist[256];
+    memset(hist, 0, sizeof(hist));
+    memset(refHist, 0, sizeof(refHist));
+    for (u32 i = 0; i < size; i++) refHist[data[i]]++;
+    memHistogram(data, size, hist);
+    check(memcmp(hist, refHist, sizeof(hist)) == 0, "memHistogram", size, align, 0, 0);
+
+    // overlapping moves in both directions
+    if(size >= 2) {
+        u32 shift = 1 + (rng() % (size / 2));
+        memcpy(dst, data, size);
+        memcpy(ref, data, size);
+        memmove(ref, ref + shift, size - shift);
+        memMove(dst, dst + shift, size - shift);
+        check(memcmp(dst, ref, size) == 0, "memMove (down)", size, align, refMismatch(dst, ref, size), (u32) -1);
+        memcpy(dst, data, size);
+        memcpy(ref, data, size);
+        memmove(ref + shift, ref, size - shift);
+        memMove(dst + shift, dst, size - shift);
+        check(memcmp(dst, ref, size) == 0, "memMove (up)", size, align, refMismatch(dst, ref, size), (u32) -1);
+    }
+}
+
+static double benchNow() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static volatile u32 benchSink;
+
+#define BENCH(name, size, expr) do { \
+    double start = benchNow(); \
+    for (u32 r = 0; r < rounds; r++) benchSink = benchSink + (u32) (expr); \
+    double secs = benchNow() - start; \
+    printf("%-16s %8.1f MiB/s\n", name, (rounds * (double) (size)) / (secs * 1024 * 1024)); \
+} while(0)
+
+static void bench() {
+    u8* data0 = (u8*) malloc(BENCH_SIZE);
+    u8* data1 = (u8*) malloc(BENCH_SIZE);
+    if(!data0 || !data1) {
+        printf("out of memory\n");
+        exit(1);
+    }
+    fillRandom(data0, BENCH_SIZE, 26);
+    memcpy(data1, data0, BENCH_SIZE);
+    const u32 rounds = 8;
+    u32 hist[256] = { 0 };
+    const u8 absent[] = { 0xFE, 0xFF, 'z' + 1 }; // not in the data
+    const u8 pattern[] = { 0x12, 0x34, 0x56 };
+
+    BENCH("memFindByte", BENCH_SIZE, memFindByte(data0, BENCH_SIZE, 0xFF));
+    BENCH("  byte loop", BENCH_SIZE, refFindByte(data0, BENCH_SIZE, 0xFF));
+    BENCH("memCountByte", BENCH_SIZE, memCountByte(data0, BENCH_SIZE, 'a'));
+    BENCH("  byte loop", BENCH_SIZE, refCountByte(data0, BENCH_SIZE, 'a'));
+    BENCH("memMismatch", BENCH_SIZE, memMismatch(data0, data1, BENCH_SIZE));
+    BENCH("  byte loop", BENCH_SIZE, refMismatch(data0, data1, BENCH_SIZE));
+    BENCH("memFind", BENCH_SIZE, memFind(data0, BENCH_SIZE, (const u8*) "zzz{", 4)); // absent, every 'z' is a candidate
+    BENCH("  byte loop", BENCH_SIZE, refFind(data0, BENCH_SIZE, (const u8*) "zzz{", 4));
+    BENCH("memFindAnyOf", BENCH_SIZE, memFindAnyOf(data0, BENCH_SIZE, absent, 3));
+    BENCH("  byte loop", BENCH_SIZE, refFindAnyOf(data0, BENCH_SIZE, absent, 3));
+    BENCH("memHistogram", BENCH_SIZE, (memHistogram(data0, BENCH_SIZE, hist), hist[0]));
+    BENCH("memCrc32", BENCH_SIZE, memCrc32(0, data0, BENCH_SIZE));
+    BENCH("  bitwise", BENCH_SIZE / 16, refCrc32(0, data0, BENCH_SIZE / 16)); // slow, a part of the data is enough
+
+    // in place on data1, the result is only there to keep the calls
+    BENCH("memFillPattern", BENCH_SIZE, (memFillPattern(data1, BENCH_SIZE, pattern, 3), data1[0]));
+    BENCH("  byte loop", BENCH_SIZE, (refFillPattern(data1, BENCH_SIZE, pattern, 3), data1[0]));
+    BENCH("memXorPattern", BENCH_SIZE, (memXorPattern(data1, BENCH_SIZE, pattern, 3), data1[0]));
+    BENCH("  byte loop", BENCH_SIZE, (refXorPattern(data1, BENCH_SIZE, pattern, 3), data1[0]));
+    BENCH("memAddByte", BENCH_SIZE, (memAddByte(data1, BENCH_SIZE, 0x55), data1[0]));
+    BENCH("  byte loop", BENCH_SIZE, (refAddByte(data1, BENCH_SIZE, 0x55), data1[0]));
+    BENCH("memInvert", BENCH_SIZE, (memInvert(data1, BENCH_SIZE), data1[0]));
+    BENCH("  byte loop", BENCH_SIZE, (refInvert(data1, BENCH_SIZE), data1[0]));
+    BENCH("memSwap (4)", BENCH_SIZE, (memSwap(data1, BENCH_SIZE, 4), data1[0]));
+    BENCH("  byte loop", BENCH_SIZE, (refSwap(data1, BENCH_SIZE, 4), data1[0]));
+    memFill(data1, BENCH_SIZE, 'a');
+    BENCH("memIsAll", BENCH_SIZE, memIsAll(data1, BENCH_SIZE, 'a'));
+    BENCH("  byte loop", BENCH_SIZE, refIsAll(data1, BENCH_SIZE, 'a'));
+
+    free(data0);
+    free(data1);
+}
+
+int main(int argc, char** argv) {
+    u8 buffer0[MAX_SIZE + PAD];
+    u8 buffer1[MAX_SIZE + PAD];
+    const u32 alphabets[] = { 1, 3, 26, 256 };
+
+    for (u32 a = 0; a < sizeof(alphabets) / sizeof(alphabets[0]); a++) {
+        for (u32 size = 0; size <= MAX_SIZE; size++) {
+            for (u32 align = 0; align < 8; align++) {
+                u8* data0 = buffer0 + align;
+                u8* data1 = buffer1 + ((align * 3) % 8); // differently aligned second buffer
+                fillRandom(data0, size, alphabets[a]);
+                checkSearch(data0, size, align);
+                checkMismatch(data0, data1, size, align);
+                checkTransforms(data0, size, align);
+            }
+        }
+    }
+
+    printf("memcheck: %s (%u failures)\n", (failures == 0) ? "OK" : "FAILED", failures);
+    if((argc > 1) && (strcmp(argv[1], "bench") == 0)) bench();
+    return (failures == 0) ? 0 : 1;
+}